@@ -0,0 +1,363 @@
+/** QuickPlay
+ *
+ *  gzip_fpga multi-board scheduler implementation file
+ */
+
+#include <stdlib.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <iostream>
+#include <map>
+#include <thread>
+#include "BoardScheduler.h"
+#include "GzipSession.h"
+#include "SwDeflate.h"
+#include "Crc32.h"
+#include "EntropyScan.h"
+
+using namespace QuickPlayLib;
+
+#define BOARD_OUT_MARGIN        0x400           // gzip framing room for tiny items
+
+/**
+ *  Output side of a file: members completed out of order wait here until
+ *  the members before them are written
+ */
+struct BoardScheduler::file_state_t {
+    std::mutex                              mtx;
+    int                                     fd;
+    bool                                    started;
+    unsigned int                            nextChunk;
+    unsigned int                            doneChunks;
+    std::map<unsigned int, std::string>     pending;
+};
+
+/**
+ *  Board work slot: buffers of one item in flight
+ */
+typedef struct {
+    session_job_t   job;
+    char            *inBuffer;
+    long long int   inCapacity;
+    char            *outBuffer;
+    long long int   outCapacity;
+} board_slot_t;
+
+/**
+ *  board_reserve
+ */
+static int board_reserve(char* & buffer, long long int & capacity, long long int size)
+{
+    if(size <= capacity)
+        return 0;
+    char *newBuffer = (char *)realloc(buffer, size);
+    if(!newBuffer)
+        return -1;
+    buffer = newBuffer;
+    capacity = size;
+    return 0;
+}
+
+/**
+ *  board_pread: read size bytes at offset, retrying short reads
+ */
+static int board_pread(const std::string & filename, char *buffer, long long int size, long long int offset)
+{
+    int fd = open(filename.c_str(), O_RDONLY);
+    if(fd == -1)
+        return -1;
+    long long int done = 0;
+    while(done < size) {
+        ssize_t ret = pread(fd, &buffer[done], size-done, offset+done);
+        if(ret < 0 && errno == EINTR)
+            continue;
+        if(ret <= 0)
+            break;
+        done += ret;
+    }
+    close(fd);
+    return done == size ? 0 : -1;
+}
+
+BoardScheduler::BoardScheduler( std::vector<QpDesign *> & boards, long long int chunkSize,
+                                unsigned int maxInflight, bool verify, bool entropyScan ) :
+    _boards( boards ),
+    _chunkSize( chunkSize > 0 ? chunkSize : 0x2000000 ),
+    _maxInflight( maxInflight ? maxInflight : 1 ),
+    _verify( verify ),
+    _entropyScan( entropyScan ),
+    _elapsedSecs( 0.0 ),
+    _inputDone( false )
+{}
+
+void BoardScheduler::start( void )
+{
+    unsigned int nbBoards = _boards.size();
+    board_stats_t zero = { 0, 0, 0, 0, 0, 0, 0.0 };
+    _stats.assign(nbBoards, zero);
+    _inputDone = false;
+    _start = std::chrono::steady_clock::now();
+    for(unsigned int b=0; b<nbBoards; b++)
+        _workers.push_back(std::thread(&BoardScheduler::tBoard, this, b));
+}
+
+void BoardScheduler::add( const board_file_t & input )
+{
+    struct stat st;
+    long long int inSize = stat(input.in_filename.c_str(), &st) ? 0 : st.st_size;
+
+    // Cut the file into items, taken by the boards as they free a slot
+    std::lock_guard<std::mutex> lock(_mtx);
+    _files.push_back(input);
+    board_file_t & file = _files.back();
+    file.inSize = inSize;
+    file.outSize = 0;
+    file.nbChunks = file.inSize ? (unsigned int)((file.inSize + _chunkSize - 1) / _chunkSize) : 1;
+    file.err = 0;
+    file.check = _verify ? GZIP_CHECK_OK : GZIP_CHECK_NONE;
+    file.storedChunks = 0;
+
+    file_state_t *state = new file_state_t;
+    state->started = false;
+    state->nextChunk = 0;
+    state->doneChunks = 0;
+    state->fd = -1;
+    _states.push_back(state);
+
+    for(unsigned int c=0; c<file.nbChunks; c++) {
+        work_t work;
+        work.file = &file;
+        work.state = state;
+        work.chunk = c;
+        work.offset = (long long int)c * _chunkSize;
+        work.size = (file.inSize - work.offset) < _chunkSize ? (file.inSize - work.offset) : _chunkSize;
+        _queue.push_back(work);
+    }
+    _cv.notify_all();
+}
+
+int BoardScheduler::finish( void )
+{
+    {
+        std::lock_guard<std::mutex> lock(_mtx);
+        _inputDone = true;
+        _cv.notify_all();
+    }
+    for(size_t b=0; b<_workers.size(); b++)
+        _workers[b].join();
+    _workers.clear();
+    _elapsedSecs = std::chrono::duration<double>(std::chrono::steady_clock::now() - _start).count();
+
+    // Items left behind when no board could be opened
+    _queue.clear();
+    int retCode = 0;
+    for(size_t i=0; i<_files.size(); i++) {
+        if(_states[i]->fd != -1)
+            close(_states[i]->fd);
+        if(!_files[i].err && _states[i]->doneChunks != _files[i].nbChunks)
+            _files[i].err = -1;
+        if(_files[i].err)
+            retCode = -1;
+        delete _states[i];
+    }
+    _states.clear();
+    return retCode;
+}
+
+/**
+ *  Next item in the shared queue: 1 when one was taken, 0 when none is
+ *  queued yet (wait=false), -1 once the input is over and the queue empty
+ */
+int BoardScheduler::takeWork( work_t & work, bool wait )
+{
+    std::unique_lock<std::mutex> lock(_mtx);
+    if(wait)
+        _cv.wait(lock, [this]{ return !_queue.empty() || _inputDone; });
+    if(_queue.empty())
+        return _inputDone ? -1 : 0;
+    work = _queue.front();
+    _queue.pop_front();
+    return 1;
+}
+
+/**
+ *  Store a completed member and write out the members now in order
+ */
+void BoardScheduler::completeWork( const work_t & work, const char *data, long long int size, int err, int check )
+{
+    board_file_t & file = *work.file;
+    file_state_t *state = work.state;
+
+    std::lock_guard<std::mutex> lock(state->mtx);
+    file.endTime = std::chrono::steady_clock::now();
+    state->doneChunks++;
+    if(check != GZIP_CHECK_NONE && file.check == GZIP_CHECK_OK)
+        file.check = check;
+    if(err && !file.err) {
+        std::cerr << KRED << "BoardScheduler: Error: FPGA compression of file [" << file.in_filename << "] failed (" << err << ")" << KNRM << std::endl;
+        file.err = err;
+    }
+
+    // The output is opened by the first member to complete and closed after
+    // the last one: only the files in flight hold a descriptor
+    if(!file.err && state->fd == -1) {
+        state->fd = open(file.out_filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC, S_IWRITE | S_IREAD);
+        if(state->fd == -1) {
+            std::cerr << KRED << "BoardScheduler: Error: Opening output file [" << file.out_filename << "]" << KNRM << std::endl;
+            file.err = -3;
+        }
+    }
+
+    if(!file.err)
+        state->pending[work.chunk].assign(data, size);
+    std::map<unsigned int, std::string>::iterator it;
+    while(!file.err && (it = state->pending.find(state->nextChunk)) != state->pending.end()) {
+        const std::string & member = it->second;
+        size_t written = 0;
+        while(written < member.size()) {
+            ssize_t ret = write(state->fd, &member[written], member.size()-written);
+            if(ret < 0 && errno == EINTR)
+                continue;
+            if(ret < 0) {
+                std::cerr << KRED << "BoardScheduler: Error: Unable to write output file [" << file.out_filename << "]" << KNRM << std::endl;
+                file.err = -4;
+                break;
+            }
+            written += ret;
+        }
+        file.outSize += member.size();
+        state->pending.erase(it);
+        state->nextChunk++;
+    }
+    if(file.err)
+        state->pending.clear();
+
+    if(state->doneChunks == file.nbChunks && state->fd != -1) {
+        close(state->fd);
+        state->fd = -1;
+    }
+}
+
+/**
+ *  Board worker: keeps up to maxInflight items in flight on its session
+ */
+void BoardScheduler::tBoard( unsigned int board )
+{
+    board_stats_t & stats = _stats[board];
+    std::vector<board_slot_t> slots(_maxInflight);
+    std::vector<board_slot_t *> freeSlots;
+    std::vector<work_t> works(_maxInflight);
+    std::vector<uint32_t> crcs(_maxInflight);
+    for(unsigned int i=0; i<_maxInflight; i++) {
+        slots[i].inBuffer = NULL;
+        slots[i].inCapacity = 0;
+        slots[i].outBuffer = NULL;
+        slots[i].outCapacity = 0;
+        slots[i].job.user = &slots[i];
+        freeSlots.push_back(&slots[i]);
+    }
+
+    GzipSession session(*_boards[board], _maxInflight);
+    bool opened = (session.open() == 0);
+    if(!opened)
+        std::cerr << KRED << "BoardScheduler: board " << board << " unavailable, its work goes to the other boards" << KNRM << std::endl;
+
+    std::chrono::time_point<std::chrono::steady_clock> first, last;
+    bool started = false;
+    bool moreWork = opened;
+    bool queued = true;         // the last look at the queue found an item
+    while(true) {
+        // Retrieve completed items. Wait for one when no slot is free, when
+        // the input is over, or when nothing is queued while the board works
+        session_job_t *job;
+        bool wait = (freeSlots.empty() || !moreWork || !queued) && freeSlots.size() < _maxInflight;
+        while(opened && (job = session.getCompleted(wait)) != NULL) {
+            board_slot_t *slot = (board_slot_t *)job->user;
+            last = job->completeTime;
+            stats.items++;
+            stats.inBytes += job->inSize;
+            stats.outBytes += job->outSize;
+            int check = GZIP_CHECK_NONE;
+            if(_verify && !job->err)
+                check = gzip_check_member(job->outBuffer, job->outSize, crcs[slot - &slots[0]], job->inSize);
+            completeWork(works[slot - &slots[0]], job->outBuffer, job->outSize, job->err, check);
+            freeSlots.push_back(slot);
+            if(freeSlots.size() == _maxInflight && !moreWork)
+                break;
+            wait = !moreWork;
+        }
+        if(!moreWork)
+            break;
+
+        // An idle board sleeps until an item is queued
+        work_t work;
+        int taken = takeWork(work, freeSlots.size() == _maxInflight);
+        if(taken < 0)
+            moreWork = false;
+        queued = (taken > 0);
+        if(taken <= 0)
+            continue;
+
+        board_slot_t *slot = freeSlots.back();
+        board_file_t & file = *work.file;
+        if(board_reserve(slot->inBuffer, slot->inCapacity, work.size ? work.size : 1) ||
+           board_reserve(slot->outBuffer, slot->outCapacity, 2*work.size + BOARD_OUT_MARGIN) ||
+           board_pread(file.in_filename, slot->inBuffer, work.size, work.offset)) {
+            std::cerr << KRED << "BoardScheduler: Error: Loading input file [" << file.in_filename << "]" << KNRM << std::endl;
+            completeWork(work, NULL, 0, -1, GZIP_CHECK_NONE);
+            continue;
+        }
+        {
+            file_state_t *state = work.state;
+            std::lock_guard<std::mutex> lock(state->mtx);
+            if(!state->started)
+                file.startTime = std::chrono::steady_clock::now();
+            state->started = true;
+        }
+
+        // Incompressible item: stored here, the slot stays free
+        entropy_stats_t scan;
+        if(_entropyScan && entropy_scan(slot->inBuffer, work.size, scan)) {
+            std::string member;
+            uint32_t crc = crc32_fast(0, slot->inBuffer, work.size);
+            sw_gzip_stored(slot->inBuffer, work.size, crc, member);
+            stats.storedItems++;
+            stats.storedInBytes += work.size;
+            stats.storedOutBytes += member.size();
+            {
+                std::lock_guard<std::mutex> lock(work.state->mtx);
+                file.storedChunks++;
+            }
+            int check = _verify ? gzip_check_member(member.data(), member.size(), crc, work.size) : GZIP_CHECK_NONE;
+            completeWork(work, member.data(), member.size(), 0, check);
+            continue;
+        }
+
+        freeSlots.pop_back();
+        works[slot - &slots[0]] = work;
+        slot->job.inBuffer    = slot->inBuffer;
+        slot->job.inSize      = work.size;
+        slot->job.nbParts     = 0;
+        slot->job.outBuffer   = slot->outBuffer;
+        slot->job.outCapacity = slot->outCapacity;
+
+        if(!started)
+            first = std::chrono::steady_clock::now();
+        started = true;
+        session.submit(&slot->job);
+
+        // Integrity test: CRC32 of the item while the board reads it
+        if(_verify)
+            crcs[slot - &slots[0]] = crc32_fast(0, slot->inBuffer, work.size);
+    }
+    session.close();
+
+    if(stats.items)
+        stats.activeSecs = std::chrono::duration<double>(last - first).count();
+    for(unsigned int i=0; i<_maxInflight; i++) {
+        free(slots[i].inBuffer);
+        free(slots[i].outBuffer);
+    }
+}
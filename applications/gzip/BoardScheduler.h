@@ -0,0 +1,114 @@
+/** QuickPlay
+ *
+ *  gzip_fpga multi-board scheduler header file
+ *
+ *  Files are added while the boards run, as a tree walk finds them, and
+ *  cut into work items (a whole file, or one chunk of a large file) queued
+ *  in one shared queue. Each board runs its own GzipSession and takes the
+ *  next item whenever it has a free slot, so nothing is assigned ahead of
+ *  time and a slow or busy card only gets the work it can take. Every item
+ *  comes back as one gzip member; the members of a chunked file are
+ *  written back in order, which gives a valid multi-member archive. With
+ *  the entropy pre-scan, incompressible items are written as stored
+ *  members by the board worker and never sent to its card.
+ */
+
+#ifndef BOARD_SCHEDULER_H
+#define BOARD_SCHEDULER_H
+
+#include <deque>
+#include <vector>
+#include <string>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <chrono>
+#include "QpDevice.h"
+
+typedef struct {
+    std::string     in_filename;
+    std::string     out_filename;
+    long long int   inSize;         // set by add()
+    long long int   outSize;        // set by the boards
+    unsigned int    nbChunks;       // set by add()
+    int             err;            // set by the boards, 0 on success
+    int             check;          // set by the boards: integrity test (GZIP_CHECK_*)
+    unsigned int    storedChunks;   // set by the boards: items kept off the device
+    std::chrono::time_point<std::chrono::steady_clock> startTime;   // first chunk submitted
+    std::chrono::time_point<std::chrono::steady_clock> endTime;     // last chunk completed
+} board_file_t;
+
+typedef struct {
+    unsigned int    items;          // work items compressed
+    long long int   inBytes;
+    long long int   outBytes;
+    unsigned int    storedItems;    // incompressible items stored on the host
+    long long int   storedInBytes;
+    long long int   storedOutBytes;
+    double          activeSecs;     // first submission to last completion
+} board_stats_t;
+
+class BoardScheduler {
+
+    public:
+    // verify: check each member trailer against the CRC32 of its input
+    // entropyScan: store incompressible items on the host
+    BoardScheduler( std::vector<QuickPlayLib::QpDesign *> & boards, long long int chunkSize,
+                    unsigned int maxInflight, bool verify, bool entropyScan );
+
+    // Start the board workers, files are added while they run
+    void start( void );
+
+    // Queue a file, in_filename and out_filename set
+    void add( const board_file_t & file );
+
+    // No more files: wait for the queued ones, 0 if every file succeeded
+    int finish( void );
+
+    // Files in the order they were added, complete once finish() returned
+    std::deque<board_file_t> & files( void )
+    { return _files; }
+
+    const std::vector<board_stats_t> & stats( void ) const
+    { return _stats; }
+
+    // Wall time from start() to the end of finish()
+    double elapsedSecs( void ) const
+    { return _elapsedSecs; }
+
+    private:
+    BoardScheduler( const BoardScheduler & );
+    BoardScheduler & operator=( const BoardScheduler & );
+
+    struct file_state_t;
+
+    typedef struct {
+        board_file_t    *file;
+        file_state_t    *state;
+        unsigned int    chunk;
+        long long int   offset;
+        long long int   size;
+    } work_t;
+
+    void tBoard( unsigned int board );
+    int takeWork( work_t & work, bool wait );
+    void completeWork( const work_t & work, const char *data, long long int size, int err, int check );
+
+    std::vector<QuickPlayLib::QpDesign *> & _boards;
+    long long int                       _chunkSize;
+    unsigned int                        _maxInflight;
+    bool                                _verify;
+    bool                                _entropyScan;
+    double                              _elapsedSecs;
+    std::chrono::time_point<std::chrono::steady_clock> _start;
+    std::vector<board_stats_t>          _stats;
+    std::vector<std::thread>            _workers;
+    std::deque<board_file_t>            _files;     // stable references, the items point to them
+    std::deque<file_state_t *>          _states;
+    std::mutex                          _mtx;       // work queue, files
+    std::condition_variable             _cv;        // an item was queued, or the input is over
+    std::deque<work_t>                  _queue;
+    bool                                _inputDone;
+};
+
+#endif
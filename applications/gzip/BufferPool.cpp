@@ -0,0 +1,153 @@
+/** QuickPlay
+ *
+ *  gzip_fpga buffer pool implementation file
+ */
+
+#include <unistd.h>
+#include <sys/mman.h>
+#include "BufferPool.h"
+
+#ifndef MAP_HUGE_SHIFT
+#define MAP_HUGE_SHIFT          26
+#endif
+#define POOL_PAGE_2MB           0x200000UL
+#define POOL_PAGE_1GB           0x40000000UL
+
+/**
+ *  Map size bytes on hugepages of pageSize, NULL if none are available
+ */
+static char * map_hugepages( size_t size, size_t pageSize, int pageShift )
+{
+#ifdef MAP_HUGETLB
+    if(size % pageSize)
+        return NULL;
+    void *mem = mmap(NULL, size, PROT_READ|PROT_WRITE,
+                     MAP_PRIVATE|MAP_ANON|MAP_HUGETLB|MAP_POPULATE|(pageShift << MAP_HUGE_SHIFT), -1, 0);
+    return mem == MAP_FAILED ? NULL : (char *)mem;
+#else
+    return NULL;
+#endif
+}
+
+BufferPool::BufferPool( size_t size ) :
+    _mem( NULL )
+{
+    _stats.poolSize  = 0;
+    _stats.pageSize  = sysconf(_SC_PAGESIZE);
+    _stats.pinned    = false;
+    _stats.hits      = 0;
+    _stats.misses    = 0;
+    _stats.inUse     = 0;
+    _stats.peakInUse = 0;
+    _stats.missBytes = 0;
+    if(!size)
+        return;
+
+    // Whole 1 GB pages only when the pool is made of them, 2 MB otherwise
+    size = (size + POOL_PAGE_2MB-1) & ~(POOL_PAGE_2MB-1);
+    if((_mem = map_hugepages(size, POOL_PAGE_1GB, 30)) != NULL)
+        _stats.pageSize = POOL_PAGE_1GB;
+    else if((_mem = map_hugepages(size, POOL_PAGE_2MB, 21)) != NULL)
+        _stats.pageSize = POOL_PAGE_2MB;
+    else {
+        void *mem = mmap(NULL, size, PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANON, -1, 0);
+        if(mem == MAP_FAILED)
+            return;
+        _mem = (char *)mem;
+#ifdef MADV_HUGEPAGE
+        madvise(_mem, size, MADV_HUGEPAGE);
+#endif
+        // Fault everything in now rather than during the first jobs
+        for(size_t i=0; i<size; i+=_stats.pageSize)
+            _mem[i] = 0;
+    }
+
+    _stats.pinned   = !mlock(_mem, size);
+    _stats.poolSize = size;
+    _free[0] = size;
+}
+
+BufferPool::~BufferPool()
+{
+    for(std::map<char *, lease_t>::iterator it=_leases.begin(); it!=_leases.end(); ++it)
+        if(!it->second.pooled)
+            munmap(it->first, it->second.size);
+    if(_mem)
+        munmap(_mem, _stats.poolSize);
+}
+
+char * BufferPool::lease( size_t size )
+{
+    size = size ? (size + BUFFER_POOL_GRANULE-1) & ~((size_t)BUFFER_POOL_GRANULE-1) : BUFFER_POOL_GRANULE;
+    std::lock_guard<std::mutex> lock(_mtx);
+
+    // First fit
+    for(std::map<size_t, size_t>::iterator it=_free.begin(); it!=_free.end(); ++it) {
+        if(it->second < size)
+            continue;
+        size_t offset = it->first;
+        if(it->second > size)
+            _free[offset+size] = it->second - size;
+        _free.erase(it);
+
+        char *buffer = &_mem[offset];
+        lease_t lease = { size, true };
+        _leases[buffer] = lease;
+        _stats.hits++;
+        _stats.inUse += size;
+        if(_stats.inUse > _stats.peakInUse)
+            _stats.peakInUse = _stats.inUse;
+        return buffer;
+    }
+
+    void *mem = mmap(NULL, size, PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANON, -1, 0);
+    if(mem == MAP_FAILED)
+        return NULL;
+    lease_t lease = { size, false };
+    _leases[(char *)mem] = lease;
+    _stats.misses++;
+    _stats.missBytes += size;
+    return (char *)mem;
+}
+
+void BufferPool::release( char *buffer )
+{
+    if(!buffer)
+        return;
+    std::lock_guard<std::mutex> lock(_mtx);
+    std::map<char *, lease_t>::iterator it = _leases.find(buffer);
+    if(it == _leases.end())
+        return;
+    lease_t lease = it->second;
+    _leases.erase(it);
+
+    if(!lease.pooled) {
+        munmap(buffer, lease.size);
+        return;
+    }
+    _stats.inUse -= lease.size;
+
+    // Merge with the free neighbours
+    size_t offset = buffer - _mem;
+    size_t size = lease.size;
+    std::map<size_t, size_t>::iterator next = _free.lower_bound(offset);
+    if(next != _free.end() && offset+size == next->first) {
+        size += next->second;
+        next = _free.erase(next);
+    }
+    if(next != _free.begin()) {
+        std::map<size_t, size_t>::iterator prev = next;
+        --prev;
+        if(prev->first + prev->second == offset) {
+            prev->second += size;
+            return;
+        }
+    }
+    _free[offset] = size;
+}
+
+buffer_pool_stats_t BufferPool::stats()
+{
+    std::lock_guard<std::mutex> lock(_mtx);
+    return _stats;
+}
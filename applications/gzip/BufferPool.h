@@ -0,0 +1,66 @@
+/** QuickPlay
+ *
+ *  gzip_fpga buffer pool header file
+ *
+ *  One region is mapped at startup, on 1 GB or 2 MB hugepages when the
+ *  system has some reserved (transparent hugepages otherwise), faulted in
+ *  and locked in memory. Staging and DMA buffers are leased from it and
+ *  given back once a job is done, so a folder run does not map, zero and
+ *  unmap fresh memory for every file. A lease the pool cannot serve is
+ *  mapped on its own and counted as a miss.
+ */
+
+#ifndef BUFFER_POOL_H
+#define BUFFER_POOL_H
+
+#include <stddef.h>
+#include <map>
+#include <mutex>
+
+#define BUFFER_POOL_GRANULE     0x10000     // lease granularity (64 KB)
+
+typedef struct {
+    size_t              poolSize;
+    size_t              pageSize;       // 1 GB, 2 MB or base pages
+    bool                pinned;         // locked in memory
+    unsigned long long  hits;           // leases served from the pool
+    unsigned long long  misses;         // leases mapped on their own
+    size_t              inUse;          // pool bytes leased right now
+    size_t              peakInUse;
+    size_t              missBytes;      // bytes mapped on their own, all misses
+} buffer_pool_stats_t;
+
+class BufferPool {
+
+    public:
+    BufferPool( size_t size );
+    ~BufferPool();
+
+    bool valid() const
+    { return _mem != NULL; }
+
+    // At least size bytes, NULL if even a private mapping failed
+    char * lease( size_t size );
+
+    // Give back a buffer from lease()
+    void release( char *buffer );
+
+    buffer_pool_stats_t stats();
+
+    private:
+    BufferPool( const BufferPool & );
+    BufferPool & operator=( const BufferPool & );
+
+    typedef struct {
+        size_t  size;
+        bool    pooled;
+    } lease_t;
+
+    char                        *_mem;
+    std::mutex                  _mtx;
+    std::map<size_t, size_t>    _free;      // offset -> size, coalesced
+    std::map<char *, lease_t>   _leases;
+    buffer_pool_stats_t         _stats;
+};
+
+#endif
@@ -0,0 +1,164 @@
+/** QuickPlay
+ *
+ *  gzip_fpga fixed-size buffer ring header file
+ *
+ *  A BufferRing owns nbSlots buffers of slotSize bytes, allocated once.
+ *  A filler thread takes free slots, fills them and hands them over in
+ *  order to a drainer thread which gives them back once done, so memory
+ *  use stays constant whatever the amount of data going through. The ring
+ *  memory is leased from a BufferPool when one is given.
+ */
+
+#ifndef BUFFER_RING_H
+#define BUFFER_RING_H
+
+#include <stddef.h>
+#include <sys/mman.h>
+#include <deque>
+#include <vector>
+#include <mutex>
+#include <condition_variable>
+#include "BufferPool.h"
+
+typedef struct {
+    char    *data;      // slot memory
+    size_t  size;       // slot capacity
+    size_t  used;       // valid bytes
+    bool    last;       // last slot of the data set
+    void    *user;      // free use by the ring users
+} ring_slot_t;
+
+class BufferRing {
+
+    public:
+    BufferRing( unsigned int nbSlots, size_t slotSize, BufferPool *pool = NULL ) :
+        _pool( pool ),
+        _closed( false ),
+        _memSize( (size_t)nbSlots*slotSize )
+    {
+        if(_pool)
+            _mem = _pool->lease(_memSize);
+        else {
+            _mem = (char *)mmap(NULL, _memSize, PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANON, -1, 0);
+            if(_mem == MAP_FAILED)
+                _mem = NULL;
+        }
+        if(!_mem)
+            return;
+        _slots.resize(nbSlots);
+        for(unsigned int i=0; i<nbSlots; i++) {
+            _slots[i].data = &_mem[(size_t)i*slotSize];
+            _slots[i].size = slotSize;
+            _slots[i].used = 0;
+            _slots[i].last = false;
+            _slots[i].user = NULL;
+            _free.push_back(&_slots[i]);
+        }
+    }
+
+    ~BufferRing()
+    {
+        if(_mem && _pool)
+            _pool->release(_mem);
+        else if(_mem)
+            munmap(_mem, _memSize);
+    }
+
+    bool valid() const
+    { return _mem != NULL; }
+
+    size_t memorySize() const
+    { return _memSize; }
+
+    // Slots are carved out of one contiguous block
+    char * memory() const
+    { return _mem; }
+
+    // Filler side: blocks until a slot is free, NULL once the ring is closed
+    ring_slot_t * getFree()
+    {
+        std::unique_lock<std::mutex> lock(_mtx);
+        _cv.wait(lock, [this]{ return _closed || !_free.empty(); });
+        if(_free.empty())
+            return NULL;
+        ring_slot_t *slot = _free.front();
+        _free.pop_front();
+        slot->used = 0;
+        slot->last = false;
+        return slot;
+    }
+
+    // Same without blocking: NULL when no slot is free right now
+    ring_slot_t * tryGetFree()
+    {
+        std::lock_guard<std::mutex> lock(_mtx);
+        if(_free.empty())
+            return NULL;
+        ring_slot_t *slot = _free.front();
+        _free.pop_front();
+        slot->used = 0;
+        slot->last = false;
+        return slot;
+    }
+
+    void putFilled( ring_slot_t *slot )
+    {
+        std::lock_guard<std::mutex> lock(_mtx);
+        _filled.push_back(slot);
+        _cv.notify_all();
+    }
+
+    // Drainer side: blocks until a slot is filled, NULL once closed and empty
+    ring_slot_t * getFilled()
+    {
+        std::unique_lock<std::mutex> lock(_mtx);
+        _cv.wait(lock, [this]{ return _closed || !_filled.empty(); });
+        if(_filled.empty())
+            return NULL;
+        ring_slot_t *slot = _filled.front();
+        _filled.pop_front();
+        return slot;
+    }
+
+    // Same without blocking: NULL when no slot is filled right now
+    ring_slot_t * tryGetFilled()
+    {
+        std::lock_guard<std::mutex> lock(_mtx);
+        if(_filled.empty())
+            return NULL;
+        ring_slot_t *slot = _filled.front();
+        _filled.pop_front();
+        return slot;
+    }
+
+    void putFree( ring_slot_t *slot )
+    {
+        std::lock_guard<std::mutex> lock(_mtx);
+        _free.push_back(slot);
+        _cv.notify_all();
+    }
+
+    // No more slots will be filled: wake up everybody waiting
+    void close()
+    {
+        std::lock_guard<std::mutex> lock(_mtx);
+        _closed = true;
+        _cv.notify_all();
+    }
+
+    private:
+    BufferRing( const BufferRing & );
+    BufferRing & operator=( const BufferRing & );
+
+    BufferPool                  *_pool;
+    char                        *_mem;
+    bool                        _closed;
+    size_t                      _memSize;
+    std::vector< ring_slot_t >  _slots;
+    std::deque< ring_slot_t * > _free;
+    std::deque< ring_slot_t * > _filled;
+    std::mutex                  _mtx;
+    std::condition_variable     _cv;
+};
+
+#endif
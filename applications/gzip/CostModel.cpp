@@ -0,0 +1,67 @@
+/** QuickPlay
+ *
+ *  gzip_fpga compression cost model implementation file
+ */
+
+#include "CostModel.h"
+
+CostModel::CostModel()
+{
+    for(int e=0; e<COST_NB_ENGINES; e++)
+        for(int b=0; b<COST_NB_BUCKETS; b++) {
+            _samples[e][b] = 0;
+            _secs[e][b] = 0.0;
+            _bytes[e][b] = 0.0;
+        }
+}
+
+unsigned int CostModel::bucket( long long int size )
+{
+    unsigned int b = 0;
+    while(size > 1 && b < COST_NB_BUCKETS-1) {
+        size >>= 1;
+        b++;
+    }
+    return b;
+}
+
+double CostModel::estimate( int engine, long long int size )
+{
+    unsigned int b = bucket(size);
+    std::lock_guard<std::mutex> lock(_mtx);
+    if(!_samples[engine][b])
+        return 0.0;
+
+    // Job time scales with the size inside a bucket, fixed costs included:
+    // buckets are narrow enough for that
+    if(_bytes[engine][b] <= 0.0)
+        return _secs[engine][b];
+    return _secs[engine][b] * (double)size / _bytes[engine][b];
+}
+
+void CostModel::record( int engine, long long int size, double secs )
+{
+    unsigned int b = bucket(size);
+    std::lock_guard<std::mutex> lock(_mtx);
+    if(!_samples[engine][b]) {
+        _secs[engine][b] = secs;
+        _bytes[engine][b] = (double)size;
+    }
+    else {
+        _secs[engine][b] += COST_EWMA_WEIGHT * (secs - _secs[engine][b]);
+        _bytes[engine][b] += COST_EWMA_WEIGHT * ((double)size - _bytes[engine][b]);
+    }
+    _samples[engine][b]++;
+}
+
+unsigned int CostModel::samples( int engine, unsigned int bucket )
+{
+    std::lock_guard<std::mutex> lock(_mtx);
+    return _samples[engine][bucket];
+}
+
+double CostModel::secs( int engine, unsigned int bucket )
+{
+    std::lock_guard<std::mutex> lock(_mtx);
+    return _secs[engine][bucket];
+}
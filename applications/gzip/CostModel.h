@@ -0,0 +1,51 @@
+/** QuickPlay
+ *
+ *  gzip_fpga compression cost model header file
+ *
+ *  Jobs are sorted into power-of-two size buckets. For each engine and each
+ *  bucket the model keeps a moving average of the time taken by one job and
+ *  of its size, updated with every job completed. A bucket that has not
+ *  seen a job on an engine estimates it at no cost, so the dispatcher tries
+ *  every engine on every size before relying on the figures.
+ */
+
+#ifndef COST_MODEL_H
+#define COST_MODEL_H
+
+#include <mutex>
+
+#define COST_ENGINE_FPGA        0
+#define COST_ENGINE_CPU         1
+#define COST_NB_ENGINES         2
+#define COST_NB_BUCKETS         40          // up to 512GB jobs
+#define COST_EWMA_WEIGHT        0.2         // weight of the newest job
+
+class CostModel {
+
+    public:
+    CostModel();
+
+    // Size bucket of a job: floor(log2(size)), 0 for empty jobs
+    static unsigned int bucket( long long int size );
+
+    // Seconds expected for a job of size bytes on engine
+    double estimate( int engine, long long int size );
+
+    // A job of size bytes took secs on engine
+    void record( int engine, long long int size, double secs );
+
+    // Jobs seen and average job time, for reports
+    unsigned int samples( int engine, unsigned int bucket );
+    double secs( int engine, unsigned int bucket );
+
+    private:
+    CostModel( const CostModel & );
+    CostModel & operator=( const CostModel & );
+
+    std::mutex      _mtx;
+    unsigned int    _samples[COST_NB_ENGINES][COST_NB_BUCKETS];
+    double          _secs[COST_NB_ENGINES][COST_NB_BUCKETS];
+    double          _bytes[COST_NB_ENGINES][COST_NB_BUCKETS];
+};
+
+#endif
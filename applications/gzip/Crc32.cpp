@@ -0,0 +1,182 @@
+/** QuickPlay
+ *
+ *  gzip_fpga CRC32 (gzip polynomial) implementation file
+ */
+
+#include <string.h>
+#include "Crc32.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define CRC32_HAVE_PCLMUL
+#endif
+
+#define CRC32_POLY_REFLECTED    0xEDB88320
+#define CRC32_PCLMUL_MIN_SIZE   64
+
+typedef uint32_t (*crc32_kernel_t)(uint32_t crc, const unsigned char *buf, size_t len);
+
+/* Slice-by-8 tables: _crcTable[k][b] is the CRC of byte b followed by k zero bytes */
+static uint32_t _crcTable[8][256];
+
+/**
+ *  crc32_init_tables
+ */
+static void crc32_init_tables(void)
+{
+    for(uint32_t b=0; b<256; b++) {
+        uint32_t crc = b;
+        for(int bit=0; bit<8; bit++)
+            crc = (crc & 1) ? (crc >> 1) ^ CRC32_POLY_REFLECTED : crc >> 1;
+        _crcTable[0][b] = crc;
+    }
+    for(uint32_t b=0; b<256; b++)
+        for(int k=1; k<8; k++)
+            _crcTable[k][b] = (_crcTable[k-1][b] >> 8) ^ _crcTable[0][_crcTable[k-1][b] & 0xFF];
+}
+
+/**
+ *  crc32_slice8: crc is the inverted running value
+ */
+static uint32_t crc32_slice8(uint32_t crc, const unsigned char *buf, size_t len)
+{
+    while(len && ((uintptr_t)buf & 7)) {
+        crc = (crc >> 8) ^ _crcTable[0][(crc ^ *buf++) & 0xFF];
+        len--;
+    }
+    while(len >= 8) {
+        uint32_t lo, hi;
+        memcpy(&lo, buf, 4);
+        memcpy(&hi, buf+4, 4);
+        lo ^= crc;      // little endian hosts only, as the rest of the application
+        crc = _crcTable[7][lo & 0xFF]         ^ _crcTable[6][(lo >> 8) & 0xFF] ^
+              _crcTable[5][(lo >> 16) & 0xFF] ^ _crcTable[4][lo >> 24] ^
+              _crcTable[3][hi & 0xFF]         ^ _crcTable[2][(hi >> 8) & 0xFF] ^
+              _crcTable[1][(hi >> 16) & 0xFF] ^ _crcTable[0][hi >> 24];
+        buf += 8;
+        len -= 8;
+    }
+    while(len--)
+        crc = (crc >> 8) ^ _crcTable[0][(crc ^ *buf++) & 0xFF];
+    return crc;
+}
+
+#ifdef CRC32_HAVE_PCLMUL
+/**
+ *  crc32_pclmul: crc is the inverted running value
+ *
+ *  Folds four 128-bit lanes by 512 bits per step, then folds them into one
+ *  lane, and ends with a Barrett reduction (Intel, "Fast CRC Computation
+ *  for Generic Polynomials Using PCLMULQDQ Instruction"). The tail that
+ *  is not a multiple of 16 bytes goes through slice-by-8.
+ */
+__attribute__((target("pclmul,sse4.1")))
+static uint32_t crc32_pclmul(uint32_t crc, const unsigned char *buf, size_t len)
+{
+    if(len < CRC32_PCLMUL_MIN_SIZE)
+        return crc32_slice8(crc, buf, len);
+
+    const __m128i k1k2 = _mm_set_epi64x(0x01c6e41596LL, 0x0154442bd4LL);
+    const __m128i k3k4 = _mm_set_epi64x(0x00ccaa009eLL, 0x01751997d0LL);
+    const __m128i k5k0 = _mm_set_epi64x(0x0000000000LL, 0x0163cd6124LL);
+    const __m128i poly = _mm_set_epi64x(0x01f7011641LL, 0x01db710641LL);
+    const __m128i mask32 = _mm_setr_epi32(~0, 0, ~0, 0);
+    size_t tail = len & 15;
+    len -= tail;
+
+    __m128i x1, x2, x3, x4, x5, x6, x7, x8;
+    x1 = _mm_loadu_si128((const __m128i *)(buf + 0x00));
+    x2 = _mm_loadu_si128((const __m128i *)(buf + 0x10));
+    x3 = _mm_loadu_si128((const __m128i *)(buf + 0x20));
+    x4 = _mm_loadu_si128((const __m128i *)(buf + 0x30));
+    x1 = _mm_xor_si128(x1, _mm_cvtsi32_si128((int)crc));
+    buf += 64;
+    len -= 64;
+
+    // Fold 4 x 128 bits per step
+    while(len >= 64) {
+        x5 = _mm_clmulepi64_si128(x1, k1k2, 0x00);
+        x6 = _mm_clmulepi64_si128(x2, k1k2, 0x00);
+        x7 = _mm_clmulepi64_si128(x3, k1k2, 0x00);
+        x8 = _mm_clmulepi64_si128(x4, k1k2, 0x00);
+        x1 = _mm_clmulepi64_si128(x1, k1k2, 0x11);
+        x2 = _mm_clmulepi64_si128(x2, k1k2, 0x11);
+        x3 = _mm_clmulepi64_si128(x3, k1k2, 0x11);
+        x4 = _mm_clmulepi64_si128(x4, k1k2, 0x11);
+        x1 = _mm_xor_si128(_mm_xor_si128(x1, x5), _mm_loadu_si128((const __m128i *)(buf + 0x00)));
+        x2 = _mm_xor_si128(_mm_xor_si128(x2, x6), _mm_loadu_si128((const __m128i *)(buf + 0x10)));
+        x3 = _mm_xor_si128(_mm_xor_si128(x3, x7), _mm_loadu_si128((const __m128i *)(buf + 0x20)));
+        x4 = _mm_xor_si128(_mm_xor_si128(x4, x8), _mm_loadu_si128((const __m128i *)(buf + 0x30)));
+        buf += 64;
+        len -= 64;
+    }
+
+    // Fold the 4 lanes into one
+    x5 = _mm_clmulepi64_si128(x1, k3k4, 0x00);
+    x1 = _mm_clmulepi64_si128(x1, k3k4, 0x11);
+    x1 = _mm_xor_si128(_mm_xor_si128(x1, x2), x5);
+    x5 = _mm_clmulepi64_si128(x1, k3k4, 0x00);
+    x1 = _mm_clmulepi64_si128(x1, k3k4, 0x11);
+    x1 = _mm_xor_si128(_mm_xor_si128(x1, x3), x5);
+    x5 = _mm_clmulepi64_si128(x1, k3k4, 0x00);
+    x1 = _mm_clmulepi64_si128(x1, k3k4, 0x11);
+    x1 = _mm_xor_si128(_mm_xor_si128(x1, x4), x5);
+
+    // Remaining 16 bytes blocks
+    while(len >= 16) {
+        x5 = _mm_clmulepi64_si128(x1, k3k4, 0x00);
+        x1 = _mm_clmulepi64_si128(x1, k3k4, 0x11);
+        x1 = _mm_xor_si128(_mm_xor_si128(x1, _mm_loadu_si128((const __m128i *)buf)), x5);
+        buf += 16;
+        len -= 16;
+    }
+
+    // 128 bits -> 64 bits
+    x2 = _mm_clmulepi64_si128(x1, k3k4, 0x10);
+    x1 = _mm_xor_si128(_mm_srli_si128(x1, 8), x2);
+    x2 = _mm_srli_si128(x1, 4);
+    x1 = _mm_and_si128(x1, mask32);
+    x1 = _mm_clmulepi64_si128(x1, k5k0, 0x00);
+    x1 = _mm_xor_si128(x1, x2);
+
+    // Barrett reduction to 32 bits
+    x2 = _mm_and_si128(x1, mask32);
+    x2 = _mm_clmulepi64_si128(x2, poly, 0x10);
+    x2 = _mm_and_si128(x2, mask32);
+    x2 = _mm_clmulepi64_si128(x2, poly, 0x00);
+    x1 = _mm_xor_si128(x1, x2);
+    crc = (uint32_t)_mm_extract_epi32(x1, 1);
+
+    return tail ? crc32_slice8(crc, buf, tail) : crc;
+}
+#endif
+
+/**
+ *  crc32_select_kernel
+ */
+static crc32_kernel_t crc32_select_kernel(const char * & name)
+{
+    crc32_init_tables();
+#ifdef CRC32_HAVE_PCLMUL
+    __builtin_cpu_init();
+    if(__builtin_cpu_supports("pclmul") && __builtin_cpu_supports("sse4.1")) {
+        name = "pclmul";
+        return crc32_pclmul;
+    }
+#endif
+    name = "slice-by-8";
+    return crc32_slice8;
+}
+
+static const char     *_kernelName = NULL;
+static crc32_kernel_t _kernel = crc32_select_kernel(_kernelName);
+
+uint32_t crc32_fast(uint32_t crc, const void *buf, size_t len)
+{
+    return ~_kernel(~crc, (const unsigned char *)buf, len);
+}
+
+const char *crc32_fast_kernel(void)
+{
+    return _kernelName;
+}
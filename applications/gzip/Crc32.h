@@ -0,0 +1,27 @@
+/** QuickPlay
+ *
+ *  gzip_fpga CRC32 (gzip polynomial) header file
+ *
+ *  crc32_fast() gives the same result as zlib crc32(). It folds 64 bytes
+ *  per step with carry-less multiplies (PCLMULQDQ) when the CPU has them,
+ *  and falls back to a slice-by-8 table kernel otherwise. The kernel is
+ *  selected once, at program start.
+ */
+
+#ifndef CRC32_H
+#define CRC32_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/**
+ *  Update crc (0 for a new stream) with len bytes of buf
+ */
+uint32_t crc32_fast(uint32_t crc, const void *buf, size_t len);
+
+/**
+ *  Name of the kernel used by crc32_fast
+ */
+const char *crc32_fast_kernel(void);
+
+#endif
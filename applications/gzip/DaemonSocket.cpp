@@ -0,0 +1,171 @@
+/** QuickPlay
+ *
+ *  gzip_fpga daemon socket implementation file
+ */
+
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include "DaemonSocket.h"
+
+static int daemon_address( const std::string & path, struct sockaddr_un & addr )
+{
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if(path.empty() || path.size() >= sizeof(addr.sun_path))
+        return -1;
+    strcpy(addr.sun_path, path.c_str());
+    return 0;
+}
+
+int daemon_listen( const std::string & path )
+{
+    struct sockaddr_un addr;
+    if(daemon_address(path, addr))
+        return -1;
+    int sock = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if(sock < 0)
+        return -1;
+    unlink(path.c_str());
+    if(bind(sock, (struct sockaddr *)&addr, sizeof(addr)) || listen(sock, DAEMON_BACKLOG)) {
+        close(sock);
+        return -1;
+    }
+    return sock;
+}
+
+int daemon_connect( const std::string & path )
+{
+    struct sockaddr_un addr;
+    if(daemon_address(path, addr))
+        return -1;
+    int sock = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if(sock < 0)
+        return -1;
+    if(connect(sock, (struct sockaddr *)&addr, sizeof(addr))) {
+        close(sock);
+        return -1;
+    }
+    return sock;
+}
+
+/**
+ *  Whole messages only: the ancillary data travels with the first byte
+ */
+static int send_all( int sock, const void *data, size_t size, struct msghdr *msg )
+{
+    size_t done = 0;
+    while(done < size) {
+        struct iovec iov = { (char *)data + done, size - done };
+        msg->msg_iov = &iov;
+        msg->msg_iovlen = 1;
+        ssize_t ret = sendmsg(sock, msg, MSG_NOSIGNAL);
+        if(ret < 0 && errno == EINTR)
+            continue;
+        if(ret <= 0)
+            return -1;
+        msg->msg_control = NULL;
+        msg->msg_controllen = 0;
+        done += ret;
+    }
+    return 0;
+}
+
+static int recv_all( int sock, void *data, size_t size, struct msghdr *msg )
+{
+    // The descriptors come with the first bytes, later calls must not
+    // overwrite them: msg is given back with the control data received then
+    void *control = msg->msg_control;
+    size_t controlLen = 0;
+    size_t done = 0;
+    while(done < size) {
+        struct iovec iov = { (char *)data + done, size - done };
+        msg->msg_iov = &iov;
+        msg->msg_iovlen = 1;
+        ssize_t ret = recvmsg(sock, msg, MSG_CMSG_CLOEXEC);
+        if(ret < 0 && errno == EINTR)
+            continue;
+        if(ret > 0 && msg->msg_control) {
+            controlLen = msg->msg_controllen;
+            msg->msg_control = NULL;
+            msg->msg_controllen = 0;
+        }
+        if(ret == 0 && !done) {
+            msg->msg_control = control;
+            msg->msg_controllen = controlLen;
+            return 1;
+        }
+        if(ret <= 0) {
+            msg->msg_control = control;
+            msg->msg_controllen = controlLen;
+            return -1;
+        }
+        done += ret;
+    }
+    msg->msg_control = control;
+    msg->msg_controllen = controlLen;
+    return 0;
+}
+
+int daemon_send_job( int sock, const daemon_request_t & req, int fdIn, int fdOut )
+{
+    char control[CMSG_SPACE(2*sizeof(int))];
+    memset(control, 0, sizeof(control));
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+    struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(2*sizeof(int));
+    int fds[2] = { fdIn, fdOut };
+    memcpy(CMSG_DATA(cmsg), fds, sizeof(fds));
+    return send_all(sock, &req, sizeof(req), &msg);
+}
+
+int daemon_recv_job( int sock, daemon_request_t & req, int & fdIn, int & fdOut )
+{
+    char control[CMSG_SPACE(2*sizeof(int))];
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+    fdIn = fdOut = -1;
+
+    int ret = recv_all(sock, &req, sizeof(req), &msg);
+    for(struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg); cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+        if(cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS)
+            continue;
+        size_t nbFds = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+        int fds[2] = { -1, -1 };
+        memcpy(fds, CMSG_DATA(cmsg), (nbFds < 2 ? nbFds : 2)*sizeof(int));
+        fdIn = fds[0];
+        fdOut = fds[1];
+    }
+    if(!ret && req.magic == DAEMON_MAGIC && fdIn >= 0 && fdOut >= 0)
+        return 0;
+
+    if(fdIn >= 0)
+        close(fdIn);
+    if(fdOut >= 0)
+        close(fdOut);
+    fdIn = fdOut = -1;
+    return ret ? ret : -1;
+}
+
+int daemon_send_reply( int sock, const daemon_reply_t & reply )
+{
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    return send_all(sock, &reply, sizeof(reply), &msg);
+}
+
+int daemon_recv_reply( int sock, daemon_reply_t & reply )
+{
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    return recv_all(sock, &reply, sizeof(reply), &msg);
+}
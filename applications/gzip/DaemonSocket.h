@@ -0,0 +1,48 @@
+/** QuickPlay
+ *
+ *  gzip_fpga daemon socket header file
+ *
+ *  A daemon keeps the design open and compresses for clients connected to
+ *  its Unix domain socket. Clients do not copy any data through the socket:
+ *  each job carries the input and output file descriptors (SCM_RIGHTS) and
+ *  the daemon streams one into the other. A client sends one job at a time
+ *  and waits for its reply.
+ */
+
+#ifndef DAEMON_SOCKET_H
+#define DAEMON_SOCKET_H
+
+#include <string>
+
+#define DAEMON_MAGIC            0x475a4450      // "GZDP"
+#define DAEMON_BACKLOG          64              // pending connections
+
+#define DAEMON_OK               0
+#define DAEMON_ERR_COMPRESS     -1              // compression or file I/O failed
+#define DAEMON_ERR_REQUEST      -2              // malformed job
+
+typedef struct {
+    unsigned int    magic;
+    unsigned int    reserved;
+    long long int   chunkSize;          // bytes per gzip member, 0 for the daemon setting
+} daemon_request_t, *PDaemonRequest;
+
+typedef struct {
+    int             status;             // DAEMON_OK or DAEMON_ERR_*
+    int             cpu;                // compressed by the CPU engine
+    long long int   inSize;
+    long long int   outSize;
+    double          secs;               // daemon side, queueing excluded
+} daemon_reply_t, *PDaemonReply;
+
+// Socket fd, -1 on error. A stale socket file at path is replaced.
+int daemon_listen( const std::string & path );
+int daemon_connect( const std::string & path );
+
+// 0 on success, 1 when the peer closed the connection, -1 on error
+int daemon_send_job( int sock, const daemon_request_t & req, int fdIn, int fdOut );
+int daemon_recv_job( int sock, daemon_request_t & req, int & fdIn, int & fdOut );
+int daemon_send_reply( int sock, const daemon_reply_t & reply );
+int daemon_recv_reply( int sock, daemon_reply_t & reply );
+
+#endif
@@ -4,5 +4,5 @@
 
 USER_OBJS :=
 
-LIBS := -lpldaqplaydbg -lpldaqpcie -lpthread -lrt 
+LIBS := -lpldaqplaydbg -lpldaqpcie -lz -lpthread -lrt 
 
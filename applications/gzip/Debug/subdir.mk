@@ -4,12 +4,60 @@
 
 # Add inputs and outputs from these tool invocations to the build variables 
 CPP_SRCS += \
+../BoardScheduler.cpp \
+../BufferPool.cpp \
+../CostModel.cpp \
+../Crc32.cpp \
+../DaemonSocket.cpp \
+../DesignCache.cpp \
+../DmaStats.cpp \
+../EntropyScan.cpp \
+../GzipIndex.cpp \
+../GzipSession.cpp \
+../InflateVerifier.cpp \
+../IoRing.cpp \
+../Metrics.cpp \
+../SwDeflate.cpp \
+../SwInflate.cpp \
+../TreeWalker.cpp \
 ../gzip_fpga.cpp 
 
 OBJS += \
+./BoardScheduler.o \
+./BufferPool.o \
+./CostModel.o \
+./Crc32.o \
+./DaemonSocket.o \
+./DesignCache.o \
+./DmaStats.o \
+./EntropyScan.o \
+./GzipIndex.o \
+./GzipSession.o \
+./InflateVerifier.o \
+./IoRing.o \
+./Metrics.o \
+./SwDeflate.o \
+./SwInflate.o \
+./TreeWalker.o \
 ./gzip_fpga.o 
 
 CPP_DEPS += \
+./BoardScheduler.d \
+./BufferPool.d \
+./CostModel.d \
+./Crc32.d \
+./DaemonSocket.d \
+./DesignCache.d \
+./DmaStats.d \
+./EntropyScan.d \
+./GzipIndex.d \
+./GzipSession.d \
+./InflateVerifier.d \
+./IoRing.d \
+./Metrics.d \
+./SwDeflate.d \
+./SwInflate.d \
+./TreeWalker.d \
 ./gzip_fpga.d 
 
 # Define QPSDKINCLUDE reading QuickPlaySDK environment variable
@@ -0,0 +1,113 @@
+/** QuickPlay
+ *
+ *  gzip_fpga design discovery cache implementation file
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <fstream>
+#include <sstream>
+#include "DesignCache.h"
+
+DesignCache::DesignCache( const std::string & path ) :
+    _path( path ),
+    _dirty( false )
+{
+    std::ifstream file(_path.c_str());
+    std::string line;
+    // One entry per line: udid, board, mtime, search path, JSON file
+    while(std::getline(file, line)) {
+        std::istringstream fields(line);
+        std::string udid, board, mtime, searchPath, jsonFile;
+        if(!std::getline(fields, udid, '\t') || !std::getline(fields, board, '\t') ||
+           !std::getline(fields, mtime, '\t') || !std::getline(fields, searchPath, '\t') ||
+           !std::getline(fields, jsonFile))
+            continue;
+        design_entry_t entry;
+        entry.jsonFile = jsonFile;
+        entry.mtime    = atoll(mtime.c_str());
+        entry.board    = atoi(board.c_str());
+        _entries[udid + '\t' + searchPath] = entry;
+    }
+}
+
+long long int DesignCache::fileMtime( const std::string & path )
+{
+    struct stat st;
+    if(stat(path.c_str(), &st))
+        return -1;
+    return (long long int)st.st_mtim.tv_sec * 1000000000LL + st.st_mtim.tv_nsec;
+}
+
+std::string DesignCache::lookup( const std::string & udid, const std::string & searchPath )
+{
+    std::map<std::string, design_entry_t>::iterator it = _entries.find(udid + '\t' + searchPath);
+    if(it == _entries.end())
+        return "";
+    if(fileMtime(it->second.jsonFile) != it->second.mtime) {
+        _entries.erase(it);
+        _dirty = true;
+        return "";
+    }
+    const std::string & jsonFile = it->second.jsonFile;
+    return jsonFile.substr(0, jsonFile.rfind('/') + 1);
+}
+
+void DesignCache::store( const std::string & udid, const std::string & searchPath, const std::string & jsonFile, unsigned int board )
+{
+    // The file format has no escaping
+    if((udid + searchPath + jsonFile).find_first_of("\t\n") != std::string::npos || jsonFile.find('/') == std::string::npos)
+        return;
+    design_entry_t entry;
+    entry.jsonFile = jsonFile;
+    entry.mtime    = fileMtime(jsonFile);
+    entry.board    = board;
+    if(entry.mtime < 0)
+        return;
+    _entries[udid + '\t' + searchPath] = entry;
+    _dirty = true;
+}
+
+int DesignCache::save( void )
+{
+    if(!_dirty || _path.empty())
+        return 0;
+
+    // Create the cache folders, ~/.cache itself may not exist yet
+    for(size_t slash = _path.find('/', 1); slash != std::string::npos; slash = _path.find('/', slash+1))
+        mkdir(_path.substr(0, slash).c_str(), 0755);
+
+    // Written aside then renamed: concurrent runs never see half a file
+    std::string tmpPath = _path + ".tmp." + std::to_string(getpid());
+    {
+        std::ofstream file(tmpPath.c_str(), std::ios::trunc);
+        for(std::map<std::string, design_entry_t>::iterator it=_entries.begin(); it!=_entries.end(); ++it) {
+            size_t tab = it->first.find('\t');
+            file << it->first.substr(0, tab) << '\t' << it->second.board << '\t' << it->second.mtime << '\t'
+                 << it->first.substr(tab+1) << '\t' << it->second.jsonFile << '\n';
+        }
+        if(!file.good()) {
+            unlink(tmpPath.c_str());
+            return -1;
+        }
+    }
+    if(rename(tmpPath.c_str(), _path.c_str())) {
+        unlink(tmpPath.c_str());
+        return -1;
+    }
+    _dirty = false;
+    return 0;
+}
+
+std::string DesignCache::defaultPath( void )
+{
+    const char *cacheHome = getenv("XDG_CACHE_HOME");
+    if(cacheHome && *cacheHome)
+        return std::string(cacheHome) + "/" + DESIGN_CACHE_FILE;
+    const char *home = getenv("HOME");
+    if(home && *home)
+        return std::string(home) + "/.cache/" + DESIGN_CACHE_FILE;
+    return "";
+}
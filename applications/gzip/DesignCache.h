@@ -0,0 +1,54 @@
+/** QuickPlay
+ *
+ *  gzip_fpga design discovery cache header file
+ *
+ *  Finding the JSON file of the loaded design means parsing every JSON file
+ *  under the search path until one has the UDID read from the board. The
+ *  cache remembers where each UDID was found, for each search path, in a
+ *  small text file shared by all the runs. An entry is only trusted while
+ *  its JSON file is still there with the same mtime, otherwise it is
+ *  dropped and the search path scanned again.
+ */
+
+#ifndef DESIGN_CACHE_H
+#define DESIGN_CACHE_H
+
+#include <string>
+#include <map>
+
+#define DESIGN_CACHE_FILE       "gzip_fpga/designs"     // under $XDG_CACHE_HOME or ~/.cache
+
+typedef struct {
+    std::string     jsonFile;           // JSON file holding the UDID
+    long long int   mtime;              // of jsonFile, nanoseconds
+    unsigned int    board;              // board the design was last found on
+} design_entry_t;
+
+class DesignCache {
+
+    public:
+    // Loads path, a missing or unreadable file is an empty cache
+    DesignCache( const std::string & path );
+
+    // JSON directory of udid under searchPath, "" on a miss or a stale entry
+    std::string lookup( const std::string & udid, const std::string & searchPath );
+
+    void store( const std::string & udid, const std::string & searchPath, const std::string & jsonFile, unsigned int board );
+
+    // Write the cache back if it changed, 0 on success
+    int save( void );
+
+    static std::string defaultPath( void );
+
+    private:
+    DesignCache( const DesignCache & );
+    DesignCache & operator=( const DesignCache & );
+
+    static long long int fileMtime( const std::string & path );
+
+    std::string                             _path;
+    std::map<std::string, design_entry_t>   _entries;   // udid + '\t' + search path
+    bool                                    _dirty;
+};
+
+#endif
@@ -0,0 +1,160 @@
+/** QuickPlay
+ *
+ *  gzip_fpga DMA transfer statistics implementation file
+ */
+
+#include <math.h>
+#include <map>
+#include <deque>
+#include <mutex>
+#include <chrono>
+#include "DmaStats.h"
+
+using namespace QuickPlayLib;
+
+DmaHistogram::DmaHistogram() :
+    _count( 0 ),
+    _sum( 0 ),
+    _max( 0 )
+{
+    for(unsigned int i=0; i<DMA_HIST_BUCKETS; i++)
+        _buckets[i] = 0;
+}
+
+/**
+ *  Values below 16 have their own bucket, larger ones are split in 16
+ *  buckets per power of two
+ */
+unsigned int DmaHistogram::index( unsigned long long int value )
+{
+    if(value < (1ULL << DMA_HIST_SUB_BITS))
+        return (unsigned int)value;
+    unsigned int exp = 63 - __builtin_clzll(value);
+    unsigned int sub = (unsigned int)(value >> (exp-DMA_HIST_SUB_BITS)) & ((1 << DMA_HIST_SUB_BITS)-1);
+    return ((exp-DMA_HIST_SUB_BITS+1) << DMA_HIST_SUB_BITS) + sub;
+}
+
+unsigned long long int DmaHistogram::upper( unsigned int index )
+{
+    if(index < (1U << DMA_HIST_SUB_BITS))
+        return index;
+    unsigned int exp = (index >> DMA_HIST_SUB_BITS) + DMA_HIST_SUB_BITS-1;
+    unsigned long long int sub = index & ((1 << DMA_HIST_SUB_BITS)-1);
+    unsigned long long int lower = ((1ULL << DMA_HIST_SUB_BITS) + sub) << (exp-DMA_HIST_SUB_BITS);
+    return lower + (1ULL << (exp-DMA_HIST_SUB_BITS)) - 1;
+}
+
+void DmaHistogram::record( unsigned long long int value )
+{
+    _buckets[index(value)].fetch_add(1, std::memory_order_relaxed);
+    _count.fetch_add(1, std::memory_order_relaxed);
+    _sum.fetch_add(value, std::memory_order_relaxed);
+    unsigned long long int max = _max.load(std::memory_order_relaxed);
+    while(value > max && !_max.compare_exchange_weak(max, value, std::memory_order_relaxed))
+        ;
+}
+
+double DmaHistogram::mean() const
+{
+    unsigned long long int count = _count.load(std::memory_order_relaxed);
+    return count ? (double)_sum.load(std::memory_order_relaxed) / count : 0.0;
+}
+
+unsigned long long int DmaHistogram::percentile( double pct ) const
+{
+    unsigned long long int count = _count.load(std::memory_order_relaxed);
+    if(!count)
+        return 0;
+    unsigned long long int rank = (unsigned long long int)ceil(pct/100.0*count);
+    if(rank < 1)
+        rank = 1;
+    unsigned long long int seen = 0;
+    for(unsigned int i=0; i<DMA_HIST_BUCKETS; i++) {
+        seen += _buckets[i].load(std::memory_order_relaxed);
+        if(seen >= rank) {
+            unsigned long long int value = upper(i);
+            unsigned long long int max = _max.load(std::memory_order_relaxed);
+            return value < max ? value : max;
+        }
+    }
+    return _max.load(std::memory_order_relaxed);
+}
+
+static DmaHistogram histograms[DMA_NB_HISTS];
+
+const DmaHistogram & dma_histogram( int hist )
+{
+    return histograms[hist];
+}
+
+/**
+ *  EOP gap: the producer and consumer EOPs of a device are paired in order,
+ *  whichever comes second records the gap
+ */
+typedef std::chrono::time_point<std::chrono::steady_clock> dma_time_t;
+typedef struct {
+    std::deque<dma_time_t>  producer;
+    std::deque<dma_time_t>  consumer;
+} eop_queues_t;
+
+static std::mutex eopMtx;
+static std::map<const void *, eop_queues_t> eopQueues;
+
+static void record_eop( const void *dev, bool producer, dma_time_t now )
+{
+    std::lock_guard<std::mutex> lock(eopMtx);
+    eop_queues_t & queues = eopQueues[dev];
+    std::deque<dma_time_t> & mine   = producer ? queues.producer : queues.consumer;
+    std::deque<dma_time_t> & theirs = producer ? queues.consumer : queues.producer;
+    if(theirs.empty()) {
+        mine.push_back(now);
+        return;
+    }
+    dma_time_t prodTime = producer ? now : theirs.front();
+    dma_time_t consTime = producer ? theirs.front() : now;
+    theirs.pop_front();
+    long long int gap = std::chrono::duration_cast<std::chrono::nanoseconds>(consTime - prodTime).count();
+    histograms[DMA_EOP_GAP_NS].record(gap > 0 ? gap : 0);
+}
+
+int dma_write_stream( QpDesign & dev, QpStream & stream, void *buffer, unsigned int size, bool eop )
+{
+    dma_time_t start = std::chrono::steady_clock::now();
+    int err = dev.qpWriteStream(stream, buffer, size, eop);
+    dma_time_t end = std::chrono::steady_clock::now();
+
+    histograms[DMA_WRITE_BYTES].record(size);
+    histograms[DMA_WRITE_NS].record(std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count());
+    if(eop && !err)
+        record_eop(&dev, true, end);
+    return err;
+}
+
+int dma_read_stream( QpDesign & dev, QpStream & stream, void *buffer, unsigned int size, bool & eop, unsigned int & readBytes )
+{
+    // Consumers read one member at a time: until the first bytes of a
+    // member come back, possibly over several calls, they wait for the core
+    static thread_local bool inMember = false;
+    static thread_local bool waiting = false;
+    static thread_local dma_time_t waitStart;
+
+    dma_time_t start = std::chrono::steady_clock::now();
+    if(!inMember && !waiting) {
+        waiting = true;
+        waitStart = start;
+    }
+    int err = dev.qpReadStream(stream, buffer, size, eop, readBytes);
+    dma_time_t end = std::chrono::steady_clock::now();
+
+    histograms[DMA_READ_BYTES].record(readBytes);
+    histograms[DMA_READ_NS].record(std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count());
+    if(waiting && (readBytes || eop || err)) {
+        if(!err)
+            histograms[DMA_FIRST_BYTE_NS].record(std::chrono::duration_cast<std::chrono::nanoseconds>(end - waitStart).count());
+        waiting = false;
+    }
+    inMember = !eop && !err && (inMember || readBytes);
+    if(eop && !err)
+        record_eop(&dev, false, end);
+    return err;
+}
@@ -0,0 +1,75 @@
+/** QuickPlay
+ *
+ *  gzip_fpga DMA transfer statistics header file
+ *
+ *  Every qpWriteStream/qpReadStream call goes through dma_write_stream()
+ *  and dma_read_stream(), which feed log-linear (HDR style) histograms:
+ *  16 buckets per power of two, so any recorded value is known within
+ *  6.25%, recorded with relaxed atomic increments and no lock.
+ *
+ *    write/read bytes and time per call: PCIe side
+ *    first byte wait: time the consumer is blocked on each member before
+ *                     any data comes back, i.e. the core latency
+ *    EOP gap: producer EOP to the matching consumer EOP, per device
+ */
+
+#ifndef DMA_STATS_H
+#define DMA_STATS_H
+
+#include <atomic>
+#include "QpDevice.h"
+
+#define DMA_HIST_SUB_BITS       4
+#define DMA_HIST_BUCKETS        (64 << DMA_HIST_SUB_BITS)
+
+#define DMA_WRITE_BYTES         0
+#define DMA_WRITE_NS            1
+#define DMA_READ_BYTES          2
+#define DMA_READ_NS             3
+#define DMA_FIRST_BYTE_NS       4
+#define DMA_EOP_GAP_NS          5
+#define DMA_NB_HISTS            6
+
+class DmaHistogram {
+
+    public:
+    DmaHistogram();
+
+    void record( unsigned long long int value );
+
+    unsigned long long int count() const
+    { return _count.load(std::memory_order_relaxed); }
+
+    unsigned long long int sum() const
+    { return _sum.load(std::memory_order_relaxed); }
+
+    unsigned long long int max() const
+    { return _max.load(std::memory_order_relaxed); }
+
+    double mean() const;
+
+    // Highest value of the bucket holding the pct percentile, 0 if empty
+    unsigned long long int percentile( double pct ) const;
+
+    private:
+    DmaHistogram( const DmaHistogram & );
+    DmaHistogram & operator=( const DmaHistogram & );
+
+    static unsigned int index( unsigned long long int value );
+    static unsigned long long int upper( unsigned int index );
+
+    std::atomic<unsigned long long int> _buckets[DMA_HIST_BUCKETS];
+    std::atomic<unsigned long long int> _count;
+    std::atomic<unsigned long long int> _sum;
+    std::atomic<unsigned long long int> _max;
+};
+
+// Instrumented transfers, same arguments and return codes as the QpDesign calls
+int dma_write_stream( QuickPlayLib::QpDesign & dev, QuickPlayLib::QpStream & stream, void *buffer, unsigned int size, bool eop );
+int dma_read_stream( QuickPlayLib::QpDesign & dev, QuickPlayLib::QpStream & stream, void *buffer, unsigned int size,
+                     bool & eop, unsigned int & readBytes );
+
+// Process-wide histograms, DMA_* index
+const DmaHistogram & dma_histogram( int hist );
+
+#endif
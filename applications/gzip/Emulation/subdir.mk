@@ -0,0 +1,80 @@
+################################################################################
+# Automatically-generated file. Do not edit!
+################################################################################
+
+# Add inputs and outputs from these tool invocations to the build variables 
+CPP_SRCS += \
+../BoardScheduler.cpp \
+../BufferPool.cpp \
+../CostModel.cpp \
+../Crc32.cpp \
+../DaemonSocket.cpp \
+../DesignCache.cpp \
+../DmaStats.cpp \
+../EntropyScan.cpp \
+../GzipIndex.cpp \
+../GzipSession.cpp \
+../InflateVerifier.cpp \
+../IoRing.cpp \
+../Metrics.cpp \
+../QpEmulator.cpp \
+../SwDeflate.cpp \
+../SwInflate.cpp \
+../TreeWalker.cpp \
+../gzip_fpga.cpp 
+
+OBJS += \
+./BoardScheduler.o \
+./BufferPool.o \
+./CostModel.o \
+./Crc32.o \
+./DaemonSocket.o \
+./DesignCache.o \
+./DmaStats.o \
+./EntropyScan.o \
+./GzipIndex.o \
+./GzipSession.o \
+./InflateVerifier.o \
+./IoRing.o \
+./Metrics.o \
+./QpEmulator.o \
+./SwDeflate.o \
+./SwInflate.o \
+./TreeWalker.o \
+./gzip_fpga.o 
+
+CPP_DEPS += \
+./BoardScheduler.d \
+./BufferPool.d \
+./CostModel.d \
+./Crc32.d \
+./DaemonSocket.d \
+./DesignCache.d \
+./DmaStats.d \
+./EntropyScan.d \
+./GzipIndex.d \
+./GzipSession.d \
+./InflateVerifier.d \
+./IoRing.d \
+./Metrics.d \
+./QpEmulator.d \
+./SwDeflate.d \
+./SwInflate.d \
+./TreeWalker.d \
+./gzip_fpga.d 
+
+# Emulated board: no QuickPlay SDK needed, design files are taken from this repository
+QPEMUDEFS := -DQP_EMULATION \
+	-DJSON_SEARCH_PATH=\"$(abspath ../../../bitstream)/\" \
+	-DLIC_SEARCH_PATH=\"$(abspath ../../../bitstream)/\" \
+	-DSAMPLE_FILES_PATH=\"$(abspath ../../sample_files)/\"
+
+# Each subdirectory must supply rules for building sources it contributes
+%.o: ../%.cpp
+	@echo 'Building file: $<'
+	@echo 'Invoking: GCC C++ Compiler'
+	g++ $(QPEMUDEFS) -std=c++0x -O2 -Wall -c -fmessage-length=0 -MMD -MP -MF"$(@:%.o=%.d)" -MT"$(@:%.o=%.d)" -o "$@" "$<"
+	@echo 'Finished building: $<'
+	@echo ' '
+
+
@@ -0,0 +1,89 @@
+/** QuickPlay
+ *
+ *  gzip_fpga entropy pre-scan implementation file
+ */
+
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+#include "EntropyScan.h"
+
+#define MATCH_HASH_BITS         12          // 4-byte sequences hashed into 4096 entries
+
+/**
+ *  Byte entropy of a window, in bits per byte. Four histograms are filled
+ *  in turn, so consecutive bytes never wait on the same counter, and are
+ *  summed at the end.
+ */
+static double window_entropy(const unsigned char *in, size_t len)
+{
+    uint32_t counts[4][256];
+    memset(counts, 0, sizeof(counts));
+    size_t i = 0;
+    for(; i+4 <= len; i+=4) {
+        counts[0][in[i]]++;
+        counts[1][in[i+1]]++;
+        counts[2][in[i+2]]++;
+        counts[3][in[i+3]]++;
+    }
+    for(; i<len; i++)
+        counts[0][in[i]]++;
+
+    double bits = 0.0;
+    for(int c=0; c<256; c++) {
+        uint32_t n = counts[0][c] + counts[1][c] + counts[2][c] + counts[3][c];
+        if(n) {
+            double p = (double)n/len;
+            bits -= p*log2(p);
+        }
+    }
+    return bits;
+}
+
+/**
+ *  Share of the 4-byte sequences of a window found earlier in it. The hash
+ *  table keeps the last position of each sequence, as deflate's does.
+ */
+static double window_match_rate(const unsigned char *in, size_t len)
+{
+    uint16_t last[1 << MATCH_HASH_BITS];    // position + 1, 0 for none
+    memset(last, 0, sizeof(last));
+    size_t matches = 0;
+    for(size_t i=0; i+4 <= len; i++) {
+        uint32_t seq;
+        memcpy(&seq, &in[i], 4);
+        uint32_t h = (seq * 2654435761u) >> (32 - MATCH_HASH_BITS);
+        if(last[h] && !memcmp(&in[last[h]-1], &in[i], 4))
+            matches++;
+        last[h] = (uint16_t)(i+1);
+    }
+    return len > 3 ? (double)matches/(len-3) : 0.0;
+}
+
+bool entropy_scan(const char *data, size_t size, entropy_stats_t & stats)
+{
+    memset(&stats, 0, sizeof(stats));
+    if(size < ENTROPY_WINDOW_SIZE)
+        return false;
+
+    // Windows spread evenly, the last one ends with the data. The first
+    // compressible window ends the scan.
+    size_t nbWindows = size/ENTROPY_WINDOW_SIZE;
+    if(nbWindows > ENTROPY_MAX_WINDOWS)
+        nbWindows = ENTROPY_MAX_WINDOWS;
+    size_t stride = nbWindows > 1 ? (size - ENTROPY_WINDOW_SIZE)/(nbWindows-1) : 0;
+    for(size_t w=0; w<nbWindows; w++) {
+        const unsigned char *in = (const unsigned char *)&data[w*stride];
+        double bits = window_entropy(in, ENTROPY_WINDOW_SIZE);
+        double rate = window_match_rate(in, ENTROPY_WINDOW_SIZE);
+        stats.windows++;
+        stats.bitsPerByte += bits;
+        stats.matchRate += rate;
+        if(bits < ENTROPY_MIN_BITS || rate > ENTROPY_MAX_MATCH_RATE)
+            break;
+        stats.incompressible++;
+    }
+    stats.bitsPerByte /= stats.windows;
+    stats.matchRate /= stats.windows;
+    return stats.incompressible == stats.windows;
+}
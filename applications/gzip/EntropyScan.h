@@ -0,0 +1,38 @@
+/** QuickPlay
+ *
+ *  gzip_fpga entropy pre-scan header file
+ *
+ *  Already compressed or encrypted data does not shrink: sending it to the
+ *  device costs the PCIe transfers both ways and an archive slightly larger
+ *  than the input. Before an input is compressed, a few windows spread over
+ *  it are sampled. Each window gets its byte entropy, from a histogram, and
+ *  a match rate, the share of its 4-byte sequences already seen earlier in
+ *  the window as deflate would find them. Only when every window has both a
+ *  near 8 bits per byte entropy and almost no matches is the input deemed
+ *  incompressible; it is then written as stored deflate blocks on the host.
+ */
+
+#ifndef ENTROPY_SCAN_H
+#define ENTROPY_SCAN_H
+
+#include <stddef.h>
+
+#define ENTROPY_WINDOW_SIZE     4096        // bytes per sampled window, smaller inputs are not scanned
+#define ENTROPY_MAX_WINDOWS     64          // windows sampled per input
+#define ENTROPY_MIN_BITS        7.85        // random bytes give 7.95 over a window
+#define ENTROPY_MAX_MATCH_RATE  0.01        // share of 4-byte sequences found earlier in the window
+
+typedef struct {
+    unsigned int    windows;            // windows sampled
+    unsigned int    incompressible;     // windows over both thresholds
+    double          bitsPerByte;        // mean entropy of the windows
+    double          matchRate;          // mean match rate of the windows
+} entropy_stats_t;
+
+/**
+ *  Sample the size bytes at data. Returns true when the data is not worth
+ *  compressing: every sampled window is incompressible.
+ */
+bool entropy_scan(const char *data, size_t size, entropy_stats_t & stats);
+
+#endif
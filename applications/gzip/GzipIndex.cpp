@@ -0,0 +1,117 @@
+/** QuickPlay
+ *
+ *  gzip_fpga seekable archive index implementation file
+ */
+
+#include <stdio.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <fstream>
+#include <algorithm>
+#include "GzipIndex.h"
+
+void gzip_index_add( gzip_index_t & index, unsigned long long inSize, unsigned long long outSize )
+{
+    gzip_index_entry_t entry = { 0, 0 };
+    if(index.empty())
+        index.push_back(entry);
+    entry.inOffset  = index.back().inOffset + inSize;
+    entry.outOffset = index.back().outOffset + outSize;
+    index.push_back(entry);
+}
+
+static void put_le( std::string & out, unsigned long long value, int nbBytes )
+{
+    for(int i=0; i<nbBytes; i++)
+        out += (char)((value >> (8*i)) & 0xff);
+}
+
+static unsigned long long get_le( const unsigned char *in, int nbBytes )
+{
+    unsigned long long value = 0;
+    for(int i=nbBytes-1; i>=0; i--)
+        value = (value << 8) | in[i];
+    return value;
+}
+
+int gzip_index_save( const std::string & path, const gzip_index_t & index )
+{
+    std::string out;
+    put_le(out, GZIP_INDEX_MAGIC, 4);
+    put_le(out, GZIP_INDEX_VERSION, 4);
+    put_le(out, index.size(), 8);
+    for(size_t i=0; i<index.size(); i++) {
+        put_le(out, index[i].inOffset, 8);
+        put_le(out, index[i].outOffset, 8);
+    }
+
+    // Written aside then renamed: a reader never sees half an index
+    std::string tmpPath = path + ".tmp." + std::to_string(getpid());
+    {
+        std::ofstream file(tmpPath.c_str(), std::ios::binary | std::ios::trunc);
+        file.write(out.data(), out.size());
+        if(!file.good()) {
+            unlink(tmpPath.c_str());
+            return -1;
+        }
+    }
+    if(rename(tmpPath.c_str(), path.c_str())) {
+        unlink(tmpPath.c_str());
+        return -1;
+    }
+    return 0;
+}
+
+int gzip_index_load( const std::string & path, gzip_index_t & index )
+{
+    index.clear();
+    std::ifstream file(path.c_str(), std::ios::binary);
+    unsigned char header[16];
+    if(!file.read((char *)header, sizeof(header)))
+        return -1;
+    if(get_le(header, 4) != GZIP_INDEX_MAGIC || get_le(&header[4], 4) != GZIP_INDEX_VERSION)
+        return -1;
+
+    unsigned long long count = get_le(&header[8], 8);
+    unsigned char entry[16];
+    for(unsigned long long i=0; i<count; i++) {
+        if(!file.read((char *)entry, sizeof(entry)))
+            break;
+        gzip_index_entry_t e = { get_le(entry, 8), get_le(&entry[8], 8) };
+        if(!index.empty() && (e.inOffset < index.back().inOffset || e.outOffset <= index.back().outOffset))
+            break;
+        index.push_back(e);
+    }
+    if(index.size() != count || count < 2 || index[0].inOffset || index[0].outOffset) {
+        index.clear();
+        return -1;
+    }
+    return 0;
+}
+
+int gzip_index_load_archive( const std::string & archive, unsigned long long size, gzip_index_t & index )
+{
+    // The sidecar is saved once the archive is closed
+    std::string path = archive + GZIP_INDEX_SUFFIX;
+    struct stat stArchive, stIndex;
+    index.clear();
+    if(stat(archive.c_str(), &stArchive) || stat(path.c_str(), &stIndex))
+        return -1;
+    if(stIndex.st_mtim.tv_sec < stArchive.st_mtim.tv_sec ||
+       (stIndex.st_mtim.tv_sec == stArchive.st_mtim.tv_sec && stIndex.st_mtim.tv_nsec < stArchive.st_mtim.tv_nsec))
+        return -1;
+    if(gzip_index_load(path, index) || index.back().outOffset != size) {
+        index.clear();
+        return -1;
+    }
+    return 0;
+}
+
+size_t gzip_index_find( const gzip_index_t & index, unsigned long long offset )
+{
+    if(index.size() < 2 || offset >= index.back().inOffset)
+        return index.empty() ? 0 : index.size()-1;
+    size_t i = std::upper_bound(index.begin(), index.end(), offset,
+                                []( unsigned long long o, const gzip_index_entry_t & e ) { return o < e.inOffset; }) - index.begin();
+    return i-1;
+}
@@ -0,0 +1,59 @@
+/** QuickPlay
+ *
+ *  gzip_fpga seekable archive index header file
+ *
+ *  In index mode the input is compressed as independent gzip members, one
+ *  per stream chunk, and the uncompressed and archive offsets of every
+ *  member start are saved in a sidecar file next to the archive. A byte
+ *  range of the original data is then read by inflating only the members
+ *  that hold it, and the member starts need no scan to be decompressed in
+ *  parallel. The archive itself stays a plain multi-member gzip file.
+ *
+ *  Sidecar layout, little endian: magic, version, number of entries (32-bit
+ *  words), then one entry per member and a last one with the total sizes.
+ */
+
+#ifndef GZIP_INDEX_H
+#define GZIP_INDEX_H
+
+#include <string>
+#include <vector>
+
+#define GZIP_INDEX_MAGIC        0x58495a47      // "GZIX"
+#define GZIP_INDEX_VERSION      1
+#define GZIP_INDEX_SUFFIX       ".idx"          // appended to the archive name
+
+typedef struct {
+    unsigned long long  inOffset;       // offset in the uncompressed data
+    unsigned long long  outOffset;      // offset in the archive
+} gzip_index_entry_t;
+
+typedef std::vector<gzip_index_entry_t> gzip_index_t;
+
+/**
+ *  Append a member of inSize bytes compressed to outSize bytes: the entry
+ *  with the total sizes moves behind it
+ */
+void gzip_index_add(gzip_index_t & index, unsigned long long inSize, unsigned long long outSize);
+
+/**
+ *  Write or read a sidecar file, 0 on success. A file that is not an index,
+ *  or whose entries are not in order, fails to load.
+ */
+int gzip_index_save(const std::string & path, const gzip_index_t & index);
+int gzip_index_load(const std::string & path, gzip_index_t & index);
+
+/**
+ *  Load the sidecar of an archive of size bytes, 0 when it describes it: it
+ *  ends at the archive size and was not written before the archive. The
+ *  index of an archive since rewritten without one is left on disk but
+ *  fails to load.
+ */
+int gzip_index_load_archive(const std::string & archive, unsigned long long size, gzip_index_t & index);
+
+/**
+ *  Member holding uncompressed offset, index.size()-1 past the end
+ */
+size_t gzip_index_find(const gzip_index_t & index, unsigned long long offset);
+
+#endif
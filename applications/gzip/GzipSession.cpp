@@ -0,0 +1,214 @@
+/** QuickPlay
+ *
+ *  gzip_fpga compression session implementation file
+ */
+
+#include <iostream>
+#include "GzipSession.h"
+#include "DmaStats.h"
+#include "Metrics.h"
+
+using namespace QuickPlayLib;
+
+#define SESSION_RW_SIZE_LIMIT   0xFFFFFFFF      // SGDMAR transfer limit
+#define SESSION_SCRATCH_SIZE    0x10000
+
+GzipSession::GzipSession( QpDesign & device, unsigned int maxInflight ) :
+    _dev( device ),
+    _streamIn( "file_in", 3 ),
+    _streamOut( "archive_out", 3 ),
+    _maxInflight( maxInflight ? maxInflight : 1 ),
+    _inflight( 0 ),
+    _opened( false ),
+    _stop( false )
+{}
+
+GzipSession::~GzipSession()
+{
+    close();
+}
+
+int GzipSession::open( void )
+{
+    if(_opened)
+        return 0;
+
+    if (_dev.qpOpenStream(_streamIn)) {
+        std::cerr << KRED << "GzipSession: Call OpenStream failed for QpStream data_in" << KNRM << std::endl;
+        return -1;
+    }
+    if (_dev.qpOpenStream(_streamOut)) {
+        std::cerr << KRED << "GzipSession: Call OpenStream failed for QpStream data_out" << KNRM << std::endl;
+        _dev.qpCloseStream(_streamIn);
+        return -1;
+    }
+
+    _stop = false;
+    _opened = true;
+    _producer = std::thread(&GzipSession::tProducer, this);
+    _consumer = std::thread(&GzipSession::tConsumer, this);
+    return 0;
+}
+
+void GzipSession::close( void )
+{
+    if(!_opened)
+        return;
+
+    {
+        std::unique_lock<std::mutex> lock(_mtx);
+        _cv.wait(lock, [this]{ return _toSend.empty() && _toReceive.empty(); });
+        _stop = true;
+        _cv.notify_all();
+    }
+    _producer.join();
+    _consumer.join();
+
+    _dev.qpCloseStream(_streamIn);
+    _dev.qpCloseStream(_streamOut);
+    _opened = false;
+}
+
+int GzipSession::submit( session_job_t *job )
+{
+    if(!_opened || !job)
+        return -1;
+
+    std::unique_lock<std::mutex> lock(_mtx);
+    _cv.wait(lock, [this]{ return _inflight < _maxInflight; });
+    job->outSize = 0;
+    job->err = 0;
+    job->submitTime = std::chrono::steady_clock::now();
+    _inflight++;
+    metrics_gauge_add(METRIC_QUEUE_DEPTH, 1);
+    _toSend.push_back(job);
+    _cv.notify_all();
+    return 0;
+}
+
+session_job_t * GzipSession::getCompleted( bool wait )
+{
+    std::unique_lock<std::mutex> lock(_mtx);
+    if(wait)
+        _cv.wait(lock, [this]{ return !_completed.empty() || _inflight == 0; });
+    if(_completed.empty())
+        return NULL;
+
+    session_job_t *job = _completed.front();
+    _completed.pop_front();
+    _inflight--;
+    _cv.notify_all();
+    return job;
+}
+
+unsigned int GzipSession::inflight( void )
+{
+    std::lock_guard<std::mutex> lock(_mtx);
+    return _inflight;
+}
+
+/**
+ * Producer thread: send each job as one EOP packet
+ */
+void GzipSession::tProducer( void )
+{
+    while(true) {
+        session_job_t *job;
+        {
+            std::unique_lock<std::mutex> lock(_mtx);
+            _cv.wait(lock, [this]{ return _stop || !_toSend.empty(); });
+            if(_toSend.empty())
+                return;
+            job = _toSend.front();
+            _toSend.pop_front();
+
+            // Hand the job to the consumer first: big outputs must be drained
+            // while the input is still being sent
+            _toReceive.push_back(job);
+            _cv.notify_all();
+        }
+
+        // All packets of the job go out from the same buffer, EOP on each
+        unsigned int nbParts = job->nbParts ? job->nbParts : 1;
+        char *buffer = job->inBuffer;
+        for(unsigned int part=0; part<nbParts; part++) {
+            long long int partSize = job->nbParts ? job->partInSizes[part] : job->inSize;
+            long long int sent = 0;
+            do {
+                long long int remaining = partSize - sent;
+                bool eop = (remaining <= SESSION_RW_SIZE_LIMIT);
+                unsigned int size = eop ? (unsigned int)remaining : SESSION_RW_SIZE_LIMIT;
+                if(dma_write_stream(_dev, _streamIn, &buffer[sent], size, eop)) {
+                    std::cerr << KRED << "GzipSession: Data Write to FPGA error" << KNRM << std::endl;
+                    job->err = -1;
+                }
+                sent += size;
+            } while(sent < partSize);
+            buffer += partSize;
+        }
+    }
+}
+
+/**
+ * Read one gzip member (up to its EOP) at the end of the job output buffer
+ */
+int GzipSession::readMember( session_job_t *job, char *scratch )
+{
+    bool eop = false;
+    while(!eop) {
+        unsigned int readBytes = 0;
+        long long int room = job->outCapacity - job->outSize;
+        int err;
+        if(room > 0) {
+            unsigned int size = room < SESSION_RW_SIZE_LIMIT ? (unsigned int)room : SESSION_RW_SIZE_LIMIT;
+            err = dma_read_stream(_dev, _streamOut, &job->outBuffer[job->outSize], size, eop, readBytes);
+            job->outSize += readBytes;
+        }
+        else {
+            // Output buffer too small: keep draining to stay in sync with EOPs
+            err = dma_read_stream(_dev, _streamOut, scratch, SESSION_SCRATCH_SIZE, eop, readBytes);
+            job->err = -2;
+        }
+        if(err) {
+            std::cerr << KRED << "GzipSession: Data Read from FPGA error" << KNRM << std::endl;
+            job->err = -1;
+            return -1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * Consumer thread: read back the gzip members of each job, in submission order
+ */
+void GzipSession::tConsumer( void )
+{
+    char scratch[SESSION_SCRATCH_SIZE];
+
+    while(true) {
+        session_job_t *job;
+        {
+            std::unique_lock<std::mutex> lock(_mtx);
+            _cv.wait(lock, [this]{ return _stop || !_toReceive.empty(); });
+            if(_toReceive.empty())
+                return;
+            job = _toReceive.front();
+        }
+
+        if(!job->nbParts)
+            readMember(job, scratch);
+        for(unsigned int part=0; part<job->nbParts; part++) {
+            long long int partStart = job->outSize;
+            if(readMember(job, scratch))
+                break;
+            job->partOutSizes[part] = job->outSize - partStart;
+        }
+
+        std::lock_guard<std::mutex> lock(_mtx);
+        job->completeTime = std::chrono::steady_clock::now();
+        _toReceive.pop_front();
+        _completed.push_back(job);
+        metrics_gauge_add(METRIC_QUEUE_DEPTH, -1);
+        _cv.notify_all();
+    }
+}
@@ -0,0 +1,85 @@
+/** QuickPlay
+ *
+ *  gzip_fpga compression session header file
+ *
+ *  A GzipSession opens the file_in/archive_out stream pair once and keeps
+ *  one producer and one consumer thread alive for its whole life. Jobs are
+ *  sent back-to-back, each one as an EOP packet, and each EOP read back on
+ *  archive_out completes the oldest job in flight. A job may also carry
+ *  several packets (one EOP each) sent from a single buffer, in which case
+ *  it completes with its last EOP and its gzip members are stored
+ *  back-to-back in outBuffer.
+ */
+
+#ifndef GZIP_SESSION_H
+#define GZIP_SESSION_H
+
+#include <deque>
+#include <string>
+#include <mutex>
+#include <chrono>
+#include <thread>
+#include <condition_variable>
+#include "QpDevice.h"
+
+typedef struct {
+    char            *inBuffer;      // data to compress
+    long long int   inSize;
+    unsigned int    nbParts;        // 0: one packet, else inBuffer holds nbParts packets back-to-back
+    const long long int *partInSizes;   // size of each packet
+    long long int   *partOutSizes;  // set on completion: size of each gzip member
+    char            *outBuffer;     // receives the gzip member
+    long long int   outCapacity;
+    long long int   outSize;        // set on completion
+    int             err;            // set on completion, 0 on success
+    void            *user;          // free use by the submitter
+    std::chrono::time_point<std::chrono::steady_clock> submitTime;
+    std::chrono::time_point<std::chrono::steady_clock> completeTime;
+} session_job_t;
+
+class GzipSession {
+
+    public:
+    GzipSession( QuickPlayLib::QpDesign & device, unsigned int maxInflight );
+    ~GzipSession();
+
+    // Open the streams and start the workers
+    int open( void );
+
+    // Wait for jobs in flight, stop the workers and close the streams
+    void close( void );
+
+    // Queue a job, blocks while maxInflight jobs are in flight
+    int submit( session_job_t *job );
+
+    // Oldest completed job, NULL if none (wait=false) or nothing in flight.
+    // A job counts as in flight until it has been retrieved here.
+    session_job_t * getCompleted( bool wait );
+
+    unsigned int inflight( void );
+
+    private:
+    GzipSession( const GzipSession & );
+    GzipSession & operator=( const GzipSession & );
+
+    void tProducer( void );
+    void tConsumer( void );
+    int  readMember( session_job_t *job, char *scratch );
+
+    QuickPlayLib::QpDesign      &_dev;
+    QuickPlayLib::QpStream      _streamIn;
+    QuickPlayLib::QpStream      _streamOut;
+    unsigned int                _maxInflight;
+    unsigned int                _inflight;
+    bool                        _opened;
+    bool                        _stop;
+    std::thread                 _producer;
+    std::thread                 _consumer;
+    std::mutex                  _mtx;
+    std::condition_variable     _cv;
+    std::deque<session_job_t *> _toSend;
+    std::deque<session_job_t *> _toReceive;
+    std::deque<session_job_t *> _completed;
+};
+
+#endif
@@ -0,0 +1,126 @@
+/** QuickPlay
+ *
+ *  gzip_fpga round-trip verifier implementation file
+ */
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "SwDeflate.h"
+#include "InflateVerifier.h"
+
+InflateVerifier::InflateVerifier( unsigned int nbThreads ) :
+    _running( 0 ),
+    _stop( false )
+{
+    if(!nbThreads)
+        nbThreads = 1;
+    for(unsigned int i=0; i<nbThreads; i++)
+        _threads.push_back(std::thread(&InflateVerifier::tWorker, this));
+}
+
+InflateVerifier::~InflateVerifier()
+{
+    {
+        std::lock_guard<std::mutex> lock(_mtx);
+        _stop = true;
+    }
+    _cvJobs.notify_all();
+    for(size_t i=0; i<_threads.size(); i++)
+        _threads[i].join();
+}
+
+void InflateVerifier::submit( const std::string & inFile, const std::string & outFile, int *result )
+{
+    verify_job_t job;
+    job.inFile  = inFile;
+    job.outFile = outFile;
+    job.result  = result;
+
+    std::lock_guard<std::mutex> lock(_mtx);
+    _jobs.push_back(job);
+    _cvJobs.notify_one();
+}
+
+void InflateVerifier::drain( void )
+{
+    std::unique_lock<std::mutex> lock(_mtx);
+    _cvDone.wait(lock, [this]{ return _jobs.empty() && !_running; });
+}
+
+/**
+ *  Map a whole file read-only, size 0 files give a NULL mapping
+ */
+static int map_file( const std::string & filename, const char * & data, size_t & size )
+{
+    int fd = open(filename.c_str(), O_RDONLY);
+    if(fd == -1)
+        return -1;
+
+    struct stat st;
+    if(fstat(fd, &st)) {
+        close(fd);
+        return -1;
+    }
+    size = st.st_size;
+    data = NULL;
+    if(size) {
+        void *map = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if(map == MAP_FAILED) {
+            close(fd);
+            return -1;
+        }
+        madvise(map, size, MADV_SEQUENTIAL);
+        data = (const char *)map;
+    }
+    close(fd);
+    return 0;
+}
+
+int InflateVerifier::verifyFiles( const std::string & inFile, const std::string & outFile )
+{
+    const char *inData, *outData;
+    size_t inSize, outSize;
+    if(map_file(inFile, inData, inSize))
+        return INFLATE_VERIFY_IO_ERROR;
+    if(map_file(outFile, outData, outSize)) {
+        if(inData)
+            munmap((void *)inData, inSize);
+        return INFLATE_VERIFY_IO_ERROR;
+    }
+
+    int retCode = gzip_inflate_compare(outData, outSize, inData, inSize);
+
+    if(inData)
+        munmap((void *)inData, inSize);
+    if(outData)
+        munmap((void *)outData, outSize);
+    return retCode;
+}
+
+/**
+ *  Worker thread: run queued tests until the verifier is destroyed
+ */
+void InflateVerifier::tWorker( void )
+{
+    while(true) {
+        verify_job_t job;
+        {
+            std::unique_lock<std::mutex> lock(_mtx);
+            _cvJobs.wait(lock, [this]{ return _stop || !_jobs.empty(); });
+            if(_jobs.empty())
+                return;
+            job = _jobs.front();
+            _jobs.pop_front();
+            _running++;
+        }
+
+        int result = verifyFiles(job.inFile, job.outFile);
+
+        std::lock_guard<std::mutex> lock(_mtx);
+        *job.result = result;
+        _running--;
+        _cvDone.notify_all();
+    }
+}
@@ -0,0 +1,61 @@
+/** QuickPlay
+ *
+ *  gzip_fpga round-trip verifier header file
+ *
+ *  Integrity tests inflate each archive in memory and compare it byte for
+ *  byte with the original file, both mapped read-only. A pool of threads
+ *  takes the tests from a queue, so a file is checked while the next ones
+ *  are being compressed.
+ */
+
+#ifndef INFLATE_VERIFIER_H
+#define INFLATE_VERIFIER_H
+
+#include <deque>
+#include <vector>
+#include <string>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+#define INFLATE_VERIFY_IO_ERROR -5      // input or archive could not be read
+
+class InflateVerifier {
+
+    public:
+    InflateVerifier( unsigned int nbThreads );
+    ~InflateVerifier();
+
+    // Queue the test of archive outFile against inFile. *result gets a
+    // GZIP_CHECK_* code or INFLATE_VERIFY_IO_ERROR, and must stay valid
+    // until drain() returns.
+    void submit( const std::string & inFile, const std::string & outFile, int *result );
+
+    // Wait for every queued test
+    void drain( void );
+
+    // Synchronous test, same result codes
+    static int verifyFiles( const std::string & inFile, const std::string & outFile );
+
+    private:
+    InflateVerifier( const InflateVerifier & );
+    InflateVerifier & operator=( const InflateVerifier & );
+
+    typedef struct {
+        std::string     inFile;
+        std::string     outFile;
+        int             *result;
+    } verify_job_t;
+
+    void tWorker( void );
+
+    std::vector<std::thread>    _threads;
+    std::mutex                  _mtx;
+    std::condition_variable     _cvJobs;
+    std::condition_variable     _cvDone;
+    std::deque<verify_job_t>    _jobs;
+    unsigned int                _running;   // tests being run
+    bool                        _stop;
+};
+
+#endif
@@ -0,0 +1,279 @@
+/** QuickPlay
+ *
+ *  gzip_fpga asynchronous file I/O implementation file
+ *
+ *  liburing is not a dependency: the rings are set up with the raw system
+ *  calls, kernels or headers without io_uring get the synchronous fallback.
+ */
+
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <stdint.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include "IoRing.h"
+
+#if defined(__has_include)
+#if __has_include(<linux/io_uring.h>) && defined(__NR_io_uring_setup)
+#include <linux/io_uring.h>
+#define IO_RING_URING
+#endif
+#endif
+
+#define IO_RING_MAX_XFER        0x40000000      // bytes per submission, longer transfers are split
+
+IoRing::IoRing( unsigned int depth ) :
+    _depth( depth ? (depth < IO_RING_MAX_DEPTH ? depth : IO_RING_MAX_DEPTH) : 1 ),
+    _inflight( 0 ),
+    _fd( -1 ),
+    _regBase( NULL ),
+    _regSize( 0 ),
+    _sqMap( MAP_FAILED ),
+    _sqMapSize( 0 ),
+    _cqMap( MAP_FAILED ),
+    _cqMapSize( 0 ),
+    _sqes( MAP_FAILED ),
+    _sqesSize( 0 )
+{
+    _ops.resize(_depth);
+    for(unsigned int i=0; i<_depth; i++)
+        _freeOps.push_back(_depth-1-i);
+
+#ifdef IO_RING_URING
+    struct io_uring_params p;
+    memset(&p, 0, sizeof(p));
+    int fd = syscall(__NR_io_uring_setup, _depth, &p);
+    if(fd < 0)
+        return;
+
+    _sqMapSize = p.sq_off.array + p.sq_entries*sizeof(unsigned int);
+    _cqMapSize = p.cq_off.cqes + p.cq_entries*sizeof(struct io_uring_cqe);
+    if(p.features & IORING_FEAT_SINGLE_MMAP) {
+        if(_cqMapSize > _sqMapSize)
+            _sqMapSize = _cqMapSize;
+        _cqMapSize = _sqMapSize;
+    }
+    _sqesSize = p.sq_entries*sizeof(struct io_uring_sqe);
+
+    _sqMap = mmap(NULL, _sqMapSize, PROT_READ|PROT_WRITE, MAP_SHARED|MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+    if(_sqMap != MAP_FAILED) {
+        if(p.features & IORING_FEAT_SINGLE_MMAP)
+            _cqMap = _sqMap;
+        else
+            _cqMap = mmap(NULL, _cqMapSize, PROT_READ|PROT_WRITE, MAP_SHARED|MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+    }
+    if(_cqMap != MAP_FAILED)
+        _sqes = mmap(NULL, _sqesSize, PROT_READ|PROT_WRITE, MAP_SHARED|MAP_POPULATE, fd, IORING_OFF_SQES);
+    if(_sqes == MAP_FAILED) {
+        if(_cqMap != MAP_FAILED && _cqMap != _sqMap)
+            munmap(_cqMap, _cqMapSize);
+        if(_sqMap != MAP_FAILED)
+            munmap(_sqMap, _sqMapSize);
+        _sqMap = _cqMap = MAP_FAILED;
+        close(fd);
+        return;
+    }
+
+    char *sq = (char *)_sqMap;
+    char *cq = (char *)_cqMap;
+    _sqHead  = (unsigned int *)(sq + p.sq_off.head);
+    _sqTail  = (unsigned int *)(sq + p.sq_off.tail);
+    _sqMask  = *(unsigned int *)(sq + p.sq_off.ring_mask);
+    _sqArray = (unsigned int *)(sq + p.sq_off.array);
+    _cqHead  = (unsigned int *)(cq + p.cq_off.head);
+    _cqTail  = (unsigned int *)(cq + p.cq_off.tail);
+    _cqMask  = *(unsigned int *)(cq + p.cq_off.ring_mask);
+    _cqes    = cq + p.cq_off.cqes;
+    _fd = fd;
+#endif
+}
+
+IoRing::~IoRing()
+{
+    // The kernel may still be filling the caller buffers
+    void *user;
+    long long int res;
+    while(_inflight && !wait(user, res))
+        ;
+
+    if(_fd < 0)
+        return;
+    munmap(_sqes, _sqesSize);
+    if(_cqMap != _sqMap)
+        munmap(_cqMap, _cqMapSize);
+    munmap(_sqMap, _sqMapSize);
+    close(_fd);
+}
+
+int IoRing::registerBuffer( void *base, size_t size )
+{
+#ifdef IO_RING_URING
+    if(_fd < 0 || _regBase || !size)
+        return -1;
+    struct iovec iov;
+    iov.iov_base = base;
+    iov.iov_len  = size;
+    if(syscall(__NR_io_uring_register, _fd, IORING_REGISTER_BUFFERS, &iov, 1) < 0)
+        return -1;
+    _regBase = (char *)base;
+    _regSize = size;
+    return 0;
+#else
+    return -1;
+#endif
+}
+
+int IoRing::submitRead( int fd, void *buffer, size_t size, long long int offset, void *user )
+{
+    return submit(false, fd, (char *)buffer, size, offset, user);
+}
+
+int IoRing::submitWrite( int fd, const void *buffer, size_t size, long long int offset, void *user )
+{
+    return submit(true, fd, (char *)buffer, size, offset, user);
+}
+
+int IoRing::submit( bool write, int fd, char *buffer, size_t size, long long int offset, void *user )
+{
+    if(_freeOps.empty())
+        return -1;
+    unsigned int op = _freeOps.back();
+    _freeOps.pop_back();
+
+    io_op_t & o = _ops[op];
+    o.write  = write;
+    o.fd     = fd;
+    o.buffer = buffer;
+    o.size   = size;
+    o.offset = offset;
+    o.done   = 0;
+    o.user   = user;
+    _inflight++;
+
+    if(_fd < 0) {
+        _syncOps.push_back(op);
+        return 0;
+    }
+    if(push(op)) {
+        _inflight--;
+        _freeOps.push_back(op);
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ *  Hand the remaining part of a transfer to the kernel
+ */
+int IoRing::push( unsigned int op )
+{
+#ifdef IO_RING_URING
+    io_op_t & o = _ops[op];
+    char *buffer = o.buffer + o.done;
+    size_t size = o.size - o.done;
+    if(size > IO_RING_MAX_XFER)
+        size = IO_RING_MAX_XFER;
+
+    unsigned int tail = *_sqTail;
+    unsigned int idx = tail & _sqMask;
+    struct io_uring_sqe *sqe = &((struct io_uring_sqe *)_sqes)[idx];
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->fd  = o.fd;
+    sqe->off = o.offset + o.done;
+    sqe->user_data = op;
+    if(_regBase && buffer >= _regBase && buffer+size <= _regBase+_regSize) {
+        sqe->opcode    = o.write ? IORING_OP_WRITE_FIXED : IORING_OP_READ_FIXED;
+        sqe->addr      = (uint64_t)(uintptr_t)buffer;
+        sqe->len       = size;
+        sqe->buf_index = 0;
+    }
+    else {
+        o.iov.iov_base = buffer;
+        o.iov.iov_len  = size;
+        sqe->opcode    = o.write ? IORING_OP_WRITEV : IORING_OP_READV;
+        sqe->addr      = (uint64_t)(uintptr_t)&o.iov;
+        sqe->len       = 1;
+    }
+    _sqArray[idx] = idx;
+    __atomic_store_n(_sqTail, tail+1, __ATOMIC_RELEASE);
+
+    while(syscall(__NR_io_uring_enter, _fd, 1, 0, 0, NULL, 0) < 0) {
+        if(errno != EINTR && errno != EAGAIN)
+            return -1;
+    }
+    return 0;
+#else
+    return -1;
+#endif
+}
+
+/**
+ *  A part of a transfer is done: resubmit the rest (returns 1) or report it
+ */
+int IoRing::complete( unsigned int op, int res, void * & user, long long int & total )
+{
+    io_op_t & o = _ops[op];
+    if(res > 0) {
+        o.done += res;
+        if(o.done < o.size) {
+            if(!push(op))
+                return 1;
+            res = -EIO;
+        }
+    }
+
+    user  = o.user;
+    total = (res < 0) ? res : (long long int)o.done;
+    _freeOps.push_back(op);
+    _inflight--;
+    return 0;
+}
+
+int IoRing::wait( void * & user, long long int & res )
+{
+    if(!_inflight)
+        return -1;
+
+    // Synchronous fallback: run the oldest transfer now
+    if(_fd < 0) {
+        unsigned int op = _syncOps.front();
+        _syncOps.pop_front();
+        io_op_t & o = _ops[op];
+        int ret = 0;
+        while(o.done < o.size) {
+            ssize_t n = o.write ? pwrite(o.fd, o.buffer+o.done, o.size-o.done, o.offset+o.done)
+                                : pread(o.fd, o.buffer+o.done, o.size-o.done, o.offset+o.done);
+            if(n < 0 && errno == EINTR)
+                continue;
+            if(n < 0) {
+                ret = -errno;
+                break;
+            }
+            if(n == 0)
+                break;
+            o.done += n;
+        }
+        complete(op, ret, user, res);
+        return 0;
+    }
+
+#ifdef IO_RING_URING
+    struct io_uring_cqe *cqes = (struct io_uring_cqe *)_cqes;
+    while(true) {
+        unsigned int head = *_cqHead;
+        if(head != __atomic_load_n(_cqTail, __ATOMIC_ACQUIRE)) {
+            struct io_uring_cqe *cqe = &cqes[head & _cqMask];
+            unsigned int op = (unsigned int)cqe->user_data;
+            int ret = cqe->res;
+            __atomic_store_n(_cqHead, head+1, __ATOMIC_RELEASE);
+            if(!complete(op, ret, user, res))
+                return 0;
+            continue;
+        }
+        if(syscall(__NR_io_uring_enter, _fd, 0, 1, IORING_ENTER_GETEVENTS, NULL, 0) < 0 && errno != EINTR)
+            return -1;
+    }
+#endif
+    return -1;
+}
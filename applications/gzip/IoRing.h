@@ -0,0 +1,101 @@
+/** QuickPlay
+ *
+ *  gzip_fpga asynchronous file I/O header file
+ *
+ *  An IoRing queues positioned reads and writes to the kernel through
+ *  io_uring and hands them back as they complete, so a thread can keep
+ *  several transfers in flight while the device works on earlier data.
+ *  Short transfers are resubmitted internally: a completion always covers
+ *  the whole request, up to the end of file for reads. The memory given to
+ *  registerBuffer() is pinned once and used with the fixed buffer opcodes.
+ *
+ *  An IoRing is driven by a single thread. When io_uring is not available
+ *  (old kernel, seccomp, io_uring_disabled) the same calls fall back to
+ *  pread()/pwrite() run at wait() time, so callers have a single path.
+ */
+
+#ifndef IO_RING_H
+#define IO_RING_H
+
+#include <stddef.h>
+#include <sys/uio.h>
+#include <deque>
+#include <vector>
+
+#define IO_RING_DEPTH           8       // default transfers in flight
+#define IO_RING_MAX_DEPTH       256
+
+class IoRing {
+
+    public:
+    IoRing( unsigned int depth );
+    ~IoRing();
+
+    // true when transfers really run asynchronously
+    bool async() const
+    { return _fd >= 0; }
+
+    // Pin [base, base+size) for the fixed buffer opcodes, 0 on success.
+    // Transfers outside of it still work, unregistered.
+    int registerBuffer( void *base, size_t size );
+
+    // Queue a transfer, 0 on success, -1 when depth transfers are in flight
+    int submitRead( int fd, void *buffer, size_t size, long long int offset, void *user );
+    int submitWrite( int fd, const void *buffer, size_t size, long long int offset, void *user );
+
+    // Wait for one transfer. res gets the bytes transferred (short only at
+    // end of file) or -errno. Returns -1 if nothing is in flight.
+    int wait( void * & user, long long int & res );
+
+    unsigned int inflight() const
+    { return _inflight; }
+
+    unsigned int depth() const
+    { return _depth; }
+
+    private:
+    IoRing( const IoRing & );
+    IoRing & operator=( const IoRing & );
+
+    typedef struct {
+        bool            write;
+        int             fd;
+        char            *buffer;
+        size_t          size;
+        long long int   offset;
+        size_t          done;
+        void            *user;
+        struct iovec    iov;
+    } io_op_t;
+
+    int submit( bool write, int fd, char *buffer, size_t size, long long int offset, void *user );
+    int push( unsigned int op );
+    int complete( unsigned int op, int res, void * & user, long long int & total );
+
+    unsigned int            _depth;
+    unsigned int            _inflight;
+    int                     _fd;            // io_uring instance, -1: synchronous fallback
+    std::vector<io_op_t>    _ops;
+    std::vector<unsigned int> _freeOps;
+    std::deque<unsigned int>  _syncOps;     // fallback: transfers run by wait()
+    char                    *_regBase;
+    size_t                  _regSize;
+
+    // Shared rings
+    void                    *_sqMap;
+    size_t                  _sqMapSize;
+    void                    *_cqMap;
+    size_t                  _cqMapSize;
+    void                    *_sqes;
+    size_t                  _sqesSize;
+    unsigned int            *_sqHead;
+    unsigned int            *_sqTail;
+    unsigned int            _sqMask;
+    unsigned int            *_sqArray;
+    unsigned int            *_cqHead;
+    unsigned int            *_cqTail;
+    unsigned int            _cqMask;
+    void                    *_cqes;
+};
+
+#endif
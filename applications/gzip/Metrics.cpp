@@ -0,0 +1,362 @@
+/** QuickPlay
+ *
+ *  gzip_fpga metrics implementation file
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <set>
+#include <sstream>
+#include <iostream>
+#include "Metrics.h"
+#include "DmaStats.h"
+
+#define METRICS_REQUEST_MAX     4096    // bytes of request read before answering
+#define METRICS_RECV_TIMEOUT_S  1       // a client that sends nothing is dropped
+
+/**
+ *  Per-thread counter shards
+ */
+typedef struct metrics_shard {
+    std::atomic<unsigned long long int> counters[METRIC_NB_COUNTERS];
+    metrics_shard();
+    ~metrics_shard();
+} metrics_shard_t;
+
+static std::mutex shardsMtx;                            // registration, exit and readers
+static std::set<metrics_shard_t *> shards;
+static unsigned long long int retired[METRIC_NB_COUNTERS];
+static std::atomic<long long int> gauges[METRIC_NB_GAUGES];
+
+metrics_shard::metrics_shard()
+{
+    for(int i=0; i<METRIC_NB_COUNTERS; i++)
+        counters[i] = 0;
+    std::lock_guard<std::mutex> lock(shardsMtx);
+    shards.insert(this);
+}
+
+metrics_shard::~metrics_shard()
+{
+    std::lock_guard<std::mutex> lock(shardsMtx);
+    for(int i=0; i<METRIC_NB_COUNTERS; i++)
+        retired[i] += counters[i].load(std::memory_order_relaxed);
+    shards.erase(this);
+}
+
+void metrics_add( int counter, unsigned long long int value )
+{
+    // Only the owner thread writes its shard: a relaxed load/store pair is
+    // enough and keeps the locked instruction out of the hot path
+    static thread_local metrics_shard_t shard;
+    std::atomic<unsigned long long int> & c = shard.counters[counter];
+    c.store(c.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+}
+
+unsigned long long int metrics_counter( int counter )
+{
+    std::lock_guard<std::mutex> lock(shardsMtx);
+    unsigned long long int total = retired[counter];
+    for(std::set<metrics_shard_t *>::iterator it=shards.begin(); it!=shards.end(); ++it)
+        total += (*it)->counters[counter].load(std::memory_order_relaxed);
+    return total;
+}
+
+void metrics_gauge_add( int gauge, long long int value )
+{
+    gauges[gauge].fetch_add(value, std::memory_order_relaxed);
+}
+
+long long int metrics_gauge( int gauge )
+{
+    return gauges[gauge].load(std::memory_order_relaxed);
+}
+
+MetricsServer::MetricsServer( const std::string & endpoint, unsigned int intervalMs ) :
+    _endpoint( endpoint ),
+    _intervalMs( intervalMs ? intervalMs : METRICS_INTERVAL_MS ),
+    _listenFd( -1 )
+{
+    _wakeFds[0] = _wakeFds[1] = -1;
+    for(int i=0; i<METRIC_NB_COUNTERS; i++)
+        _lastCounters[i] = 0;
+}
+
+MetricsServer::~MetricsServer()
+{
+    stop();
+}
+
+int MetricsServer::start( void )
+{
+    if(!_endpoint.compare(0, 5, "unix:")) {
+        _unixPath = _endpoint.substr(5);
+        struct sockaddr_un addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sun_family = AF_UNIX;
+        if(_unixPath.empty() || _unixPath.size() >= sizeof(addr.sun_path)) {
+            std::cerr << KRED << "Error: invalid metrics socket path [" << _unixPath << "]" << KNRM << std::endl;
+            return -1;
+        }
+        strcpy(addr.sun_path, _unixPath.c_str());
+        if((_listenFd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0)) < 0)
+            return -1;
+        // A stale socket left by a previous run would make bind fail
+        unlink(_unixPath.c_str());
+        if(bind(_listenFd, (struct sockaddr *)&addr, sizeof(addr))) {
+            std::cerr << KRED << "Error: unable to bind metrics socket [" << _unixPath << "]: " << strerror(errno) << KNRM << std::endl;
+            close(_listenFd);
+            _listenFd = -1;
+            _unixPath.clear();
+            return -1;
+        }
+    }
+    else {
+        char *end;
+        long port = strtol(_endpoint.c_str(), &end, 10);
+        if(_endpoint.empty() || *end || port <= 0 || port > 65535) {
+            std::cerr << KRED << "Error: invalid metrics endpoint [" << _endpoint << "], expected PORT or unix:PATH" << KNRM << std::endl;
+            return -1;
+        }
+        struct sockaddr_in addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons((unsigned short)port);
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        if((_listenFd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0)) < 0)
+            return -1;
+        int one = 1;
+        setsockopt(_listenFd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+        if(bind(_listenFd, (struct sockaddr *)&addr, sizeof(addr))) {
+            std::cerr << KRED << "Error: unable to bind metrics port " << port << ": " << strerror(errno) << KNRM << std::endl;
+            close(_listenFd);
+            _listenFd = -1;
+            return -1;
+        }
+    }
+
+    if(listen(_listenFd, 16) || pipe2(_wakeFds, O_CLOEXEC)) {
+        std::cerr << KRED << "Error: unable to serve metrics on [" << _endpoint << "]: " << strerror(errno) << KNRM << std::endl;
+        stop();
+        return -1;
+    }
+    _lastSnapshot = std::chrono::steady_clock::now();
+    snapshot();
+    _thread = std::thread(&MetricsServer::tServer, this);
+    return 0;
+}
+
+void MetricsServer::stop( void )
+{
+    if(_thread.joinable()) {
+        char c = 0;
+        while(write(_wakeFds[1], &c, 1) < 0 && errno == EINTR)
+            ;
+        _thread.join();
+    }
+    if(_listenFd >= 0) {
+        close(_listenFd);
+        _listenFd = -1;
+    }
+    for(int i=0; i<2; i++) {
+        if(_wakeFds[i] >= 0)
+            close(_wakeFds[i]);
+        _wakeFds[i] = -1;
+    }
+    if(!_unixPath.empty()) {
+        unlink(_unixPath.c_str());
+        _unixPath.clear();
+    }
+}
+
+/**
+ *  Accept scrapes, refresh the snapshot every interval, until stop()
+ */
+void MetricsServer::tServer( void )
+{
+    struct pollfd fds[2];
+    fds[0].fd = _listenFd;
+    fds[0].events = POLLIN;
+    fds[1].fd = _wakeFds[0];
+    fds[1].events = POLLIN;
+
+    while(true) {
+        long long int elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::steady_clock::now() - _lastSnapshot).count();
+        int timeout = elapsed >= (long long int)_intervalMs ? 0 : (int)(_intervalMs - elapsed);
+        int ret = poll(fds, 2, timeout);
+        if(ret < 0 && errno != EINTR)
+            break;
+        if(ret > 0 && fds[1].revents)
+            break;
+
+        elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::steady_clock::now() - _lastSnapshot).count();
+        if(elapsed >= (long long int)_intervalMs)
+            snapshot();
+
+        if(ret > 0 && (fds[0].revents & POLLIN)) {
+            int fd = accept4(_listenFd, NULL, NULL, SOCK_CLOEXEC);
+            if(fd >= 0) {
+                serve(fd);
+                close(fd);
+            }
+        }
+    }
+}
+
+/**
+ *  Prometheus summary of a DMA time histogram, in seconds
+ */
+static void summary( std::ostringstream & prom, std::ostringstream & json, const char *name, const char *help, int hist )
+{
+    const DmaHistogram & h = dma_histogram(hist);
+    const double quantiles[] = { 0.5, 0.9, 0.99 };
+
+    prom << "# HELP gzip_fpga_" << name << "_seconds " << help << "\n";
+    prom << "# TYPE gzip_fpga_" << name << "_seconds summary\n";
+    json << "\"" << name << "\":{";
+    for(unsigned int i=0; i<sizeof(quantiles)/sizeof(quantiles[0]); i++) {
+        double value = h.percentile(quantiles[i]*100.0) / 1e9;
+        prom << "gzip_fpga_" << name << "_seconds{quantile=\"" << quantiles[i] << "\"} " << value << "\n";
+        json << "\"p" << (int)(quantiles[i]*100.0) << "_seconds\":" << value << ",";
+    }
+    prom << "gzip_fpga_" << name << "_seconds_sum " << h.sum() / 1e9 << "\n";
+    prom << "gzip_fpga_" << name << "_seconds_count " << h.count() << "\n";
+    json << "\"count\":" << h.count() << ",\"sum_seconds\":" << h.sum() / 1e9 << "}";
+}
+
+void MetricsServer::snapshot( void )
+{
+    const char *names[METRIC_NB_COUNTERS] = { "bytes_in", "bytes_out", "files", "errors", "bytes_stored" };
+    const char *helps[METRIC_NB_COUNTERS] = { "Input bytes compressed", "Archive bytes produced",
+                                              "Files compressed", "Files that failed",
+                                              "Input bytes stored on the host" };
+
+    std::chrono::time_point<std::chrono::steady_clock> now = std::chrono::steady_clock::now();
+    double secs = std::chrono::duration_cast<std::chrono::duration<double> >(now - _lastSnapshot).count();
+    _lastSnapshot = now;
+
+    std::ostringstream prom, json;
+    json << "{\"counters\":{";
+    for(int i=0; i<METRIC_NB_COUNTERS; i++) {
+        unsigned long long int value = metrics_counter(i);
+        double rate = secs > 0.0 ? (value - _lastCounters[i]) / secs : 0.0;
+        _lastCounters[i] = value;
+        prom << "# HELP gzip_fpga_" << names[i] << "_total " << helps[i] << "\n";
+        prom << "# TYPE gzip_fpga_" << names[i] << "_total counter\n";
+        prom << "gzip_fpga_" << names[i] << "_total " << value << "\n";
+        prom << "# HELP gzip_fpga_" << names[i] << "_per_second " << helps[i] << " per second, last interval\n";
+        prom << "# TYPE gzip_fpga_" << names[i] << "_per_second gauge\n";
+        prom << "gzip_fpga_" << names[i] << "_per_second " << rate << "\n";
+        json << (i ? "," : "") << "\"" << names[i] << "\":" << value << ",\"" << names[i] << "_per_second\":" << rate;
+    }
+    prom << "# HELP gzip_fpga_queue_depth Jobs handed to the device and not completed yet\n";
+    prom << "# TYPE gzip_fpga_queue_depth gauge\n";
+    prom << "gzip_fpga_queue_depth " << metrics_gauge(METRIC_QUEUE_DEPTH) << "\n";
+    json << "},\"queue_depth\":" << metrics_gauge(METRIC_QUEUE_DEPTH) << ",\"dma\":{";
+
+    // Device stream stats, from the DMA transfer histograms
+    const char *dirs[2] = { "write", "read" };
+    const int bytesHist[2] = { DMA_WRITE_BYTES, DMA_READ_BYTES };
+    const int nsHist[2] = { DMA_WRITE_NS, DMA_READ_NS };
+    prom << "# HELP gzip_fpga_dma_transfers_total Stream transfer calls\n";
+    prom << "# TYPE gzip_fpga_dma_transfers_total counter\n";
+    for(int d=0; d<2; d++)
+        prom << "gzip_fpga_dma_transfers_total{direction=\"" << dirs[d] << "\"} " << dma_histogram(nsHist[d]).count() << "\n";
+    prom << "# HELP gzip_fpga_dma_bytes_total Bytes moved by stream transfers\n";
+    prom << "# TYPE gzip_fpga_dma_bytes_total counter\n";
+    for(int d=0; d<2; d++)
+        prom << "gzip_fpga_dma_bytes_total{direction=\"" << dirs[d] << "\"} " << dma_histogram(bytesHist[d]).sum() << "\n";
+    prom << "# HELP gzip_fpga_dma_seconds_total Time spent in stream transfer calls\n";
+    prom << "# TYPE gzip_fpga_dma_seconds_total counter\n";
+    for(int d=0; d<2; d++)
+        prom << "gzip_fpga_dma_seconds_total{direction=\"" << dirs[d] << "\"} " << dma_histogram(nsHist[d]).sum() / 1e9 << "\n";
+    for(int d=0; d<2; d++)
+        json << "\"" << dirs[d] << "\":{\"transfers\":" << dma_histogram(nsHist[d]).count()
+             << ",\"bytes\":" << dma_histogram(bytesHist[d]).sum()
+             << ",\"seconds\":" << dma_histogram(nsHist[d]).sum() / 1e9 << "},";
+    summary(prom, json, "dma_first_byte", "Wait for the first bytes of each compressed member", DMA_FIRST_BYTE_NS);
+    json << ",";
+    summary(prom, json, "dma_eop_gap", "Producer EOP to the matching consumer EOP", DMA_EOP_GAP_NS);
+    json << "}}\n";
+
+    std::lock_guard<std::mutex> lock(_mtx);
+    _prometheus = prom.str();
+    _json = json.str();
+}
+
+/**
+ *  Answer one HTTP request, the connection is closed afterwards
+ */
+void MetricsServer::serve( int fd )
+{
+    struct timeval tv = { METRICS_RECV_TIMEOUT_S, 0 };
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+
+    std::string request;
+    char buffer[512];
+    while(request.find("\r\n\r\n") == std::string::npos && request.find("\n\n") == std::string::npos
+          && request.size() < METRICS_REQUEST_MAX) {
+        ssize_t ret = recv(fd, buffer, sizeof(buffer), 0);
+        if(ret < 0 && errno == EINTR)
+            continue;
+        if(ret <= 0)
+            break;
+        request.append(buffer, ret);
+    }
+
+    std::string status, type, body;
+    std::string path;
+    size_t sp1 = request.find(' ');
+    size_t sp2 = sp1 == std::string::npos ? std::string::npos : request.find_first_of(" \r\n", sp1+1);
+    if(sp2 != std::string::npos)
+        path = request.substr(sp1+1, sp2-sp1-1);
+    path = path.substr(0, path.find('?'));
+
+    if(request.compare(0, 4, "GET ")) {
+        status = "405 Method Not Allowed";
+        type = "text/plain";
+        body = "GET only\n";
+    }
+    else if(path == "/" || path == "/metrics") {
+        std::lock_guard<std::mutex> lock(_mtx);
+        status = "200 OK";
+        type = "text/plain; version=0.0.4";
+        body = _prometheus;
+    }
+    else if(path == "/metrics.json") {
+        std::lock_guard<std::mutex> lock(_mtx);
+        status = "200 OK";
+        type = "application/json";
+        body = _json;
+    }
+    else {
+        status = "404 Not Found";
+        type = "text/plain";
+        body = "/metrics or /metrics.json\n";
+    }
+
+    std::ostringstream response;
+    response << "HTTP/1.0 " << status << "\r\nContent-Type: " << type << "\r\nContent-Length: " << body.size()
+             << "\r\nConnection: close\r\n\r\n" << body;
+    std::string out = response.str();
+    size_t sent = 0;
+    while(sent < out.size()) {
+        ssize_t ret = send(fd, out.data()+sent, out.size()-sent, MSG_NOSIGNAL);
+        if(ret < 0 && errno == EINTR)
+            continue;
+        if(ret <= 0)
+            break;
+        sent += ret;
+    }
+}
@@ -0,0 +1,76 @@
+/** QuickPlay
+ *
+ *  gzip_fpga metrics header file
+ *
+ *  Counters are sharded per thread: each thread adds to its own atomics,
+ *  without any lock or shared cache line, and a reader sums the shards.
+ *  The shard of a thread that exits is folded into a retired total.
+ *  Gauges are plain shared atomics moved up and down by their owners.
+ *
+ *  A MetricsServer takes a snapshot of the counters, the gauges and the
+ *  DMA transfer histograms every scrape interval and serves the last one
+ *  over HTTP, on a local TCP port or a Unix socket:
+ *      /metrics        Prometheus text format
+ *      /metrics.json   JSON
+ */
+
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <string>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+
+#define METRIC_BYTES_IN         0       // input bytes compressed
+#define METRIC_BYTES_OUT        1       // archive bytes produced
+#define METRIC_FILES            2       // files compressed
+#define METRIC_ERRORS           3       // files failed
+#define METRIC_BYTES_STORED     4       // input bytes stored on the host, kept off the device
+#define METRIC_NB_COUNTERS      5
+
+#define METRIC_QUEUE_DEPTH      0       // jobs handed to the device, not completed yet
+#define METRIC_NB_GAUGES        1
+
+#define METRICS_INTERVAL_MS     1000    // default scrape interval
+
+void metrics_add( int counter, unsigned long long int value );
+unsigned long long int metrics_counter( int counter );
+
+void metrics_gauge_add( int gauge, long long int value );
+long long int metrics_gauge( int gauge );
+
+class MetricsServer {
+
+    public:
+    // endpoint: "PORT" (HTTP on 127.0.0.1) or "unix:PATH"
+    MetricsServer( const std::string & endpoint, unsigned int intervalMs );
+    ~MetricsServer();
+
+    // Bind and start serving, 0 on success
+    int start( void );
+    void stop( void );
+
+    private:
+    MetricsServer( const MetricsServer & );
+    MetricsServer & operator=( const MetricsServer & );
+
+    void tServer( void );
+    void snapshot( void );
+    void serve( int fd );
+
+    std::string         _endpoint;
+    std::string         _unixPath;
+    unsigned int        _intervalMs;
+    int                 _listenFd;
+    int                 _wakeFds[2];        // stop() wakes the server thread up
+    std::thread         _thread;
+    std::mutex          _mtx;               // snapshots
+    std::string         _prometheus;
+    std::string         _json;
+    unsigned long long int _lastCounters[METRIC_NB_COUNTERS];
+    std::chrono::time_point<std::chrono::steady_clock> _lastSnapshot;
+};
+
+#endif
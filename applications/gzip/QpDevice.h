@@ -0,0 +1,34 @@
+/** QuickPlay
+ *
+ *  gzip_fpga QuickPlay API selection header file
+ */
+
+#ifndef QP_DEVICE_H
+#define QP_DEVICE_H
+
+#define QP_MAX_BOARDS           16
+
+/* QuickPlay API library include */
+#ifdef QP_EMULATION
+#include "QpEmulator.h"     // software model of the GzipHC design
+#else
+#include <QpDesign.h>
+#endif
+
+/**
+ *  Open the design loaded in board boardIndex
+ */
+inline int qpOpenBoardDesign(QuickPlayLib::QpDesign & dev, unsigned int boardIndex,
+                             const char *designName, const char *licSearchPath, const char *jsonPath)
+{
+#ifdef QP_EMULATION
+    return dev.qpOpenDesign(designName, licSearchPath, jsonPath, boardIndex);
+#else
+    // The SDK binds a QpDesign to the first board only
+    if(boardIndex)
+        return -1;
+    return dev.qpOpenDesign(designName, licSearchPath, jsonPath);
+#endif
+}
+
+#endif
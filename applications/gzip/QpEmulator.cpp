@@ -0,0 +1,754 @@
+/** QuickPlay
+ *
+ *  Software emulation of the QuickPlay API subset used by gzip_fpga
+ *  implementation file
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <iostream>
+#include <iomanip>
+#include <deque>
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <chrono>
+#include "QpEmulator.h"
+#include "SwDeflate.h"
+
+#define EMU_DEFAULT_UDID        "989e259a-ff16-42b8-bbf7-0ceb0c6ade8a"
+#define EMU_DEFAULT_LEVEL       9
+#define EMU_DEFAULT_BLOCK_SIZE  0x20000
+#define EMU_DEFAULT_FIFO_SIZE   0x2000000
+#define EMU_MAX_BOARDS          16
+
+namespace QuickPlayLib {
+
+/**
+ *  Emulated board configuration
+ */
+typedef struct {
+    std::string  udid;
+    unsigned int engines;
+    int          level;
+    size_t       blockSize;
+    size_t       fifoSize;
+    double       writeMBps;
+    double       readMBps;
+    double       latencyUs;
+    double       coreMBps;
+} emu_config_t;
+
+/**
+ *  emu_env_double: value of board in a comma separated list
+ */
+static double emu_env_double(const char *name, double defValue, unsigned int board = 0)
+{
+    const char *value = getenv(name);
+    if(!value || !*value)
+        return defValue;
+
+    // The last value of the list applies to the remaining boards
+    for(unsigned int i=0; i<board; i++) {
+        const char *next = strchr(value, ',');
+        if(!next)
+            break;
+        value = next+1;
+    }
+    return atof(value);
+}
+
+/**
+ *  emu_board_count
+ */
+static unsigned int emu_board_count(void)
+{
+    unsigned int boards = (unsigned int)emu_env_double("QP_EMU_BOARDS", 1);
+    if(boards < 1)
+        boards = 1;
+    return boards < EMU_MAX_BOARDS ? boards : EMU_MAX_BOARDS;
+}
+
+/**
+ *  emu_load_config
+ */
+static emu_config_t emu_load_config(unsigned int board = 0)
+{
+    emu_config_t cfg;
+    const char *udid = getenv("QP_EMU_UDID");
+    unsigned int cores = std::thread::hardware_concurrency();
+
+    cfg.udid      = (udid && *udid) ? std::string(udid) : std::string(EMU_DEFAULT_UDID);
+    cfg.engines   = (unsigned int)emu_env_double("QP_EMU_ENGINES", cores ? cores : 1, board);
+    cfg.level     = (int)emu_env_double("QP_EMU_LEVEL", EMU_DEFAULT_LEVEL, board);
+    cfg.blockSize = (size_t)emu_env_double("QP_EMU_BLOCK_SIZE", EMU_DEFAULT_BLOCK_SIZE, board);
+    cfg.fifoSize  = (size_t)emu_env_double("QP_EMU_FIFO_SIZE", EMU_DEFAULT_FIFO_SIZE, board);
+    cfg.writeMBps = emu_env_double("QP_EMU_WRITE_MBPS", 0.0, board);
+    cfg.readMBps  = emu_env_double("QP_EMU_READ_MBPS", 0.0, board);
+    cfg.latencyUs = emu_env_double("QP_EMU_LATENCY_US", 0.0, board);
+    cfg.coreMBps  = emu_env_double("QP_EMU_CORE_MBPS", 0.0, board);
+
+    if(cfg.engines == 0)
+        cfg.engines = 1;
+    if(cfg.level < 1 || cfg.level > 9)
+        cfg.level = EMU_DEFAULT_LEVEL;
+    if(cfg.blockSize < GZIP_WINDOW_SIZE)
+        cfg.blockSize = GZIP_WINDOW_SIZE;
+    if(cfg.fifoSize < cfg.blockSize)
+        cfg.fifoSize = cfg.blockSize;
+    return cfg;
+}
+
+/**
+ *  Split an UDID string into the four design registers (see getDesignUDID)
+ */
+static void emu_udid_to_registers(std::string udid, UINT32 *regValue)
+{
+    std::string hex;
+    for(size_t i=0; i<udid.size(); i++)
+        if(udid[i] != '-')
+            hex += udid[i];
+    hex.resize(32, '0');
+
+    regValue[3] = (UINT32)strtoul(hex.substr(0, 8).c_str(), NULL, 16);
+    regValue[2] = (UINT32)strtoul(hex.substr(8, 8).c_str(), NULL, 16);
+    regValue[1] = (UINT32)strtoul(hex.substr(16, 8).c_str(), NULL, 16);
+    regValue[0] = (UINT32)strtoul(hex.substr(24, 8).c_str(), NULL, 16);
+}
+
+/**
+ *  Serialising channel model: each transfer occupies the channel for
+ *  latency + size/bandwidth, transfers queue behind each other.
+ */
+class EmuChannelModel {
+
+    public:
+    EmuChannelModel() :
+        _mbps( 0.0 ),
+        _latencyUs( 0.0 ),
+        _busyUntil( std::chrono::steady_clock::now() )
+    {}
+
+    void configure( double mbps, double latencyUs )
+    {
+        _mbps = mbps;
+        _latencyUs = latencyUs;
+    }
+
+    void transfer( size_t bytes )
+    {
+        if(_mbps <= 0.0 && _latencyUs <= 0.0)
+            return;
+
+        double usecs = _latencyUs;
+        if(_mbps > 0.0)
+            usecs += (double)bytes / _mbps;     // 1 MB/s == 1 byte/us
+
+        std::chrono::steady_clock::time_point done;
+        {
+            std::lock_guard<std::mutex> lock(_mtx);
+            std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+            if(_busyUntil < now)
+                _busyUntil = now;
+            _busyUntil += std::chrono::microseconds((long long)usecs);
+            done = _busyUntil;
+        }
+        std::this_thread::sleep_until(done);
+    }
+
+    private:
+    double      _mbps;
+    double      _latencyUs;
+    std::mutex  _mtx;
+    std::chrono::steady_clock::time_point _busyUntil;
+};
+
+/**
+ *  One side of the core (file_in or archive_out) and its statistics
+ */
+class EmuStreamPort {
+
+    public:
+    EmuStreamPort( std::string name, bool toDevice ) :
+        name( name ),
+        toDevice( toDevice ),
+        opened( false ),
+        calls( 0 ),
+        bytes( 0 ),
+        packets( 0 ),
+        busyUsecs( 0 )
+    {}
+
+    void clearStats( void )
+    {
+        calls = 0;
+        bytes = 0;
+        packets = 0;
+        busyUsecs = 0;
+    }
+
+    std::string     name;
+    bool            toDevice;
+    std::atomic<bool> opened;       // cleared by qpCloseStream, fails the transfers
+    EmuChannelModel link;
+    std::atomic<unsigned long long> calls;
+    std::atomic<unsigned long long> bytes;
+    std::atomic<unsigned long long> packets;
+    std::atomic<unsigned long long> busyUsecs;
+};
+
+/**
+ *  Engine job: one block of a packet
+ */
+typedef struct {
+    std::string in;
+    std::string dict;
+    std::string out;
+    uint32_t    crc;
+    bool        first;
+    bool        last;
+    bool        done;
+    int         err;
+} emu_block_t;
+
+/**
+ *  Compressed bytes waiting in the archive_out FIFO
+ */
+typedef struct {
+    std::string data;
+    size_t      offset;
+    bool        eop;
+} emu_chunk_t;
+
+/**
+ *  Emulated GzipHC core: blocks of each file_in packet are deflated in
+ *  parallel by the engines, then serialised in order as one gzip member
+ *  on archive_out.
+ */
+class EmuGzipCore {
+
+    public:
+    EmuGzipCore( const emu_config_t & cfg ) :
+        in( "file_in", true ),
+        out( "archive_out", false ),
+        _cfg( cfg ),
+        _stop( false ),
+        _inPacket( false ),
+        _outBytes( 0 ),
+        _packetCrc( 0 ),
+        _packetSize( 0 )
+    {
+        in.link.configure(cfg.writeMBps, cfg.latencyUs);
+        out.link.configure(cfg.readMBps, cfg.latencyUs);
+        _coreModel.configure(cfg.coreMBps, 0.0);
+        _maxInflight = cfg.fifoSize / cfg.blockSize;
+        if(_maxInflight < 2*cfg.engines)
+            _maxInflight = 2*cfg.engines;
+        start();
+    }
+
+    ~EmuGzipCore()
+    {
+        stop();
+    }
+
+    const emu_config_t & config( void ) const
+    { return _cfg; }
+
+    int write( const char *buffer, size_t size, bool eop );
+    int read( char *buffer, size_t size, bool & eop, unsigned int & readBytes );
+    void closePort( EmuStreamPort & port );
+    void reset( void );
+
+    EmuStreamPort in;
+    EmuStreamPort out;
+
+    private:
+    void start( void );
+    void stop( void );
+    int  submit( bool last );
+    void tEngine( void );
+    void tCollector( void );
+
+    emu_config_t            _cfg;
+    size_t                  _maxInflight;
+    EmuChannelModel         _coreModel;
+    bool                    _stop;
+    std::vector<std::thread> _threads;
+
+    std::mutex              _mtx;
+    std::condition_variable _cvWork;
+    std::condition_variable _cvDone;
+    std::condition_variable _cvSpace;
+    std::condition_variable _cvOut;
+    std::deque< std::shared_ptr<emu_block_t> > _order;  // submission order
+    std::deque< std::shared_ptr<emu_block_t> > _work;   // not yet picked by an engine
+    std::deque< emu_chunk_t > _outFifo;
+
+    // Producer side state (only touched by the file_in writer)
+    std::string             _staging;
+    std::string             _tail;
+    bool                    _inPacket;
+
+    // Collector side state
+    size_t                  _outBytes;
+    uint32_t                _packetCrc;
+    unsigned long long      _packetSize;
+};
+
+void EmuGzipCore::start( void )
+{
+    _stop = false;
+    for(unsigned int i=0; i<_cfg.engines; i++)
+        _threads.push_back(std::thread(&EmuGzipCore::tEngine, this));
+    _threads.push_back(std::thread(&EmuGzipCore::tCollector, this));
+}
+
+void EmuGzipCore::stop( void )
+{
+    {
+        std::lock_guard<std::mutex> lock(_mtx);
+        _stop = true;
+    }
+    _cvWork.notify_all();
+    _cvDone.notify_all();
+    _cvSpace.notify_all();
+    _cvOut.notify_all();
+    for(size_t i=0; i<_threads.size(); i++)
+        _threads[i].join();
+    _threads.clear();
+}
+
+void EmuGzipCore::reset( void )
+{
+    stop();
+    _order.clear();
+    _work.clear();
+    _outFifo.clear();
+    _staging.clear();
+    _tail.clear();
+    _inPacket = false;
+    _outBytes = 0;
+    in.clearStats();
+    out.clearStats();
+    start();
+}
+
+/**
+ *  Close a stream port: a transfer blocked on it returns an error
+ */
+void EmuGzipCore::closePort( EmuStreamPort & port )
+{
+    {
+        std::lock_guard<std::mutex> lock(_mtx);
+        port.opened = false;
+    }
+    _cvSpace.notify_all();
+    _cvOut.notify_all();
+}
+
+int EmuGzipCore::submit( bool last )
+{
+    std::shared_ptr<emu_block_t> blk(new emu_block_t);
+    blk->first = !_inPacket;
+    blk->last  = last;
+    blk->done  = false;
+    blk->err   = 0;
+    blk->crc   = 0;
+    blk->in.swap(_staging);
+    if(!blk->first)
+        blk->dict.swap(_tail);
+
+    // Keep the window of this block to prime the next one
+    _tail.clear();
+    if(!last) {
+        size_t keep = blk->in.size() < GZIP_WINDOW_SIZE ? blk->in.size() : GZIP_WINDOW_SIZE;
+        _tail.assign(blk->in, blk->in.size()-keep, keep);
+    }
+    _inPacket = !last;
+    _staging.reserve(_cfg.blockSize);
+
+    std::unique_lock<std::mutex> lock(_mtx);
+    _cvSpace.wait(lock, [this]{ return _stop || !in.opened || _order.size() < _maxInflight; });
+    if(_stop || !in.opened)
+        return -1;
+    _order.push_back(blk);
+    _work.push_back(blk);
+    _cvWork.notify_one();
+    return 0;
+}
+
+int EmuGzipCore::write( const char *buffer, size_t size, bool eop )
+{
+    if(!in.opened)
+        return -1;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    in.link.transfer(size);
+
+    size_t done = 0;
+    while(done < size) {
+        size_t room = _cfg.blockSize - _staging.size();
+        size_t take = (size-done) < room ? (size-done) : room;
+        _staging.append(&buffer[done], take);
+        done += take;
+        if(_staging.size() == _cfg.blockSize && (done < size || !eop))
+            if(submit(false))
+                return -1;
+    }
+    if(eop) {
+        if(submit(true))
+            return -1;
+        in.packets++;
+    }
+
+    in.calls++;
+    in.bytes += size;
+    in.busyUsecs += std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now()-start).count();
+    return 0;
+}
+
+int EmuGzipCore::read( char *buffer, size_t size, bool & eop, unsigned int & readBytes )
+{
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    eop = false;
+    readBytes = 0;
+
+    {
+        std::unique_lock<std::mutex> lock(_mtx);
+        _cvOut.wait(lock, [this]{ return _stop || !out.opened || !_outFifo.empty(); });
+        if(_outFifo.empty())
+            return -1;
+
+        // Drain up to size bytes, never across a packet boundary
+        while(!_outFifo.empty() && readBytes < size && !eop) {
+            emu_chunk_t & chunk = _outFifo.front();
+            size_t avail = chunk.data.size() - chunk.offset;
+            size_t take  = avail < (size-readBytes) ? avail : (size-readBytes);
+            memcpy(&buffer[readBytes], &chunk.data[chunk.offset], take);
+            chunk.offset += take;
+            readBytes += (unsigned int)take;
+            _outBytes -= take;
+            if(chunk.offset == chunk.data.size()) {
+                eop = chunk.eop;
+                _outFifo.pop_front();
+            }
+        }
+    }
+    _cvSpace.notify_all();
+
+    out.link.transfer(readBytes);
+    out.calls++;
+    out.bytes += readBytes;
+    if(eop)
+        out.packets++;
+    out.busyUsecs += std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now()-start).count();
+    return 0;
+}
+
+/**
+ *  Engine thread: deflate blocks as they are submitted
+ */
+void EmuGzipCore::tEngine( void )
+{
+    DeflateContext ctx(_cfg.level);
+    while(true) {
+        std::shared_ptr<emu_block_t> blk;
+        {
+            std::unique_lock<std::mutex> lock(_mtx);
+            _cvWork.wait(lock, [this]{ return _stop || !_work.empty(); });
+            if(_stop)
+                return;
+            blk = _work.front();
+            _work.pop_front();
+        }
+
+        std::string compressed;
+        compressed.reserve(blk->in.size()/2 + 64);
+        blk->err = ctx.compress(blk->in.data(), blk->in.size(), blk->dict.data(), blk->dict.size(),
+                                blk->last, compressed, blk->crc);
+
+        {
+            std::lock_guard<std::mutex> lock(_mtx);
+            blk->out.swap(compressed);
+            blk->done = true;
+        }
+        _cvDone.notify_all();
+    }
+}
+
+/**
+ *  Collector thread: frame compressed blocks in submission order
+ */
+void EmuGzipCore::tCollector( void )
+{
+    while(true) {
+        std::shared_ptr<emu_block_t> blk;
+        {
+            std::unique_lock<std::mutex> lock(_mtx);
+            _cvDone.wait(lock, [this]{ return _stop || (!_order.empty() && _order.front()->done); });
+            if(_stop)
+                return;
+            blk = _order.front();
+            _order.pop_front();
+        }
+        _cvSpace.notify_all();
+
+        if(blk->err)
+            std::cerr << KRED << "QpEmulator: deflate error " << blk->err << KNRM << std::endl;
+
+        // Model the core processing rate on the uncompressed side
+        _coreModel.transfer(blk->in.size());
+
+        emu_chunk_t chunk;
+        chunk.offset = 0;
+        chunk.eop = blk->last;
+        if(blk->first) {
+            gzip_write_header(chunk.data);
+            _packetCrc = blk->crc;
+            _packetSize = blk->in.size();
+        }
+        else {
+            _packetCrc = crc32_combine(_packetCrc, blk->crc, (z_off_t)blk->in.size());
+            _packetSize += blk->in.size();
+        }
+        chunk.data.append(blk->out);
+        if(blk->last)
+            gzip_write_trailer(chunk.data, _packetCrc, (uint32_t)_packetSize);
+
+        std::unique_lock<std::mutex> lock(_mtx);
+        _cvSpace.wait(lock, [this]{ return _stop || _outBytes < _cfg.fifoSize; });
+        if(_stop)
+            return;
+        _outBytes += chunk.data.size();
+        _outFifo.push_back(emu_chunk_t());
+        _outFifo.back().data.swap(chunk.data);
+        _outFifo.back().offset = 0;
+        _outFifo.back().eop = chunk.eop;
+        _cvOut.notify_all();
+    }
+}
+
+/**
+ *  QuickAPI_ConnectDevice
+ */
+int QuickAPI_ConnectDevice(TPCIeParam params, TPCIeConnHdl & handle)
+{
+    if(params.BoardIndex >= emu_board_count())
+        return -1;
+    handle = (TPCIeConnHdl)(uintptr_t)(params.BoardIndex + 1);
+    return 0;
+}
+
+/**
+ *  QuickAPI_ReadRegister
+ */
+int QuickAPI_ReadRegister(TPCIeConnHdl handle, UINT32 address, UINT32 *values, UINT32 count)
+{
+    if(!handle || !values)
+        return -1;
+
+    // Only the UDID registers (0..3) are implemented
+    UINT32 udidRegs[4];
+    emu_udid_to_registers(emu_load_config().udid, udidRegs);
+    for(UINT32 i=0; i<count; i++)
+        values[i] = (address+i < 4) ? udidRegs[address+i] : 0;
+    return 0;
+}
+
+/**
+ *  QuickAPI_DisconnectDevice
+ */
+int QuickAPI_DisconnectDevice(TPCIeConnHdl handle)
+{
+    return handle ? 0 : -1;
+}
+
+int QpConfigInfo::parsingINIfile( std::string designName, std::string jsonDir )
+{
+    _udid = "";
+    std::ifstream json((jsonDir + "/" + designName + ".json").c_str());
+    if(!json)
+        return -1;
+
+    std::stringstream content;
+    content << json.rdbuf();
+    std::string text = content.str();
+
+    size_t key = text.find("\"udid\"");
+    if(key == std::string::npos)
+        return -1;
+    size_t begin = text.find('"', text.find(':', key));
+    size_t end = text.find('"', begin+1);
+    if(begin == std::string::npos || end == std::string::npos)
+        return -1;
+    _udid = text.substr(begin+1, end-begin-1);
+    return 0;
+}
+
+QpDesign::QpDesign() :
+    _core( NULL ),
+    _board( 0 )
+{}
+
+QpDesign::~QpDesign()
+{
+    qpCloseDesign();
+}
+
+int QpDesign::qpOpenDesign( const char *designName, const char *licSearchPath, const char *jsonPath,
+                            unsigned int boardIndex )
+{
+    (void)licSearchPath;    // no DRM on the emulated board
+
+    if(boardIndex >= emu_board_count()) {
+        std::cerr << KRED << "QpEmulator: no board at index " << boardIndex << KNRM << std::endl;
+        return -1;
+    }
+
+    QpConfigInfo info;
+    if(info.parsingINIfile(designName, jsonPath)) {
+        std::cerr << KRED << "QpEmulator: unable to load design [" << designName << "] from [" << jsonPath << "]" << KNRM << std::endl;
+        return -1;
+    }
+    if(_core)
+        qpCloseDesign();
+
+    _board = boardIndex;
+    _core = new EmuGzipCore(emu_load_config(boardIndex));
+    return 0;
+}
+
+int QpDesign::qpResetDesign( void )
+{
+    if(!_core)
+        return -1;
+    _core->reset();
+    return 0;
+}
+
+int QpDesign::qpCloseDesign( void )
+{
+    delete _core;
+    _core = NULL;
+    return 0;
+}
+
+int QpStream::setFifoSize( unsigned int size )
+{
+    if(!_options)
+        return -1;
+    _fifoSize = size;
+    return 0;
+}
+
+int QpStream::setStreamOption( std::string option, TPCIeStreamMode mode )
+{
+    if(!_options || option != "streamMode")
+        return -1;
+    _mode = mode;
+    return 0;
+}
+
+int QpStream::setStreamOption( std::string option, TPCIeStreamInterrupt intParam )
+{
+    if(!_options || option != "streamIntParam")
+        return -1;
+    _intParam = intParam;
+    return 0;
+}
+
+int QpStream::getStreamOption( std::string option, char *& buffer )
+{
+    // No dmaBuffer: SGDMA streams are not emulated
+    buffer = NULL;
+    return -1;
+}
+
+int QpDesign::qpEnableStreamOptions( QpStream & stream )
+{
+    stream._options = true;
+    return 0;
+}
+
+int QpDesign::qpOpenStream( QpStream & stream )
+{
+    if(!_core)
+        return -1;
+    if(stream._mode == PCIE_STREAM_SGDMA) {
+        std::cerr << KRED << "Emulated board: SGDMA stream " << stream.getName() << " is not supported, build with SGDMAR" << KNRM << std::endl;
+        return -1;
+    }
+
+    EmuStreamPort *port = NULL;
+    if(stream.getName() == _core->in.name)
+        port = &_core->in;
+    else if(stream.getName() == _core->out.name)
+        port = &_core->out;
+    else
+        return -1;
+
+    port->opened = true;
+    stream._port = port;
+    return 0;
+}
+
+int QpDesign::qpCloseStream( QpStream & stream )
+{
+    if(!_core || !stream._port)
+        return -1;
+    // The handle stays bound: a transfer another thread is blocked in, or
+    // starts, on this stream fails instead of waiting for data
+    _core->closePort(*stream._port);
+    return 0;
+}
+
+int QpDesign::qpWriteStream( QpStream & stream, void *buffer, unsigned int size, bool eop )
+{
+    if(!_core || stream._port != &_core->in)
+        return -1;
+    return _core->write((const char *)buffer, size, eop);
+}
+
+int QpDesign::qpReadStream( QpStream & stream, void *buffer, unsigned int size, bool & eop, unsigned int & readBytes )
+{
+    if(!_core || stream._port != &_core->out) {
+        eop = false;
+        readBytes = 0;
+        return -1;
+    }
+    return _core->read((char *)buffer, size, eop, readBytes);
+}
+
+void QpDesign::qpPrintHwReport( std::ostream & os, std::string streamName )
+{
+    if(!_core)
+        return;
+
+    EmuStreamPort *port = (streamName == _core->in.name) ? &_core->in : &_core->out;
+    if(streamName != port->name)
+        return;
+
+    const emu_config_t & cfg = _core->config();
+    double busySecs = port->busyUsecs / 1e6;
+    double linkMBps = port->toDevice ? cfg.writeMBps : cfg.readMBps;
+
+    os << "[QpEmulator] board " << _board << " stream " << port->name << (port->toDevice ? " (host->device)" : " (device->host)") << std::endl;
+    os << "    engines=" << cfg.engines << " level=" << cfg.level << " block=" << cfg.blockSize
+       << " fifo=" << cfg.fifoSize << std::endl;
+    os << "    link=";
+    if(linkMBps > 0.0) os << linkMBps << " MB/s"; else os << "unlimited";
+    os << " latency=" << cfg.latencyUs << " us core=";
+    if(cfg.coreMBps > 0.0) os << cfg.coreMBps << " MB/s"; else os << "unlimited";
+    os << std::endl;
+    os << "    calls=" << port->calls << " packets=" << port->packets << " bytes=" << port->bytes
+       << " busy=" << std::fixed << std::setprecision(3) << busySecs << " s";
+    if(busySecs > 0.0)
+        os << " (" << std::setprecision(2) << (port->bytes / busySecs / 0x100000) << " MB/s while busy)";
+    os << std::endl;
+}
+
+}
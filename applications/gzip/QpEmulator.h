@@ -0,0 +1,161 @@
+/** QuickPlay
+ *
+ *  Software emulation of the QuickPlay API subset used by gzip_fpga.
+ *  Built instead of <QpDesign.h> when QP_EMULATION is defined (see the
+ *  Emulation build configuration). The emulated design exposes the same
+ *  file_in/archive_out stream pair as the GzipHC bitstream: every packet
+ *  written to file_in up to its EOP comes back on archive_out as one gzip
+ *  member, also terminated by EOP.
+ *
+ *  The emulated boards are configured through environment variables, read
+ *  when the design is opened. Numeric settings accept a comma separated list,
+ *  one value per board (the last value applies to the remaining boards):
+ *    QP_EMU_BOARDS        number of boards found on the bus (default: 1)
+ *    QP_EMU_UDID          design UDID returned by the board registers
+ *    QP_EMU_ENGINES       number of deflate engines (default: all cores)
+ *    QP_EMU_LEVEL         deflate level of the engines (default: 9)
+ *    QP_EMU_BLOCK_SIZE    bytes compressed per engine job (default: 128 KB)
+ *    QP_EMU_FIFO_SIZE     bytes buffered on each side of the core (default: 32 MB)
+ *    QP_EMU_WRITE_MBPS    host->device DMA bandwidth, 0 = unlimited
+ *    QP_EMU_READ_MBPS     device->host DMA bandwidth, 0 = unlimited
+ *    QP_EMU_LATENCY_US    fixed cost of each qpWriteStream/qpReadStream call
+ *    QP_EMU_CORE_MBPS     compression core throughput cap, 0 = unlimited
+ *
+ *  Only the SGDMAR stream mode is emulated: host buffers are passed to each
+ *  qpWriteStream/qpReadStream call. The SGDMA stream options are declared
+ *  with the SDK signatures so that both modes build, but a stream configured
+ *  for SGDMA, whose transfers go through a driver owned dmaBuffer, fails to
+ *  open.
+ */
+
+#ifndef QP_EMULATOR_H
+#define QP_EMULATOR_H
+
+#include <stdint.h>
+#include <string>
+#include <fstream>
+#include <sstream>
+#include <ostream>
+
+/* Console colors, provided by the QuickPlay SDK headers on real targets */
+#define KNRM  "\x1B[0m"
+#define KRED  "\x1B[31m"
+#define KGRN  "\x1B[32m"
+#define KYEL  "\x1B[33m"
+#define KBLU  "\x1B[34m"
+#define KMAG  "\x1B[35m"
+#define KCYN  "\x1B[36m"
+#define KWHT  "\x1B[37m"
+
+namespace QuickPlayLib {
+
+typedef uint32_t UINT32;
+typedef void*    TPCIeConnHdl;
+
+typedef struct {
+    UINT32  VendorID;
+    UINT32  DeviceID;
+    UINT32  BoardIndex;
+} TPCIeParam;
+
+typedef enum {
+    PCIE_STREAM_SGDMAR = 0,     // host buffer passed to each transfer
+    PCIE_STREAM_SGDMA           // transfers through the stream dmaBuffer
+} TPCIeStreamMode;
+
+typedef struct {
+    bool    intEnable;
+    void    (*userIrqHandler)(void *);
+} TPCIeStreamInterrupt;
+
+/* Board register access, used to read the design UDID */
+int QuickAPI_ConnectDevice(TPCIeParam params, TPCIeConnHdl & handle);
+int QuickAPI_ReadRegister(TPCIeConnHdl handle, UINT32 address, UINT32 *values, UINT32 count);
+int QuickAPI_DisconnectDevice(TPCIeConnHdl handle);
+
+/**
+ *  Design description loaded from the bitstream JSON file
+ */
+class QpConfigInfo {
+
+    public:
+    int parsingINIfile( std::string designName, std::string jsonDir );
+
+    std::string getUdid( void ) const
+    { return _udid; }
+
+    private:
+    std::string _udid;
+};
+
+class EmuStreamPort;
+class EmuGzipCore;
+
+/**
+ *  Stream handle, bound to an emulated stream port by qpOpenStream
+ */
+class QpStream {
+
+    public:
+    QpStream( std::string name, int nbBuffers ) :
+        _name( name ),
+        _nbBuffers( nbBuffers ),
+        _options( false ),
+        _mode( PCIE_STREAM_SGDMAR ),
+        _fifoSize( 0 ),
+        _port( NULL )
+    {}
+
+    std::string getName( void ) const
+    { return _name; }
+
+    // Stream options, once enabled by qpEnableStreamOptions
+    int setFifoSize( unsigned int size );
+    int setStreamOption( std::string option, TPCIeStreamMode mode );
+    int setStreamOption( std::string option, TPCIeStreamInterrupt intParam );
+    int getStreamOption( std::string option, char *& buffer );
+
+    private:
+    friend class QpDesign;
+    std::string          _name;
+    int                  _nbBuffers;
+    bool                 _options;
+    TPCIeStreamMode      _mode;
+    unsigned int         _fifoSize;
+    TPCIeStreamInterrupt _intParam;
+    EmuStreamPort       *_port;
+};
+
+/**
+ *  Emulated GzipHC design
+ */
+class QpDesign {
+
+    public:
+    QpDesign();
+    ~QpDesign();
+
+    int qpOpenDesign( const char *designName, const char *licSearchPath, const char *jsonPath,
+                      unsigned int boardIndex = 0 );
+    int qpResetDesign( void );
+    int qpCloseDesign( void );
+
+    int qpEnableStreamOptions( QpStream & stream );
+    int qpOpenStream( QpStream & stream );
+    int qpCloseStream( QpStream & stream );
+    int qpWriteStream( QpStream & stream, void *buffer, unsigned int size, bool eop );
+    int qpReadStream( QpStream & stream, void *buffer, unsigned int size, bool & eop, unsigned int & readBytes );
+
+    void qpPrintHwReport( std::ostream & os, std::string streamName );
+
+    private:
+    QpDesign( const QpDesign & );
+    QpDesign & operator=( const QpDesign & );
+
+    EmuGzipCore  *_core;
+    unsigned int _board;
+};
+
+}
+
+#endif
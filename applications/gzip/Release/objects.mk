@@ -4,5 +4,5 @@
 
 USER_OBJS :=
 
-LIBS := -lpldaqplay -lpldaqpcie -lpthread -lrt
+LIBS := -lpldaqplay -lpldaqpcie -lz -lpthread -lrt
 
@@ -0,0 +1,401 @@
+/** QuickPlay
+ *
+ *  gzip_fpga software deflate primitives implementation file
+ */
+
+#include <string.h>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <algorithm>
+#include "SwDeflate.h"
+
+/* Largest chunk handed to zlib at once (avail_in is a 32-bit uInt) */
+#define ZLIB_MAX_CHUNK          0x40000000
+#define INFLATE_OUT_CHUNK       0x40000     // inflated bytes compared at once
+#define SW_GZIP_BLOCK_SIZE      0x100000    // input block deflated by one thread
+
+/**
+ *  gzip_write_header
+ */
+void gzip_write_header(std::string & out, const char *name)
+{
+    // ID1 ID2 CM FLG MTIME(4) XFL OS(3=Unix)
+    static const char header[GZIP_HEADER_SIZE] = { '\x1f', '\x8b', 8, 0, 0, 0, 0, 0, 0, 3 };
+    size_t start = out.size();
+    out.append(header, GZIP_HEADER_SIZE);
+    if(name && *name) {
+        out[start+3] = GZIP_FLG_FNAME;
+        out.append(name, strlen(name)+1);
+    }
+}
+
+/**
+ *  gzip_header_size
+ */
+long long int gzip_header_size(const char *data, size_t size)
+{
+    const unsigned char *hdr = (const unsigned char *)data;
+    if(size < GZIP_HEADER_SIZE || hdr[0] != 0x1f || hdr[1] != 0x8b || hdr[2] != 8)
+        return -1;
+
+    unsigned char flags = hdr[3];
+    size_t pos = GZIP_HEADER_SIZE;
+    if(flags & GZIP_FLG_FEXTRA) {
+        if(pos + 2 > size)
+            return -1;
+        pos += 2 + (hdr[pos] | (hdr[pos+1] << 8));
+    }
+    if(flags & GZIP_FLG_FNAME) {
+        while(pos < size && hdr[pos])
+            pos++;
+        pos++;
+    }
+    if(flags & GZIP_FLG_FCOMMENT) {
+        while(pos < size && hdr[pos])
+            pos++;
+        pos++;
+    }
+    if(flags & GZIP_FLG_FHCRC)
+        pos += 2;
+    return pos <= size ? (long long int)pos : -1;
+}
+
+/**
+ *  gzip_write_trailer
+ */
+void gzip_write_trailer(std::string & out, uint32_t crc, uint32_t isize)
+{
+    char trailer[GZIP_TRAILER_SIZE];
+    for(int i=0; i<4; i++) {
+        trailer[i]   = (char)((crc   >> (8*i)) & 0xFF);
+        trailer[4+i] = (char)((isize >> (8*i)) & 0xFF);
+    }
+    out.append(trailer, GZIP_TRAILER_SIZE);
+}
+
+/**
+ *  BGZF header of a block of blockSize bytes: FEXTRA with the BC subfield,
+ *  whose BSIZE is the block size minus one
+ */
+static void bgzf_write_header(std::string & out, size_t blockSize)
+{
+    char header[BGZF_HEADER_SIZE] = { '\x1f', '\x8b', 8, GZIP_FLG_FEXTRA, 0, 0, 0, 0, 0, '\xff', 6, 0, 'B', 'C', 2, 0, 0, 0 };
+    header[16] = (char)((blockSize-1) & 0xFF);
+    header[17] = (char)(((blockSize-1) >> 8) & 0xFF);
+    out.append(header, BGZF_HEADER_SIZE);
+}
+
+/**
+ *  bgzf_write_member
+ */
+int bgzf_write_member(std::string & out, const char *data, size_t size)
+{
+    long long int header = gzip_header_size(data, size);
+    if(header < 0 || size < (size_t)header + GZIP_TRAILER_SIZE)
+        return -1;
+    size_t blockSize = BGZF_HEADER_SIZE + size - header;
+    if(blockSize > BGZF_MAX_BLOCK_SIZE)
+        return -1;
+    bgzf_write_header(out, blockSize);
+    out.append(&data[header], size - header);
+    return 0;
+}
+
+/**
+ *  deflate_write_stored
+ */
+void deflate_write_stored(std::string & out, const char *in, size_t size, bool last)
+{
+    size_t done = 0;
+    do {
+        size_t len = std::min(size - done, (size_t)DEFLATE_STORED_MAX);
+        bool bfinal = last && (done + len == size);
+        if(!len && !bfinal)
+            break;
+        // BFINAL, BTYPE=00, LEN and its one's complement NLEN
+        const char header[DEFLATE_STORED_HEADER] = { (char)(bfinal ? 1 : 0), (char)(len & 0xFF), (char)((len >> 8) & 0xFF),
+                                                     (char)(~len & 0xFF), (char)((~len >> 8) & 0xFF) };
+        out.append(header, DEFLATE_STORED_HEADER);
+        out.append(&in[done], len);
+        done += len;
+    } while(done < size);
+}
+
+/**
+ *  sw_gzip_stored
+ */
+void sw_gzip_stored(const char *in, size_t size, uint32_t crc, std::string & out)
+{
+    out.reserve(out.size() + GZIP_HEADER_SIZE + size + (size/DEFLATE_STORED_MAX + 1)*DEFLATE_STORED_HEADER + GZIP_TRAILER_SIZE);
+    gzip_write_header(out);
+    deflate_write_stored(out, in, size, true);
+    gzip_write_trailer(out, crc, (uint32_t)size);
+}
+
+/**
+ *  bgzf_write_stored
+ */
+void bgzf_write_stored(std::string & out, const char *in, size_t size)
+{
+    // One final stored deflate block, size is at most BGZF_BLOCK_SIZE
+    bgzf_write_header(out, BGZF_HEADER_SIZE + DEFLATE_STORED_HEADER + size + GZIP_TRAILER_SIZE);
+    deflate_write_stored(out, in, size, true);
+    gzip_write_trailer(out, crc32(0L, (const Bytef *)in, (uInt)size), (uint32_t)size);
+}
+
+/**
+ *  bgzf_write_eof
+ */
+void bgzf_write_eof(std::string & out)
+{
+    const char empty[2] = { 3, 0 };     // final fixed Huffman block, end of block code only
+    bgzf_write_header(out, BGZF_EOF_SIZE);
+    out.append(empty, sizeof(empty));
+    gzip_write_trailer(out, 0, 0);
+}
+
+/**
+ *  gzip_check_member
+ */
+int gzip_check_member(const char *data, size_t size, uint32_t crc, unsigned long long isize)
+{
+    long long int header = gzip_header_size(data, size);
+    if(header < 0 || size < (size_t)header + GZIP_TRAILER_SIZE)
+        return GZIP_CHECK_BAD_FORMAT;
+
+    const unsigned char *trailer = (const unsigned char *)&data[size - GZIP_TRAILER_SIZE];
+    uint32_t memberCrc = 0, memberSize = 0;
+    for(int i=3; i>=0; i--) {
+        memberCrc  = (memberCrc  << 8) | trailer[i];
+        memberSize = (memberSize << 8) | trailer[4+i];
+    }
+    if(memberCrc != crc)
+        return GZIP_CHECK_BAD_CRC;
+    if(memberSize != (uint32_t)isize)     // ISIZE is the size modulo 2^32
+        return GZIP_CHECK_BAD_SIZE;
+    return GZIP_CHECK_OK;
+}
+
+/**
+ *  gzip_inflate_compare
+ */
+int gzip_inflate_compare(const char *data, size_t size, const char *orig, size_t origSize)
+{
+    z_stream strm;
+    memset(&strm, 0, sizeof(strm));
+    if(!size || inflateInit2(&strm, 15+16) != Z_OK)      // gzip framing
+        return GZIP_CHECK_BAD_FORMAT;
+
+    char out[INFLATE_OUT_CHUNK];
+    size_t consumed = 0, compared = 0;
+    int retCode = GZIP_CHECK_OK;
+    while(consumed < size && retCode == GZIP_CHECK_OK) {
+        size_t chunk = (size - consumed) > ZLIB_MAX_CHUNK ? ZLIB_MAX_CHUNK : (size - consumed);
+        strm.next_in  = (Bytef *)(data + consumed);
+        strm.avail_in = (uInt)chunk;
+
+        int ret;
+        do {
+            strm.next_out  = (Bytef *)out;
+            strm.avail_out = INFLATE_OUT_CHUNK;
+            ret = inflate(&strm, Z_NO_FLUSH);
+            if(ret != Z_OK && ret != Z_STREAM_END && ret != Z_BUF_ERROR) {
+                retCode = GZIP_CHECK_BAD_FORMAT;
+                break;
+            }
+            size_t produced = INFLATE_OUT_CHUNK - strm.avail_out;
+            if(compared + produced > origSize || memcmp(out, &orig[compared], produced)) {
+                retCode = GZIP_CHECK_MISMATCH;
+                break;
+            }
+            compared += produced;
+
+            // Next member, if any
+            if(ret == Z_STREAM_END && inflateReset(&strm) != Z_OK)
+                retCode = GZIP_CHECK_BAD_FORMAT;
+        } while(retCode == GZIP_CHECK_OK && (strm.avail_out == 0 || (ret == Z_STREAM_END && strm.avail_in)));
+
+        // A truncated member stops making progress
+        if(retCode == GZIP_CHECK_OK && strm.avail_in == chunk && ret == Z_BUF_ERROR)
+            retCode = GZIP_CHECK_BAD_FORMAT;
+        consumed += chunk - strm.avail_in;
+    }
+
+    // The last member must be complete: a reset stream has no pending state
+    if(retCode == GZIP_CHECK_OK && (strm.total_in != 0 || strm.total_out != 0))
+        retCode = GZIP_CHECK_BAD_FORMAT;
+    if(retCode == GZIP_CHECK_OK && compared != origSize)
+        retCode = GZIP_CHECK_MISMATCH;
+    inflateEnd(&strm);
+    return retCode;
+}
+
+DeflateContext::DeflateContext( int level ) :
+    _level( level ),
+    _ready( false )
+{
+    memset(&_strm, 0, sizeof(_strm));
+    // Negative window bits: raw deflate, framing is handled by the caller
+    _ready = (deflateInit2(&_strm, level, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY) == Z_OK);
+}
+
+DeflateContext::~DeflateContext()
+{
+    if(_ready)
+        deflateEnd(&_strm);
+}
+
+int DeflateContext::compress( const char *in, size_t len, const char *dict, size_t dictLen,
+                              bool last, std::string & out, uint32_t & crc )
+{
+    if(!_ready)
+        return Z_STREAM_ERROR;
+
+    int ret = deflateReset(&_strm);
+    if(ret != Z_OK)
+        return ret;
+
+    if(dict && dictLen) {
+        if(dictLen > GZIP_WINDOW_SIZE) {
+            dict += dictLen - GZIP_WINDOW_SIZE;
+            dictLen = GZIP_WINDOW_SIZE;
+        }
+        ret = deflateSetDictionary(&_strm, (const Bytef *)dict, (uInt)dictLen);
+        if(ret != Z_OK)
+            return ret;
+    }
+
+    crc = crc32(0L, Z_NULL, 0);
+    size_t consumed = 0;
+    do {
+        size_t chunk = (len - consumed) > ZLIB_MAX_CHUNK ? ZLIB_MAX_CHUNK : (len - consumed);
+        bool   final = (consumed + chunk == len);
+        int    flush = final ? (last ? Z_FINISH : Z_SYNC_FLUSH) : Z_NO_FLUSH;
+
+        _strm.next_in  = (Bytef *)(in + consumed);
+        _strm.avail_in = (uInt)chunk;
+        crc = crc32(crc, (const Bytef *)(in + consumed), (uInt)chunk);
+
+        // Grow the output string until zlib has consumed the chunk and flushed
+        do {
+            size_t room = deflateBound(&_strm, _strm.avail_in) + 64;
+            size_t used = out.size();
+            out.resize(used + room);
+            _strm.next_out  = (Bytef *)&out[used];
+            _strm.avail_out = (uInt)room;
+            ret = deflate(&_strm, flush);
+            out.resize(used + (room - _strm.avail_out));
+            if(ret == Z_STREAM_ERROR)
+                return ret;
+        } while(_strm.avail_out == 0 || (flush == Z_FINISH && ret != Z_STREAM_END));
+
+        consumed += chunk;
+    } while(consumed < len);
+
+    return Z_OK;
+}
+
+/**
+ *  sw_bgzf_buffer
+ */
+int sw_bgzf_buffer(const char *in, size_t size, int level, unsigned int nbThreads, std::string & out)
+{
+    size_t nbBlocks = (size + BGZF_BLOCK_SIZE - 1) / BGZF_BLOCK_SIZE;
+    if(nbThreads > nbBlocks)
+        nbThreads = nbBlocks;
+    if(!nbThreads)
+        return Z_OK;
+
+    std::vector<std::string> blocks(nbBlocks);
+    std::atomic<size_t> next(0);
+    std::atomic<int> err(Z_OK);
+    std::vector<std::thread> threads;
+    for(unsigned int t=0; t<nbThreads; t++)
+        threads.push_back(std::thread([&]{
+            DeflateContext ctx(level);
+            std::string deflated;
+            size_t b;
+            while((b = next++) < nbBlocks && err == Z_OK) {
+                size_t offset = b*BGZF_BLOCK_SIZE;
+                size_t len = (size - offset) < BGZF_BLOCK_SIZE ? (size - offset) : BGZF_BLOCK_SIZE;
+                uint32_t crc;
+                deflated.clear();
+                int ret = ctx.compress(&in[offset], len, NULL, 0, true, deflated, crc);
+                if(ret != Z_OK) {
+                    err = ret;
+                    break;
+                }
+                if(BGZF_HEADER_SIZE + deflated.size() + GZIP_TRAILER_SIZE > BGZF_MAX_BLOCK_SIZE) {
+                    bgzf_write_stored(blocks[b], &in[offset], len);
+                    continue;
+                }
+                bgzf_write_header(blocks[b], BGZF_HEADER_SIZE + deflated.size() + GZIP_TRAILER_SIZE);
+                blocks[b].append(deflated);
+                gzip_write_trailer(blocks[b], crc, (uint32_t)len);
+            }
+        }));
+    for(unsigned int t=0; t<nbThreads; t++)
+        threads[t].join();
+    if(err != Z_OK)
+        return err;
+
+    for(size_t b=0; b<nbBlocks; b++)
+        out.append(blocks[b]);
+    return Z_OK;
+}
+
+/**
+ *  sw_gzip_buffer
+ */
+int sw_gzip_buffer(const char *in, size_t size, int level, unsigned int nbThreads, std::string & out)
+{
+    size_t nbBlocks = (size + SW_GZIP_BLOCK_SIZE - 1) / SW_GZIP_BLOCK_SIZE;
+    if(nbThreads > nbBlocks)
+        nbThreads = nbBlocks;
+    gzip_write_header(out);
+
+    // One thread: a single deflate stream, as gzip writes it
+    if(nbThreads <= 1) {
+        DeflateContext ctx(level);
+        uint32_t crc;
+        int ret = ctx.compress(in, size, NULL, 0, true, out, crc);
+        if(ret != Z_OK)
+            return ret;
+        gzip_write_trailer(out, crc, (uint32_t)size);
+        return 0;
+    }
+
+    std::vector<std::string> blocks(nbBlocks);
+    std::vector<uint32_t> crcs(nbBlocks);
+    std::atomic<size_t> next(0);
+    std::atomic<int> err(Z_OK);
+    std::vector<std::thread> threads;
+    for(unsigned int t=0; t<nbThreads; t++)
+        threads.push_back(std::thread([&]{
+            DeflateContext ctx(level);
+            size_t b;
+            while((b = next++) < nbBlocks && err == Z_OK) {
+                size_t offset = b*SW_GZIP_BLOCK_SIZE;
+                size_t len = (size - offset) < SW_GZIP_BLOCK_SIZE ? (size - offset) : SW_GZIP_BLOCK_SIZE;
+                size_t dictLen = offset < GZIP_WINDOW_SIZE ? offset : GZIP_WINDOW_SIZE;
+                int ret = ctx.compress(&in[offset], len, &in[offset-dictLen], dictLen, b == nbBlocks-1, blocks[b], crcs[b]);
+                if(ret != Z_OK)
+                    err = ret;
+            }
+        }));
+    for(unsigned int t=0; t<nbThreads; t++)
+        threads[t].join();
+    if(err != Z_OK)
+        return err;
+
+    uint32_t crc = crcs[0];
+    out.append(blocks[0]);
+    for(size_t b=1; b<nbBlocks; b++) {
+        size_t len = (b == nbBlocks-1) ? size - b*SW_GZIP_BLOCK_SIZE : SW_GZIP_BLOCK_SIZE;
+        crc = crc32_combine(crc, crcs[b], (z_off_t)len);
+        out.append(blocks[b]);
+    }
+    gzip_write_trailer(out, crc, (uint32_t)size);
+    return 0;
+}
@@ -0,0 +1,144 @@
+/** QuickPlay
+ *
+ *  gzip_fpga software deflate primitives header file
+ */
+
+#ifndef SW_DEFLATE_H
+#define SW_DEFLATE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string>
+#include <zlib.h>
+
+#define GZIP_WINDOW_SIZE        32768
+#define GZIP_HEADER_SIZE        10
+#define GZIP_TRAILER_SIZE       8
+
+#define GZIP_FLG_FHCRC          0x02
+#define GZIP_FLG_FEXTRA         0x04
+#define GZIP_FLG_FNAME          0x08
+#define GZIP_FLG_FCOMMENT       0x10
+
+#define DEFLATE_STORED_MAX      0xffff      // bytes per stored deflate block, LEN is 16-bit
+#define DEFLATE_STORED_HEADER   5           // BFINAL/BTYPE byte, LEN and NLEN
+
+#define BGZF_BLOCK_SIZE         0xff00      // input bytes per BGZF block, as bgzip cuts them
+#define BGZF_MAX_BLOCK_SIZE     0x10000     // whole block, BSIZE is 16-bit
+#define BGZF_HEADER_SIZE        18          // gzip header with XLEN and the BC subfield
+#define BGZF_EOF_SIZE           28
+
+/* gzip_check_member results */
+#define GZIP_CHECK_NONE         1           // not checked
+#define GZIP_CHECK_OK           0
+#define GZIP_CHECK_BAD_FORMAT   -1
+#define GZIP_CHECK_BAD_CRC      -2
+#define GZIP_CHECK_BAD_SIZE     -3
+#define GZIP_CHECK_MISMATCH     -4          // inflated data differs from the input
+
+/**
+ *  Append a minimal gzip member header (no mtime) to out, with an optional
+ *  original file name (FNAME field)
+ */
+void gzip_write_header(std::string & out, const char *name = NULL);
+
+/**
+ *  Size of the gzip member header at the start of data, optional fields
+ *  included. Returns -1 if data does not start with a valid header.
+ */
+long long int gzip_header_size(const char *data, size_t size);
+
+/**
+ *  Append a gzip member trailer (CRC32 + ISIZE, little endian) to out
+ */
+void gzip_write_trailer(std::string & out, uint32_t crc, uint32_t isize);
+
+/**
+ *  Check the gzip member of size bytes at data against the CRC32 and size
+ *  of its uncompressed data. Only the header and the trailer are read.
+ */
+int gzip_check_member(const char *data, size_t size, uint32_t crc, unsigned long long isize);
+
+/**
+ *  Inflate the gzip members of data (one or more, back-to-back) and compare
+ *  the result byte-for-byte with the size bytes of orig
+ */
+int gzip_inflate_compare(const char *data, size_t size, const char *orig, size_t origSize);
+
+/**
+ *  Append size bytes of in to out as stored deflate blocks, the last one
+ *  final if last is set. With no data, only a final empty block is written.
+ */
+void deflate_write_stored(std::string & out, const char *in, size_t size, bool last);
+
+/**
+ *  Append size bytes of in to out as one gzip member of stored deflate
+ *  blocks, crc being the CRC32 of in: for data that would not shrink
+ */
+void sw_gzip_stored(const char *in, size_t size, uint32_t crc, std::string & out);
+
+/**
+ *  Append the gzip member at data as a BGZF block: its header is replaced
+ *  by the BGZF one, whose BC subfield holds the block size. Returns -1 if
+ *  the member is not valid or the block would not fit in 64 KB.
+ */
+int bgzf_write_member(std::string & out, const char *data, size_t size);
+
+/**
+ *  Append size bytes of in as a BGZF block of stored deflate data, for
+ *  input the compressor expanded past 64 KB
+ */
+void bgzf_write_stored(std::string & out, const char *in, size_t size);
+
+/**
+ *  Append the BGZF end-of-file marker, an empty block
+ */
+void bgzf_write_eof(std::string & out);
+
+/**
+ *  Compress size bytes of in as BGZF blocks appended to out, the blocks
+ *  deflated in parallel by nbThreads threads. No end-of-file marker is
+ *  written. Returns 0 on success, a zlib error code otherwise.
+ */
+int sw_bgzf_buffer(const char *in, size_t size, int level, unsigned int nbThreads, std::string & out);
+
+/**
+ *  Compress size bytes of in into one gzip member appended to out, with
+ *  zlib at level. With several threads the input is cut in blocks deflated
+ *  in parallel, each one primed with the tail of the previous block, as
+ *  pigz does. Returns 0 on success, a zlib error code otherwise.
+ */
+int sw_gzip_buffer(const char *in, size_t size, int level, unsigned int nbThreads, std::string & out);
+
+/**
+ *  Raw deflate compressor reused across blocks by one worker thread
+ */
+class DeflateContext {
+
+    public:
+    DeflateContext( int level );
+    ~DeflateContext();
+
+    /**
+     *  Compress one block as raw deflate data appended to out.
+     *  The block is primed with dict (tail of the previous block) and ends on
+     *  a byte boundary (sync flush) unless last is set, in which case the
+     *  final deflate block is emitted. crc receives the CRC32 of the block.
+     *  Returns 0 on success, a zlib error code otherwise.
+     */
+    int compress( const char *in, size_t len, const char *dict, size_t dictLen,
+                  bool last, std::string & out, uint32_t & crc );
+
+    int level() const
+    { return _level; }
+
+    private:
+    DeflateContext( const DeflateContext & );
+    DeflateContext & operator=( const DeflateContext & );
+
+    z_stream _strm;
+    int      _level;
+    bool     _ready;
+};
+
+#endif
@@ -0,0 +1,457 @@
+/** QuickPlay
+ *
+ *  gzip_fpga parallel gzip decompression implementation file
+ */
+
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <zlib.h>
+#include <string>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <algorithm>
+#include <functional>
+#include "SwInflate.h"
+#include "SwDeflate.h"
+#include "Crc32.h"
+
+#define GUNZIP_MAX_AVAIL        (1U << 30)      // zlib counts input in 32-bit words
+#define GUNZIP_AHEAD            2               // members decoded ahead of the writer, per thread
+#define GUNZIP_CHUNKS           3               // inflater/writer buffers, single member path
+#define GUNZIP_RANGE_DONE       1               // range sink: every byte asked for is written
+
+typedef std::function<int(const char *, size_t)> gunzip_sink_t;
+
+static int write_all( int fd, const char *data, size_t size )
+{
+    if(fd < 0)
+        return 0;
+    size_t done = 0;
+    while(done < size) {
+        ssize_t ret = write(fd, &data[done], size-done);
+        if(ret < 0 && errno == EINTR)
+            continue;
+        if(ret <= 0)
+            return GUNZIP_WRITE_ERROR;
+        done += ret;
+    }
+    return 0;
+}
+
+/**
+ *  Raw inflate of the member at data, its output handed to sink chunk by
+ *  chunk. The sink may give chunk away and replace it with another buffer
+ *  of chunkSize bytes. memberSize receives the size of the member, trailer
+ *  included. The trailer is not checked here.
+ */
+static int inflate_member( const char *data, size_t size, char *& chunk, size_t chunkSize,
+                           size_t & memberSize, const gunzip_sink_t & sink )
+{
+    long long int header = gzip_header_size(data, size);
+    if(header < 0)
+        return GZIP_CHECK_BAD_FORMAT;
+
+    z_stream strm;
+    memset(&strm, 0, sizeof(strm));
+    if(inflateInit2(&strm, -MAX_WBITS) != Z_OK)
+        return GZIP_CHECK_BAD_FORMAT;
+
+    size_t pos = header;
+    int ret = Z_OK;
+    int err = GZIP_CHECK_OK;
+    while(ret != Z_STREAM_END && !err) {
+        if(!strm.avail_in) {
+            if(pos >= size) {
+                err = GZIP_CHECK_BAD_FORMAT;        // truncated
+                break;
+            }
+            strm.next_in = (Bytef *)&data[pos];
+            strm.avail_in = (uInt)std::min((size_t)GUNZIP_MAX_AVAIL, size-pos);
+            pos += strm.avail_in;
+        }
+        strm.next_out = (Bytef *)chunk;
+        strm.avail_out = (uInt)chunkSize;
+        ret = inflate(&strm, Z_NO_FLUSH);
+        if(ret != Z_OK && ret != Z_STREAM_END && ret != Z_BUF_ERROR) {
+            err = GZIP_CHECK_BAD_FORMAT;
+            break;
+        }
+        size_t produced = chunkSize - strm.avail_out;
+        if(produced)
+            err = sink(chunk, produced);
+    }
+    size_t consumed = pos - strm.avail_in;
+    inflateEnd(&strm);
+    if(err)
+        return err;
+    if(consumed + GZIP_TRAILER_SIZE > size)
+        return GZIP_CHECK_BAD_FORMAT;
+    memberSize = consumed + GZIP_TRAILER_SIZE;
+    return GZIP_CHECK_OK;
+}
+
+/**
+ *  Bytes after the last member: zeros are padding, anything else is not gzip
+ */
+static int check_tail( const char *data, size_t size )
+{
+    for(size_t i=0; i<size; i++)
+        if(data[i])
+            return GZIP_CHECK_BAD_FORMAT;
+    return GZIP_CHECK_OK;
+}
+
+/**
+ *  Single member path: this thread inflates, a writer thread computes the
+ *  CRC32, checks each trailer and writes. Members are taken in order.
+ */
+typedef struct {
+    char            *data;
+    size_t          len;
+    const char      *member;            // end of member marker: the member and its size
+    size_t          memberSize;
+} gunzip_chunk_t;
+
+static int gunzip_sequential( const char *data, size_t size, int fdOut, gunzip_stats_t & stats )
+{
+    std::vector<char> memory((size_t)GUNZIP_CHUNKS * GUNZIP_CHUNK_SIZE);
+    std::vector<char *> freeChunks;
+    for(int i=0; i<GUNZIP_CHUNKS; i++)
+        freeChunks.push_back(&memory[(size_t)i * GUNZIP_CHUNK_SIZE]);
+    std::deque<gunzip_chunk_t> filled;
+    std::mutex mtx;
+    std::condition_variable cv;
+    bool done = false;
+    int writeErr = GZIP_CHECK_OK;
+
+    std::thread writer([&] {
+        uint32_t crc = 0;
+        unsigned long long int isize = 0;
+        while(true) {
+            gunzip_chunk_t c;
+            {
+                std::unique_lock<std::mutex> lock(mtx);
+                cv.wait(lock, [&]{ return !filled.empty() || done; });
+                if(filled.empty())
+                    return;
+                c = filled.front();
+                filled.pop_front();
+            }
+            int err = GZIP_CHECK_OK;
+            if(c.member) {
+                err = gzip_check_member(c.member, c.memberSize, crc, isize);
+                crc = 0;
+                isize = 0;
+            }
+            else {
+                crc = crc32_fast(crc, c.data, c.len);
+                isize += c.len;
+                stats.outSize += c.len;
+                err = write_all(fdOut, c.data, c.len);
+            }
+            std::lock_guard<std::mutex> lock(mtx);
+            if(err && !writeErr)
+                writeErr = err;
+            if(!c.member)
+                freeChunks.push_back(c.data);
+            cv.notify_all();
+        }
+    });
+
+    // The inflater fills one chunk while the writer empties the others:
+    // the sink queues the chunk filled and takes a free one in its place
+    char *chunk;
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        chunk = freeChunks.back();
+        freeChunks.pop_back();
+    }
+    gunzip_sink_t sink = [&](const char *out, size_t len) -> int {
+        std::unique_lock<std::mutex> lock(mtx);
+        gunzip_chunk_t c = { (char *)out, len, NULL, 0 };
+        filled.push_back(c);
+        cv.notify_all();
+        cv.wait(lock, [&]{ return !freeChunks.empty(); });
+        chunk = freeChunks.back();
+        freeChunks.pop_back();
+        return writeErr;
+    };
+
+    int err = GZIP_CHECK_OK;
+    size_t pos = 0;
+    while(!err && pos < size) {
+        if(stats.members && gzip_header_size(&data[pos], size-pos) < 0) {
+            err = check_tail(&data[pos], size-pos);
+            break;
+        }
+        size_t memberSize = 0;
+        err = inflate_member(&data[pos], size-pos, chunk, GUNZIP_CHUNK_SIZE, memberSize, sink);
+        if(err)
+            break;
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            gunzip_chunk_t c = { NULL, 0, &data[pos], memberSize };
+            filled.push_back(c);
+            cv.notify_all();
+        }
+        stats.members++;
+        pos += memberSize;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        done = true;
+        cv.notify_all();
+    }
+    writer.join();
+    return err ? err : writeErr;
+}
+
+/**
+ *  Multi-member path
+ */
+typedef struct {
+    bool            done;
+    int             err;
+    size_t          memberSize;
+    std::string     out;
+} gunzip_member_t;
+
+static int gunzip_parallel( const char *data, size_t size, const std::vector<size_t> & starts,
+                            unsigned int nbThreads, int fdOut, gunzip_stats_t & stats )
+{
+    std::vector<gunzip_member_t> members(starts.size());
+    for(size_t i=0; i<members.size(); i++) {
+        members[i].done = false;
+        members[i].err = GZIP_CHECK_OK;
+        members[i].memberSize = 0;
+    }
+    std::mutex mtx;
+    std::condition_variable cv;
+    size_t next = 0;                    // next candidate to decode
+    size_t current = 0;                 // candidate the writer waits for
+    bool stop = false;
+    size_t ahead = (size_t)nbThreads * GUNZIP_AHEAD;
+
+    std::vector<std::thread> workers;
+    for(unsigned int t=0; t<nbThreads; t++) {
+        workers.push_back(std::thread([&] {
+            std::vector<char> memory(GUNZIP_CHUNK_SIZE);
+            char *chunk = &memory[0];
+            while(true) {
+                size_t i;
+                {
+                    std::unique_lock<std::mutex> lock(mtx);
+                    cv.wait(lock, [&]{ return stop || next >= starts.size() || std::max(next, current) < current + ahead; });
+                    if(stop || next >= starts.size())
+                        return;
+                    // Candidates behind the writer are inside members already written
+                    i = std::max(next, current);
+                    next = i + 1;
+                }
+
+                size_t pos = starts[i];
+                std::string out;
+                size_t memberSize = 0;
+                int err = inflate_member(&data[pos], size-pos, chunk, memory.size(), memberSize,
+                                         [&](const char *buf, size_t len) -> int { out.append(buf, len); return 0; });
+                if(!err)
+                    err = gzip_check_member(&data[pos], memberSize, crc32_fast(0, out.data(), out.size()), out.size());
+
+                std::lock_guard<std::mutex> lock(mtx);
+                // Failed candidates and the ones the writer went past keep no output
+                if(i >= current && !err) {
+                    members[i].out.swap(out);
+                    members[i].memberSize = memberSize;
+                }
+                members[i].err = err;
+                members[i].done = true;
+                cv.notify_all();
+            }
+        }));
+    }
+
+    // Follow the chain of members from the start of the archive
+    int err = GZIP_CHECK_OK;
+    size_t pos = 0;
+    while(!err) {
+        std::vector<size_t>::const_iterator it = std::lower_bound(starts.begin(), starts.end(), pos);
+        if(it == starts.end() || *it != pos) {
+            err = pos < size ? check_tail(&data[pos], size-pos) : GZIP_CHECK_OK;
+            break;
+        }
+        size_t i = it - starts.begin();
+        std::string out;
+        {
+            std::unique_lock<std::mutex> lock(mtx);
+            current = i;
+            cv.notify_all();
+            cv.wait(lock, [&]{ return members[i].done; });
+            err = members[i].err;
+            out.swap(members[i].out);
+        }
+        if(err)
+            break;
+        if((err = write_all(fdOut, out.data(), out.size())) != 0)
+            break;
+        stats.members++;
+        stats.outSize += out.size();
+        pos += members[i].memberSize;
+        if(pos >= size)
+            break;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        stop = true;
+        cv.notify_all();
+    }
+    for(size_t t=0; t<workers.size(); t++)
+        workers[t].join();
+    return err;
+}
+
+int sw_gunzip_buffer( const char *data, size_t size, unsigned int nbThreads, int fdOut, gunzip_stats_t & stats,
+                      const std::vector<size_t> *pStarts )
+{
+    stats.inSize = size;
+    stats.outSize = 0;
+    stats.members = 0;
+    stats.candidates = 0;
+    if(gzip_header_size(data, size) < 0)
+        return GZIP_CHECK_BAD_FORMAT;
+    if(nbThreads <= 1)
+        return gunzip_sequential(data, size, fdOut, stats);
+    if(pStarts) {
+        stats.candidates = pStarts->size();
+        if(pStarts->size() <= 1)
+            return gunzip_sequential(data, size, fdOut, stats);
+        return gunzip_parallel(data, size, *pStarts, nbThreads, fdOut, stats);
+    }
+
+    // Member start candidates: gzip magic, deflate method, no reserved flag
+    std::vector<std::vector<size_t> > found(nbThreads);
+    std::vector<std::thread> scanners;
+    size_t range = (size + nbThreads-1) / nbThreads;
+    for(unsigned int t=0; t<nbThreads; t++) {
+        scanners.push_back(std::thread([&, t] {
+            const unsigned char *hdr = (const unsigned char *)data;
+            size_t end = std::min(size, (size_t)(t+1) * range);
+            for(size_t p = (size_t)t * range; p < end; p++) {
+                const void *magic = memchr(&hdr[p], 0x1f, end-p);
+                if(!magic)
+                    break;
+                p = (const unsigned char *)magic - hdr;
+                if(p+3 < size && hdr[p+1] == 0x8b && hdr[p+2] == 8 && !(hdr[p+3] & 0xe0) &&
+                   gzip_header_size(&data[p], size-p) > 0)
+                    found[t].push_back(p);
+            }
+        }));
+    }
+    std::vector<size_t> starts;
+    for(unsigned int t=0; t<nbThreads; t++) {
+        scanners[t].join();
+        starts.insert(starts.end(), found[t].begin(), found[t].end());
+    }
+    stats.candidates = starts.size();
+
+    if(starts.size() <= 1)
+        return gunzip_sequential(data, size, fdOut, stats);
+    return gunzip_parallel(data, size, starts, nbThreads, fdOut, stats);
+}
+
+int sw_gunzip_range( const char *data, size_t size, unsigned long long skip, unsigned long long length,
+                     int fdOut, gunzip_stats_t & stats )
+{
+    stats.inSize = 0;
+    stats.outSize = 0;
+    stats.members = 0;
+    stats.candidates = 0;
+    std::vector<char> memory(GUNZIP_CHUNK_SIZE);
+    char *chunk = &memory[0];
+    uint32_t crc = 0;
+    unsigned long long isize = 0;
+
+    gunzip_sink_t sink = [&](const char *out, size_t len) -> int {
+        crc = crc32_fast(crc, out, len);
+        isize += len;
+        if(skip >= len) {
+            skip -= len;
+            return 0;
+        }
+        out += skip;
+        len -= skip;
+        skip = 0;
+        size_t n = (size_t)std::min((unsigned long long)len, length);
+        if(write_all(fdOut, out, n))
+            return GUNZIP_WRITE_ERROR;
+        length -= n;
+        stats.outSize += n;
+        return length ? 0 : GUNZIP_RANGE_DONE;
+    };
+
+    int err = GZIP_CHECK_OK;
+    size_t pos = 0;
+    while(length && pos < size) {
+        if(stats.members && gzip_header_size(&data[pos], size-pos) < 0)
+            break;
+        crc = 0;
+        isize = 0;
+        size_t memberSize = 0;
+        err = inflate_member(&data[pos], size-pos, chunk, GUNZIP_CHUNK_SIZE, memberSize, sink);
+        stats.members++;
+        if(err == GUNZIP_RANGE_DONE) {
+            err = GZIP_CHECK_OK;
+            break;
+        }
+        if(err || (err = gzip_check_member(&data[pos], memberSize, crc, isize)) != 0)
+            break;
+        pos += memberSize;
+    }
+    stats.inSize = pos;
+    return err;
+}
+
+long long int sw_gunzip_reference( const char *data, size_t size )
+{
+    z_stream strm;
+    memset(&strm, 0, sizeof(strm));
+    if(inflateInit2(&strm, 16 + MAX_WBITS) != Z_OK)
+        return -1;
+
+    std::vector<char> out(256 << 10);
+    long long int total = 0;
+    size_t pos = 0;
+    int ret = Z_OK;
+    while(true) {
+        if(!strm.avail_in) {
+            if(pos >= size)
+                break;
+            strm.next_in = (Bytef *)&data[pos];
+            strm.avail_in = (uInt)std::min((size_t)GUNZIP_MAX_AVAIL, size-pos);
+            pos += strm.avail_in;
+        }
+        strm.next_out = (Bytef *)&out[0];
+        strm.avail_out = out.size();
+        ret = inflate(&strm, Z_NO_FLUSH);
+        total += out.size() - strm.avail_out;
+        if(ret == Z_STREAM_END) {
+            // Next member, if any follows
+            if(!strm.avail_in && pos >= size)
+                break;
+            if(strm.avail_in && strm.next_in[0] != 0x1f)
+                break;
+            inflateReset(&strm);
+        }
+        else if(ret != Z_OK && ret != Z_BUF_ERROR) {
+            total = -1;
+            break;
+        }
+    }
+    inflateEnd(&strm);
+    return total;
+}
@@ -0,0 +1,54 @@
+/** QuickPlay
+ *
+ *  gzip_fpga parallel gzip decompression header file
+ *
+ *  The archives written by the device are multi-member in streaming, batch
+ *  and multi-board modes. Member starts are found by scanning for gzip
+ *  headers in parallel: every candidate is inflated by a pool of threads,
+ *  a few members ahead of the writer, and the writer follows the chain of
+ *  members from offset 0, so false candidates found inside compressed data
+ *  are simply never written. A single member can not be split without its
+ *  window: it is inflated on one thread while another one computes the
+ *  CRC32 and writes the output.
+ */
+
+#ifndef SW_INFLATE_H
+#define SW_INFLATE_H
+
+#include <stddef.h>
+#include <vector>
+
+#define GUNZIP_CHUNK_SIZE       (4 << 20)       // output handed from the inflater to the writer
+#define GUNZIP_WRITE_ERROR      -6              // output could not be written
+
+typedef struct {
+    long long int   inSize;
+    long long int   outSize;
+    unsigned int    members;            // members written
+    unsigned int    candidates;         // member starts found by the scan, false ones included
+} gunzip_stats_t;
+
+/**
+ *  Inflate the gzip members of size bytes at data into fdOut (-1 to only
+ *  test them) with nbThreads threads. Every member is checked against its
+ *  trailer. pStarts, the member offsets of an index, saves the scan.
+ *  Returns GZIP_CHECK_OK, another GZIP_CHECK_* code or GUNZIP_WRITE_ERROR.
+ */
+int sw_gunzip_buffer(const char *data, size_t size, unsigned int nbThreads, int fdOut, gunzip_stats_t & stats,
+                     const std::vector<size_t> *pStarts = NULL);
+
+/**
+ *  Write length bytes of the data inflated from the members at data, skip
+ *  bytes in, to fdOut. Members inflated to their end are checked against
+ *  their trailer. A range past the end of the data is cut short.
+ */
+int sw_gunzip_range(const char *data, size_t size, unsigned long long skip, unsigned long long length,
+                    int fdOut, gunzip_stats_t & stats);
+
+/**
+ *  Single-threaded zlib inflate of the members of data, as gunzip does,
+ *  output discarded. Returns the inflated size, -1 on error.
+ */
+long long int sw_gunzip_reference(const char *data, size_t size);
+
+#endif
@@ -0,0 +1,203 @@
+/** QuickPlay
+ *
+ *  gzip_fpga parallel directory tree walker implementation file
+ */
+
+#include <string.h>
+#include <dirent.h>
+#include <fnmatch.h>
+#include <sys/stat.h>
+#include <algorithm>
+#include <chrono>
+#include "TreeWalker.h"
+#include "GzipIndex.h"
+
+#define WALKER_MAX_QUEUED_FILES 0x10000     // walkers wait when the consumer lags behind
+
+TreeWalker::TreeWalker( unsigned int nbThreads, const std::vector<std::string> & includes,
+                        const std::vector<std::string> & excludes, bool archives ) :
+    _nbThreads( nbThreads ? nbThreads : 1 ),
+    _includes( includes ),
+    _excludes( excludes ),
+    _archives( archives ),
+    _busy( 0 ),
+    _stop( false ),
+    _nbDirs( 0 ),
+    _nbFiles( 0 )
+{}
+
+TreeWalker::~TreeWalker()
+{
+    stop();
+}
+
+int TreeWalker::start( std::string root )
+{
+    if(!_threads.empty())
+        return -1;
+
+    while(root.size() > 1 && root[root.size()-1] == '/')
+        root.erase(root.size()-1);
+    _stop = false;
+    _dirs.push_back(root);
+    for(unsigned int i=0; i<_nbThreads; i++)
+        _threads.push_back(std::thread(&TreeWalker::tWalker, this));
+    return 0;
+}
+
+bool TreeWalker::next( std::string & path )
+{
+    std::unique_lock<std::mutex> lock(_mtx);
+    _cvFiles.wait(lock, [this]{ return _stop || !_files.empty() || (_dirs.empty() && !_busy); });
+    if(_files.empty()) {
+        lock.unlock();
+        join();
+        return false;
+    }
+    path.swap(_files.front());
+    _files.pop_front();
+    _cvFiles.notify_all();
+    return true;
+}
+
+int TreeWalker::next( std::string & path, unsigned int timeoutMs )
+{
+    std::unique_lock<std::mutex> lock(_mtx);
+    if(!_cvFiles.wait_for(lock, std::chrono::milliseconds(timeoutMs),
+                          [this]{ return _stop || !_files.empty() || (_dirs.empty() && !_busy); }))
+        return 0;
+    if(_files.empty()) {
+        lock.unlock();
+        join();
+        return -1;
+    }
+    path.swap(_files.front());
+    _files.pop_front();
+    _cvFiles.notify_all();
+    return 1;
+}
+
+void TreeWalker::collect( std::vector<std::string> & files )
+{
+    std::string path;
+    while(next(path))
+        files.push_back(path);
+    std::sort(files.begin(), files.end());
+}
+
+void TreeWalker::stop( void )
+{
+    {
+        std::lock_guard<std::mutex> lock(_mtx);
+        _stop = true;
+    }
+    _cvDirs.notify_all();
+    _cvFiles.notify_all();
+    join();
+}
+
+void TreeWalker::join( void )
+{
+    for(size_t i=0; i<_threads.size(); i++)
+        _threads[i].join();
+    _threads.clear();
+}
+
+bool TreeWalker::matches( const std::vector<std::string> & patterns, const char *name ) const
+{
+    for(size_t i=0; i<patterns.size(); i++)
+        if(!fnmatch(patterns[i].c_str(), name, 0))
+            return true;
+    return false;
+}
+
+/**
+ *  Walker thread: read directories until none is queued or being read
+ */
+void TreeWalker::tWalker( void )
+{
+    while(true) {
+        std::string dir;
+        {
+            std::unique_lock<std::mutex> lock(_mtx);
+            _cvDirs.wait(lock, [this]{ return _stop || !_dirs.empty() || !_busy; });
+            if(_stop || _dirs.empty()) {
+                // Nothing queued and nobody reading: the walk is over
+                _cvDirs.notify_all();
+                _cvFiles.notify_all();
+                return;
+            }
+            // Depth first keeps the queue short on wide trees
+            dir.swap(_dirs.back());
+            _dirs.pop_back();
+            _busy++;
+            _nbDirs++;
+        }
+
+        readDir(dir);
+
+        std::lock_guard<std::mutex> lock(_mtx);
+        _busy--;
+        _cvDirs.notify_all();
+        _cvFiles.notify_all();
+    }
+}
+
+/**
+ *  Queue the sub-directories of dir and publish its files
+ */
+void TreeWalker::readDir( const std::string & dir )
+{
+    DIR *dp = opendir(dir.c_str());
+    if(!dp)
+        return;
+
+    std::vector<std::string> subDirs, found;
+    struct dirent *entry;
+    while((entry = readdir(dp)) != NULL) {
+        // Skip directory path files & hidden files
+        if(entry->d_name[0] == '.')
+            continue;
+        if(matches(_excludes, entry->d_name))
+            continue;
+
+        std::string path = dir + "/" + entry->d_name;
+        unsigned char type = entry->d_type;
+        if(type == DT_UNKNOWN) {
+            struct stat st;
+            if(lstat(path.c_str(), &st))
+                continue;
+            type = S_ISDIR(st.st_mode) ? DT_DIR : (S_ISREG(st.st_mode) ? DT_REG : DT_LNK);
+        }
+
+        if(type == DT_DIR)
+            subDirs.push_back(path);
+        else if(type == DT_REG) {
+            // Skip already existing .gz achives, or keep only them. Archive
+            // indexes are neither.
+            static const char indexSuffix[] = ".gz" GZIP_INDEX_SUFFIX;
+            size_t len = strlen(entry->d_name);
+            if(len >= sizeof(indexSuffix)-1 && !strcmp(&entry->d_name[len-(sizeof(indexSuffix)-1)], indexSuffix))
+                continue;
+            if((len >= 3 && !strcmp(&entry->d_name[len-3], ".gz")) != _archives)
+                continue;
+            if(!_includes.empty() && !matches(_includes, entry->d_name))
+                continue;
+            found.push_back(path);
+        }
+    }
+    closedir(dp);
+
+    std::unique_lock<std::mutex> lock(_mtx);
+    for(size_t i=0; i<subDirs.size(); i++)
+        _dirs.push_back(subDirs[i]);
+    if(!subDirs.empty())
+        _cvDirs.notify_all();
+
+    for(size_t i=0; i<found.size() && !_stop; i++) {
+        _cvFiles.wait(lock, [this]{ return _stop || _files.size() < WALKER_MAX_QUEUED_FILES; });
+        _files.push_back(found[i]);
+        _nbFiles++;
+        _cvFiles.notify_all();
+    }
+}
@@ -0,0 +1,82 @@
+/** QuickPlay
+ *
+ *  gzip_fpga parallel directory tree walker header file
+ *
+ *  A pool of threads shares a queue of directories still to be read. Each
+ *  directory is read once with readdir; entry types come from d_type, so
+ *  no stat is issued unless the file system leaves it unknown. Regular
+ *  files are published as soon as they are found, which lets compression
+ *  start while the walk is still running. Hidden entries, symbolic links
+ *  and existing .gz archives are skipped, as in the single-level listing;
+ *  for decompression only the .gz archives are kept.
+ */
+
+#ifndef TREE_WALKER_H
+#define TREE_WALKER_H
+
+#include <deque>
+#include <vector>
+#include <string>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+class TreeWalker {
+
+    public:
+    // includes: file name patterns to keep (all files if empty)
+    // excludes: file or directory name patterns to skip
+    // archives: keep the .gz archives only, instead of skipping them
+    TreeWalker( unsigned int nbThreads, const std::vector<std::string> & includes,
+                const std::vector<std::string> & excludes, bool archives = false );
+    ~TreeWalker();
+
+    // Start walking root in the background
+    int start( std::string root );
+
+    // Next file found, blocks while the walk is running.
+    // Returns false once the walk is over and every file has been returned.
+    bool next( std::string & path );
+
+    // Same, waiting no more than timeoutMs: 1 with a file, 0 when none was
+    // found in time, -1 once the walk is over and every file was returned
+    int next( std::string & path, unsigned int timeoutMs );
+
+    // Wait for the end of the walk and return every remaining file, sorted
+    void collect( std::vector<std::string> & files );
+
+    // Abort the walk
+    void stop( void );
+
+    unsigned long long dirs( void ) const
+    { return _nbDirs; }
+
+    unsigned long long files( void ) const
+    { return _nbFiles; }
+
+    private:
+    TreeWalker( const TreeWalker & );
+    TreeWalker & operator=( const TreeWalker & );
+
+    void tWalker( void );
+    void readDir( const std::string & dir );
+    bool matches( const std::vector<std::string> & patterns, const char *name ) const;
+    void join( void );
+
+    unsigned int                _nbThreads;
+    std::vector<std::string>    _includes;
+    std::vector<std::string>    _excludes;
+    bool                        _archives;
+    std::vector<std::thread>    _threads;
+    std::mutex                  _mtx;
+    std::condition_variable     _cvDirs;
+    std::condition_variable     _cvFiles;
+    std::deque<std::string>     _dirs;          // directories not read yet
+    std::deque<std::string>     _files;         // files found, not returned yet
+    unsigned int                _busy;          // threads reading a directory
+    bool                        _stop;
+    unsigned long long          _nbDirs;
+    unsigned long long          _nbFiles;
+};
+
+#endif
@@ -13,23 +13,61 @@
 #include <unistd.h>
 #include <fcntl.h>
 #include <sys/mman.h>       // for mmap calls
+#include <sys/uio.h>        // for writev
 #include <dirent.h>         // for directory scanning
 #include <iomanip>          // for cout alignement
 #include <chrono>           // for time measurement
 #include <thread>           // for std:thread
 #include <algorithm>        // for strip()
+#include <vector>
+#include <deque>
+#include <atomic>           // for std::atomic
+#include <mutex>
+#include <condition_variable>
+#include <errno.h>
+#include <math.h>           // for ceil()
+#include <signal.h>         // for on-demand reports
 #include "TextTable.h"      // for console table drawing
+#include "BufferRing.h"     // for streaming mode buffers
+#include "BufferPool.h"     // for staging buffers reused across files
+#include "GzipSession.h"    // for session mode
+#include "SwDeflate.h"      // for gzip framing helpers
+#include "BoardScheduler.h" // for multi-board mode
+#include "TreeWalker.h"     // for folder traversal
+#include "Crc32.h"          // for in-process integrity test
+#include "InflateVerifier.h"    // for round-trip integrity test
+#include "CostModel.h"      // for hybrid CPU/FPGA dispatch
+#include "IoRing.h"         // for asynchronous file I/O
+#include "DmaStats.h"       // for transfer histograms
+#include "Metrics.h"        // for the metrics endpoint
+#include "DaemonSocket.h"   // for daemon mode
+#include "DesignCache.h"    // for fast design discovery
+#include "SwInflate.h"      // for decompression mode
+#include "GzipIndex.h"      // for seekable archives
+#include "EntropyScan.h"    // for the incompressible data bypass
+#include <pthread.h>        // for the reporter signal mask
+#include <poll.h>
+#include <sys/socket.h>     // for the daemon connections
+#include <sys/signalfd.h>   // for the daemon stop signals
+#include <sys/eventfd.h>
+#include <set>
 
 /* QuickPlay API library include */
-#include <QpDesign.h>
+#include "QpDevice.h"
 
 #define QAPP_VERSION            "1.1.0"
 
 /* Define accelerator to use */
 #define DEVICE_NAME             "gzip_highcompr_quickapp"
+#ifndef JSON_SEARCH_PATH
 #define JSON_SEARCH_PATH        "/opt/accelize/quickapps/apps/gzip_highCompr/bitstream/"
+#endif
+#ifndef LIC_SEARCH_PATH
 #define LIC_SEARCH_PATH         "/opt/accelize/quickapps/apps/gzip_highCompr/bitstream/"
+#endif
+#ifndef SAMPLE_FILES_PATH
 #define SAMPLE_FILES_PATH       "/opt/accelize/quickapps/apps/gzip_highCompr/applications/sample_files/"
+#endif
 
 #define MAX_FILENAME_SIZE       65536
 #define MIN_FIFO_SIZE           65536
@@ -38,6 +76,42 @@
 #define SIZE_1GB                0x40000000
 #define PCIE_FIFO_SIZE          0x20000000
 #define BW_TEST_ITERATION_CNT   100
+#define STREAM_CHUNK_SIZE       (32*SIZE_1MB)   // default bytes per gzip member in streaming mode
+#define STREAM_IN_SLOTS         3
+#define PIPE_IN_SLOTS           2               // double buffering against qpWriteStream
+#define STREAM_OUT_SLOTS        4
+#define STREAM_OUT_SLOT_SIZE    (4*SIZE_1MB)
+#define BGZF_IN_SLOTS           64              // BGZF mode: blocks in flight through the device
+#define SESSION_MAX_INFLIGHT    8               // files in flight in session mode
+#define SESSION_OUT_MARGIN      SIZE_1KB        // gzip framing room for tiny files
+#define PIPELINE_SLOTS          (SESSION_MAX_INFLIGHT+2)    // + one file staging, one persisting
+#define WALK_THREADS            4               // default folder traversal threads
+#define VERIFY_RATE             100             // default share of archives inflated by integrity tests (%)
+#define SW_FAST_LEVEL           1               // software baseline level matching gzip --fast
+#define SW_BEST_LEVEL           9               // software baseline level matching gzip --best
+#define SW_ALL_LEVELS           0x3FE           // software baseline levels, bit N for level N
+#define CPU_ENGINE_LEVEL        1               // CPU engine level (hybrid mode, fallback), close to the IP ratio
+#define BATCH_SIZE              (4*SIZE_1MB)    // default bytes per batch
+#define BATCH_DEADLINE_MS       50              // default flush deadline of a batch
+#define BATCH_MAX_FILES         4096
+#define BATCH_INFLIGHT          2
+#define BOARD_CHUNK_SIZE        (8*SIZE_1MB)    // large files are spread over the boards by chunks
+#define BOARD_MAX_INFLIGHT      2               // items in flight on each board
+#define PREFETCH_CHUNK_SIZE     (4*SIZE_1MB)    // input read ahead of the device by this granularity
+#define STORE_CHUNK_SIZE        (64*DEFLATE_STORED_MAX) // stored blocks written at once by the entropy bypass
+#define BUFFER_POOL_SIZE        (256*SIZE_1MB)  // default pinned hugepage pool
+#define BENCH_WARMUP            2               // default untimed runs per file in benchmark mode
+#define BENCH_ITERATIONS        10              // default timed runs per file in benchmark mode
+#define BENCH_DEVICE            0               // benchmark stages
+#define BENCH_HOST              1
+#define BENCH_FILE              2
+#define BENCH_NB_STAGES         3
+#define STARTUP_UDID            0               // startup stages
+#define STARTUP_JSON            1
+#define STARTUP_OPEN            2
+#define STARTUP_RESET           3
+#define STARTUP_BOARDS          4
+#define STARTUP_NB_STAGES       5
 
 // Select MODE: SGDMAR or SGDMA
 #define SGDMAR
@@ -55,22 +129,88 @@ long long int   infsize, outfsize, outfsizeMAX;
 /* QuickPlay Device */
 QpDesign dev1;
 
-/* Boolean variable to let HWLogger to exit */
-bool hwLoggerExit = false;
+/* Opened boards, boards[0] is dev1 */
+std::vector<QpDesign *> boards;
+
+/* Background integrity tests, NULL when not testing */
+InflateVerifier *verifier = NULL;
+
+/* No usable design: everything is compressed on the CPU */
+bool cpuFallback = false;
+
+/* Staging buffers, NULL when buffers are mapped for each job */
+BufferPool *bufferPool = NULL;
+
+/* Where the JSON file of each design was found, NULL when not cached */
+DesignCache *designCache = NULL;
+
+/* Let the reporter thread exit */
+std::atomic<bool> reporterExit(false);
+
+/* Entropy pre-scan: inputs written as stored blocks on the host */
+std::atomic<unsigned int>  bypassRegions(0);
+std::atomic<long long int> bypassOutBytes(0);     // stored archive bytes, never read back from the device
 
 string sampleInFolderPath_gzip   = string(SAMPLE_FILES_PATH)+string("gzip_input_files");
 
+typedef struct {
+    int             fd;
+    char            *pBuffer;
+    long long int   size;
+    unsigned int    ioDepth;
+    long long int   ready;          // bytes loaded from the start of the file
+    int             err;
+    std::mutex      mtx;
+    std::condition_variable cv;
+}prefetch_params_t, *PPrefetchParams;
+
 typedef struct {
     QpStream *pStream;
     bool     quiet;
     char     *pBuffer;
+    PPrefetchParams pPrefetch;      // pBuffer is being loaded, NULL when already there
     long long int reqTransfSize;
     long long int realTransfSize;
     double	 bwMeasure;
     double	 elapsedSecs;
     unsigned int loopCnt;
+    int      err;                   // set by the consumer: read error or archive larger than pBuffer
 }thread_params_t, *PThreadParams;
 
+typedef struct {
+    const char      *pBuffer;
+    long long int   size;
+    uint32_t        crc;
+    PPrefetchParams pPrefetch;
+}verify_params_t, *PVerifyParams;
+
+typedef struct {
+    ring_slot_t     *slot;          // input kept for the consumer, NULL when given back
+    bool            stored;         // not sent to the device, stored by the consumer
+}sent_chunk_t;
+
+typedef struct {
+    QpStream        *pStreamIn;
+    QpStream        *pStreamOut;
+    BufferRing      *pInRing;
+    BufferRing      *pOutRing;
+    int             fdIn;
+    int             fdOut;
+    unsigned int    ioDepth;        // transfers in flight on regular files, 0: blocking I/O
+    long long int   inBytes;
+    long long int   outBytes;
+    std::atomic<bool>         inputDone;
+    std::atomic<unsigned int> nbChunks;
+    std::atomic<int>          err;
+    std::vector<long long int> inMembers;     // producer: input bytes of each member
+    std::vector<long long int> outMembers;    // consumer: archive bytes of each member
+    bool                       bgzf;          // members reframed as BGZF blocks
+    bool                       entropyScan;   // incompressible chunks kept off the device
+    std::deque<sent_chunk_t>   sentChunks;    // BGZF or entropy scan: chunks in producer order
+    std::mutex                 sentMtx;
+    std::condition_variable    sentCv;
+}stream_job_t, *PStreamJob;
+
 typedef struct {
     bool    operateOnFolder;
     bool    quiet;
@@ -81,11 +221,49 @@ typedef struct {
     bool    verbose;
     string  path;
     bool 	writeCSV;
+    bool    streamMode;
+    long long int streamChunkSize;
+    bool    toStdout;
+    bool    fromStdin;
+    bool    sessionMode;
+    bool    batchMode;
+    long long int batchSize;
+    unsigned int  batchDeadlineMs;
+    string  batchArchive;
+    unsigned int nbBoards;
+    unsigned int walkThreads;
+    std::vector<string> includes;
+    std::vector<string> excludes;
+    unsigned int verifyRate;
+    unsigned int verifyThreads;
+    unsigned int swLevels;
+    unsigned int swThreads;
+    bool    hybridMode;
+    bool    noFallback;
+    unsigned int ioDepth;
+    unsigned int ioBuffers;
+    long long int poolSize;
+    bool    benchMode;
+    unsigned int benchWarmup;
+    unsigned int benchIterations;
+    bool    dmaStats;
+    string  metrics;            // metrics endpoint, empty for none
+    unsigned int metricsIntervalMs;
+    string  daemonPath;         // daemon mode socket, empty for none
+    string  connectPath;        // client mode: socket of the daemon doing the work
+    string  designCache;        // design discovery cache file, empty for none
+    bool    decompress;         // -d: inflate .gz files on the host
+    bool    indexMode;          // stream mode plus a member index next to the archive
+    long long int extractOffset;    // --extract: range of the original data, -1 for none
+    long long int extractLength;
+    bool    bgzfMode;           // BGZF blocks instead of stream chunks
+    bool    entropyScan;        // incompressible inputs stored on the host
 } gzip_args_t;
 
 typedef struct {
     std::string     filename;           //table: filename
     std::string     comprResult;        //table: result
+    std::string     engine;             //table: engine that compressed the file
 
     double          hwBwMBps;           //table: BC: HW Gzip
     double          swBwFastMBps;       //table: BC: SW Gzip --fast
@@ -98,8 +276,90 @@ typedef struct {
     double          swComprBestRatio;   //table: CC: SW Gzip --best
     double          comprFastGain;      //table: CC: Gain vs SW Gzip --fast
     double          comprBestGain;      //table: CC: Gain vs SW Gzip --fast
+
+    long long int   swInSize;           //table: SW baseline, per level (0: not run)
+    long long int   swOutSize[10];
+    double          swSecs[10];         //  one thread
+    double          swMtSecs[10];       //  swThreads threads
 } file_results_t;
 
+typedef struct {
+    session_job_t   job;
+    char            *inBuffer;
+    long long int   inCapacity;
+    char            *outBuffer;
+    long long int   outCapacity;
+    string          in_filename;
+    string          out_filename;
+    file_results_t  *res;
+    uint32_t        crc;            // of the input, for the integrity test
+    int             *check;         // integrity test result
+    double          estSecs;        // hybrid mode: expected compression time
+} session_slot_t;
+
+typedef struct {
+    int                 sock;           // client connection, answered when done
+    int                 fdIn;
+    int                 fdOut;
+    daemon_request_t    req;
+} daemon_job_t;
+
+typedef struct {
+    gzip_args_t                 *pArgs;
+    std::deque<daemon_job_t>    queue;          // arrival order
+    std::vector<int>            replied;        // connections to poll again
+    bool                        stop;
+    unsigned int                served;
+    int                         wakeFd;         // eventfd, a reply went out
+    std::mutex                  mtx;
+    std::condition_variable     cv;
+} daemon_state_t, *PDaemonState;
+
+typedef struct {
+    std::vector<double> secs;           // one sample per timed run of a file
+    long long int       bytes;          // input bytes over all samples
+} bench_samples_t;
+
+typedef struct {
+    GzipSession                 *pSession;
+    TreeWalker                  *pWalker;
+    gzip_args_t                 *pArgs;
+    std::deque<string>          files;          // files staged, in order
+    std::deque<file_results_t>  results;
+    std::deque<int>             checks;         // integrity test of each file
+    std::vector<session_slot_t *> freeSlots;
+    std::mutex                  mtx;
+    std::condition_variable     cv;
+    unsigned int                submitted;      // files handed to the session
+    unsigned int                persisted;      // files written out
+    bool                        stageDone;
+    long long int               totalIn;
+    long long int               totalOut;
+    std::atomic<int>            err;
+    CostModel                   *pCostModel;    // hybrid mode only
+    std::deque<session_slot_t *> cpuQueue;      // files routed to the CPU engine
+    unsigned int                nbCpuWorkers;
+    unsigned int                cpuDone;        // files compressed and written out by the CPU engine
+    double                      fpgaBacklogSecs;    // expected work queued on each engine
+    double                      cpuBacklogSecs;
+    unsigned int                routed[COST_NB_ENGINES][COST_NB_BUCKETS];
+    std::chrono::time_point<std::chrono::steady_clock> lastFpgaComplete;
+}pipeline_job_t, *PPipelineJob;
+
+typedef struct {
+    session_job_t                   job;
+    char                            *inBuffer;
+    long long int                   inCapacity;
+    char                            *outBuffer;
+    long long int                   outCapacity;
+    std::vector<long long int>      partIn;
+    std::vector<long long int>      partOut;
+    std::vector<uint32_t>           partCrc;        // for the integrity test
+    std::vector<string>             files;
+    std::vector<file_results_t *>   res;
+    std::chrono::time_point<std::chrono::steady_clock> openTime;
+} batch_slot_t;
+
 /**
  *  getFileSize
  */
@@ -141,7 +401,7 @@ string getFileSizeStr(string filePath)
 /**
  *  getBandwidthMBps
  */
-double getBandwidthMBps(chrono::time_point<chrono::system_clock> start, chrono::time_point<chrono::system_clock> end, long long int nbBytes)
+double getBandwidthMBps(chrono::time_point<chrono::steady_clock> start, chrono::time_point<chrono::steady_clock> end, long long int nbBytes)
 {
     std::chrono::duration<double> elapsed_seconds = end-start;
     return nbBytes/elapsed_seconds.count()/SIZE_1MB;
@@ -150,7 +410,7 @@ double getBandwidthMBps(chrono::time_point<chrono::system_clock> start, chrono::
 /**
  *  getElapsedSecs
  */
-double getElapsedSecs(chrono::time_point<chrono::system_clock> start, chrono::time_point<chrono::system_clock> end)
+double getElapsedSecs(chrono::time_point<chrono::steady_clock> start, chrono::time_point<chrono::steady_clock> end)
 {
     std::chrono::duration<double> elapsed_seconds = end-start;
     return elapsed_seconds.count();
@@ -191,6 +451,7 @@ void display_result_table(file_results_t* resTable, unsigned int nbFiles)
     tableBw.setTitle("BANDWIDTH COMPARISON (units are MB/s)");
     tableBw.add( "Filename" );
     tableBw.add( "Result" );
+    tableBw.add( "Engine" );
     tableBw.add( "HW" );
     tableBw.add( "SW --fast" );
     tableBw.add( "SW --best" );
@@ -200,6 +461,7 @@ void display_result_table(file_results_t* resTable, unsigned int nbFiles)
     for(unsigned int i=0; i<nbFiles; i++) {
         tableBw.add( resTable[i].filename );
         tableBw.add( resTable[i].comprResult );
+        tableBw.add( resTable[i].engine );
         tableBw.add( resTable[i].hwBwMBps );
         tableBw.add( resTable[i].swBwFastMBps );
         tableBw.add( resTable[i].swBwBestMBps );
@@ -207,7 +469,7 @@ void display_result_table(file_results_t* resTable, unsigned int nbFiles)
         tableBw.add( resTable[i].bwBestGain );
         tableBw.endOfRow();
     }
-    tableBw.setAlignment( 2, TextTable::Alignment::LEFT );
+    tableBw.setAlignment( 3, TextTable::Alignment::LEFT );
     std::cout << "\n" << tableBw;
 
     // Compression Comparison Table
@@ -233,6 +495,41 @@ void display_result_table(file_results_t* resTable, unsigned int nbFiles)
     }
     tableCompr.setAlignment( 2, TextTable::Alignment::LEFT );
     std::cout << "\n" << tableCompr;
+
+    // Software Baseline Table, all files together
+    TextTable tableSw( '-', '|', '+' );
+    tableSw.setTitle("SOFTWARE BASELINE (in-memory zlib deflate, all files)");
+    tableSw.add( "Level" );
+    tableSw.add( "Ratio" );
+    tableSw.add( "MB/s (1 thread)" );
+    tableSw.add( "MB/s (threads)" );
+    tableSw.add( "HW Gain (vs threads)" );
+    tableSw.endOfRow();
+    bool swBaseline = false;
+    for(int level=1; level<=9; level++) {
+        long long int inSize=0, outSize=0;
+        double secs=0.0, mtSecs=0.0, hwSecs=0.0;
+        for(unsigned int i=0; i<nbFiles; i++) {
+            if(!resTable[i].swInSize || !resTable[i].swOutSize[level])
+                continue;
+            inSize  += resTable[i].swInSize;
+            outSize += resTable[i].swOutSize[level];
+            secs    += resTable[i].swSecs[level];
+            mtSecs  += resTable[i].swMtSecs[level];
+            hwSecs  += resTable[i].hwBwMBps > 0.0 ? resTable[i].swInSize/(resTable[i].hwBwMBps*SIZE_1MB) : 0.0;
+        }
+        if(!outSize)
+            continue;
+        swBaseline = true;
+        tableSw.add( std::to_string(level) );
+        tableSw.add( (double)inSize/outSize );
+        tableSw.add( secs > 0.0 ? inSize/secs/SIZE_1MB : -1.0 );
+        tableSw.add( mtSecs > 0.0 ? inSize/mtSecs/SIZE_1MB : -1.0 );
+        tableSw.add( hwSecs > 0.0 ? mtSecs/hwSecs : -1.0 );
+        tableSw.endOfRow();
+    }
+    if(swBaseline)
+        std::cout << "\n" << tableSw;
     
 
     // Compute Average and Max Throughput
@@ -246,6 +543,45 @@ void display_result_table(file_results_t* resTable, unsigned int nbFiles)
     std::cout << "Maximal Throughput " << (mxBwMBps) << " MB/s" << std::endl;
 }
 
+/**
+ *  Print decompression results: output MB/s against single-threaded zlib,
+ *  as gunzip runs
+ */
+void display_decompress_table(file_results_t* resTable, unsigned int nbFiles)
+{
+    TextTable tableInf( '-', '|', '+' );
+    tableInf.setTitle("DECOMPRESSION BANDWIDTH (units are MB/s of output)");
+    tableInf.add( "Filename" );
+    tableInf.add( "Result" );
+    tableInf.add( "Engine" );
+    tableInf.add( "Parallel" );
+    tableInf.add( "SW 1 thread" );
+    tableInf.add( "Gain" );
+    tableInf.add( "Ratio" );
+    tableInf.endOfRow();
+    for(unsigned int i=0; i<nbFiles; i++) {
+        tableInf.add( resTable[i].filename );
+        tableInf.add( resTable[i].comprResult );
+        tableInf.add( resTable[i].engine );
+        tableInf.add( resTable[i].hwBwMBps );
+        tableInf.add( resTable[i].swBwFastMBps );
+        tableInf.add( resTable[i].bwFastGain );
+        tableInf.add( resTable[i].hwComprRatio );
+        tableInf.endOfRow();
+    }
+    tableInf.setAlignment( 3, TextTable::Alignment::LEFT );
+    std::cout << "\n" << tableInf;
+
+    double avBwMBps=0.0, mxBwMBps=0.0;
+    for(unsigned int i=0; i<nbFiles; i++) {
+        avBwMBps += resTable[i].hwBwMBps;
+        if(resTable[i].hwBwMBps>mxBwMBps) mxBwMBps=resTable[i].hwBwMBps;
+    }
+    avBwMBps /= nbFiles;
+    std::cout << "Average Throughput " << (avBwMBps) << " MB/s" << std::endl;
+    std::cout << "Maximal Throughput " << (mxBwMBps) << " MB/s" << std::endl;
+}
+
 /**
  *  Save results in CSV file
  */
@@ -379,6 +715,92 @@ int isLicenseFile(string path)
     return false;
 }
 
+/**
+ *  Prefetch Thread: load a file into a buffer, ioDepth reads in flight.
+ *  Readers follow the loaded part with wait_prefetched().
+ */
+void tPrefetch_input(PPrefetchParams pPrefetch)
+{
+    IoRing ring(pPrefetch->ioDepth);
+    ring.registerBuffer(pPrefetch->pBuffer, pPrefetch->size);
+
+    long long int nbChunks = (pPrefetch->size + PREFETCH_CHUNK_SIZE-1) / PREFETCH_CHUNK_SIZE;
+    std::vector<bool> loaded(nbChunks, false);
+    long long int next = 0, ready = 0;
+    int err = 0;
+
+    while(true) {
+        while(!err && next < nbChunks && ring.inflight() < ring.depth()) {
+            long long int offset = next*PREFETCH_CHUNK_SIZE;
+            long long int size = std::min((long long int)PREFETCH_CHUNK_SIZE, pPrefetch->size-offset);
+            if(ring.submitRead(pPrefetch->fd, &pPrefetch->pBuffer[offset], size, offset, (void *)(intptr_t)next)) {
+                err = -1;
+                break;
+            }
+            next++;
+        }
+        if(!ring.inflight())
+            break;
+
+        void *user;
+        long long int res;
+        if(ring.wait(user, res)) {
+            err = -1;
+            break;
+        }
+        long long int chunk = (intptr_t)user;
+        long long int expected = std::min((long long int)PREFETCH_CHUNK_SIZE, pPrefetch->size-chunk*PREFETCH_CHUNK_SIZE);
+        if(res != expected) {
+            err = -1;
+            continue;
+        }
+        loaded[chunk] = true;
+        while(ready < nbChunks && loaded[ready])
+            ready++;
+
+        std::lock_guard<std::mutex> lock(pPrefetch->mtx);
+        pPrefetch->ready = std::min(ready*PREFETCH_CHUNK_SIZE, pPrefetch->size);
+        pPrefetch->cv.notify_all();
+    }
+
+    std::lock_guard<std::mutex> lock(pPrefetch->mtx);
+    pPrefetch->err = err;
+    pPrefetch->cv.notify_all();
+}
+
+/**
+ *  Wait until at least size bytes are loaded, returns the bytes loaded. On
+ *  a read error the whole buffer is reported, so the device still gets its
+ *  EOP: the caller checks err once the run is over.
+ */
+long long int wait_prefetched(PPrefetchParams pPrefetch, long long int size)
+{
+    std::unique_lock<std::mutex> lock(pPrefetch->mtx);
+    pPrefetch->cv.wait(lock, [pPrefetch, size]{ return pPrefetch->err || pPrefetch->ready >= size; });
+    return pPrefetch->err ? pPrefetch->size : pPrefetch->ready;
+}
+
+/**
+ *  Verifier Thread: CRC32 of the input, computed while it is being sent
+ */
+void tVerifier_crc(PVerifyParams pVerifyParams)
+{
+    if(!pVerifyParams->pPrefetch) {
+        pVerifyParams->crc = crc32_fast(0, pVerifyParams->pBuffer, pVerifyParams->size);
+        return;
+    }
+
+    // Follow the input as it is loaded
+    uint32_t crc = 0;
+    long long int done = 0;
+    while(done < pVerifyParams->size) {
+        long long int ready = wait_prefetched(pVerifyParams->pPrefetch, done+1);
+        crc = crc32_fast(crc, &pVerifyParams->pBuffer[done], ready-done);
+        done = ready;
+    }
+    pVerifyParams->crc = crc;
+}
+
 /**
  * Producer SGDMAR thread
  */
@@ -395,21 +817,29 @@ void tProducer_SGDMAR(PThreadParams pThreadParams)
         return;
     }
 
-    std::chrono::time_point<std::chrono::system_clock> start = chrono::system_clock::now();
+    std::chrono::time_point<std::chrono::steady_clock> start = chrono::steady_clock::now();
     for(unsigned int i=0; i< pThreadParams->loopCnt; i++) {
         pThreadParams->realTransfSize=0;
         while(pThreadParams->realTransfSize < pThreadParams->reqTransfSize) {
-            if((pThreadParams->reqTransfSize-pThreadParams->realTransfSize) >= RW_SIZE_LIMIT) {
-                dev1.qpWriteStream(*pThreadParams->pStream, &pThreadParams->pBuffer[pThreadParams->realTransfSize], RW_SIZE_LIMIT, false);
+            // Input still being loaded: send what is there, EOP with the last bytes
+            long long int ready = pThreadParams->reqTransfSize;
+            if(pThreadParams->pPrefetch)
+                ready = wait_prefetched(pThreadParams->pPrefetch, pThreadParams->realTransfSize+1);
+            if((ready-pThreadParams->realTransfSize) >= RW_SIZE_LIMIT) {
+                dma_write_stream(dev1, *pThreadParams->pStream, &pThreadParams->pBuffer[pThreadParams->realTransfSize], RW_SIZE_LIMIT, false);
                 pThreadParams->realTransfSize += RW_SIZE_LIMIT;
             }
+            else if(ready < pThreadParams->reqTransfSize) {
+                dma_write_stream(dev1, *pThreadParams->pStream, &pThreadParams->pBuffer[pThreadParams->realTransfSize], (unsigned int)(ready-pThreadParams->realTransfSize), false);
+                pThreadParams->realTransfSize = ready;
+            }
             else {
-                dev1.qpWriteStream(*pThreadParams->pStream, &pThreadParams->pBuffer[pThreadParams->realTransfSize], (unsigned int)(pThreadParams->reqTransfSize-pThreadParams->realTransfSize), true);
+                dma_write_stream(dev1, *pThreadParams->pStream, &pThreadParams->pBuffer[pThreadParams->realTransfSize], (unsigned int)(pThreadParams->reqTransfSize-pThreadParams->realTransfSize), true);
                 pThreadParams->realTransfSize=pThreadParams->reqTransfSize;
             }
         }
     }
-    std::chrono::time_point<std::chrono::system_clock> end = std::chrono::system_clock::now();
+    std::chrono::time_point<std::chrono::steady_clock> end = std::chrono::steady_clock::now();
 
     pThreadParams->bwMeasure = getBandwidthMBps(start, end, pThreadParams->realTransfSize);
     pThreadParams->elapsedSecs = getElapsedSecs(start, end);
@@ -433,21 +863,37 @@ void tConsumer_SGDMAR(PThreadParams pThreadParams)
         return;
     }
     
-    std::chrono::time_point<std::chrono::system_clock> start = chrono::system_clock::now();  
+    // Reads never go past reqTransfSize: the rest of an archive that does
+    // not fit is drained to a scratch buffer, so the device still gets to EOP
+    std::vector<char> scratch;
+    bool overflow = false;
+    std::chrono::time_point<std::chrono::steady_clock> start = chrono::steady_clock::now();  
     for(unsigned int i=0; i< pThreadParams->loopCnt; i++) { 
         pThreadParams->realTransfSize=0;
         eop = false;
         while(!eop && !err) {
-            err = dev1.qpReadStream(*pThreadParams->pStream, &pThreadParams->pBuffer[pThreadParams->realTransfSize], RW_SIZE_LIMIT, eop, readBytes);
-            pThreadParams->realTransfSize += readBytes;
+            long long int room = pThreadParams->reqTransfSize - pThreadParams->realTransfSize;
+            if(room > 0) {
+                unsigned int size = (room < RW_SIZE_LIMIT) ? (unsigned int)room : RW_SIZE_LIMIT;
+                err = dma_read_stream(dev1, *pThreadParams->pStream, &pThreadParams->pBuffer[pThreadParams->realTransfSize], size, eop, readBytes);
+                pThreadParams->realTransfSize += readBytes;
+            }
+            else {
+                scratch.resize(SIZE_1MB);
+                overflow = true;
+                err = dma_read_stream(dev1, *pThreadParams->pStream, &scratch[0], SIZE_1MB, eop, readBytes);
+            }
         }
         outfsize = pThreadParams->realTransfSize;
     }
 
-    std::chrono::time_point<std::chrono::system_clock> end = std::chrono::system_clock::now();
+    std::chrono::time_point<std::chrono::steady_clock> end = std::chrono::steady_clock::now();
 
     if(err)
         std::cerr << KRED << "Data Read from FPGA error. File content could be incorrect" << KNRM << std::endl;
+    else if(overflow)
+        std::cerr << KRED << "Archive larger than its " << pThreadParams->reqTransfSize << " bytes output buffer" << KNRM << std::endl;
+    pThreadParams->err = (err || overflow) ? -1 : 0;
 
     pThreadParams->bwMeasure = getBandwidthMBps(start, end, pThreadParams->realTransfSize);
     pThreadParams->elapsedSecs = getElapsedSecs(start, end);
@@ -477,24 +923,28 @@ void tProducer_SGDMA(PThreadParams pThreadParams)
     // Define chunckSize
     long long int chunckSize = pThreadParams->reqTransfSize<PCIE_FIFO_SIZE?pThreadParams->reqTransfSize:PCIE_FIFO_SIZE;
 
-    std::chrono::time_point<std::chrono::system_clock> start = chrono::system_clock::now();
+    // Input still being loaded: the FIFO copies do not follow it
+    if(pThreadParams->pPrefetch)
+        wait_prefetched(pThreadParams->pPrefetch, pThreadParams->reqTransfSize);
+
+    std::chrono::time_point<std::chrono::steady_clock> start = chrono::steady_clock::now();
     int err=0;
     for(unsigned int i=0; i< pThreadParams->loopCnt; i++) {
         pThreadParams->realTransfSize=0;
         while(pThreadParams->realTransfSize < pThreadParams->reqTransfSize) {
             if((pThreadParams->reqTransfSize-pThreadParams->realTransfSize) > chunckSize) {
                 memcpy(pBuffer, &pThreadParams->pBuffer[pThreadParams->realTransfSize], chunckSize);
-                err = dev1.qpWriteStream(*pThreadParams->pStream, NULL, chunckSize, false);
+                err = dma_write_stream(dev1, *pThreadParams->pStream, NULL, chunckSize, false);
                 pThreadParams->realTransfSize += chunckSize;
             }
             else {
                 memcpy(pBuffer, &pThreadParams->pBuffer[pThreadParams->realTransfSize], (unsigned int)(pThreadParams->reqTransfSize-pThreadParams->realTransfSize));
-                err = dev1.qpWriteStream(*pThreadParams->pStream, NULL, (unsigned int)(pThreadParams->reqTransfSize-pThreadParams->realTransfSize), true);
+                err = dma_write_stream(dev1, *pThreadParams->pStream, NULL, (unsigned int)(pThreadParams->reqTransfSize-pThreadParams->realTransfSize), true);
                 pThreadParams->realTransfSize=pThreadParams->reqTransfSize;
             }
         }
     }
-    std::chrono::time_point<std::chrono::system_clock> end = std::chrono::system_clock::now();
+    std::chrono::time_point<std::chrono::steady_clock> end = std::chrono::steady_clock::now();
 
     pThreadParams->bwMeasure = getBandwidthMBps(start, end, pThreadParams->realTransfSize*pThreadParams->loopCnt);
     pThreadParams->elapsedSecs = getElapsedSecs(start, end);
@@ -526,7 +976,7 @@ void tConsumer_SGDMA(PThreadParams pThreadParams)
     long long int chunckSize = pThreadParams->reqTransfSize<PCIE_FIFO_SIZE?pThreadParams->reqTransfSize:PCIE_FIFO_SIZE;
     pThreadParams->realTransfSize=0;
 
-    std::chrono::time_point<std::chrono::system_clock> start = chrono::system_clock::now();    
+    std::chrono::time_point<std::chrono::steady_clock> start = chrono::steady_clock::now();    
     for(unsigned int i=0; i< pThreadParams->loopCnt; i++) {
         eop = false;
         pThreadParams->realTransfSize=0;
@@ -535,7 +985,7 @@ void tConsumer_SGDMA(PThreadParams pThreadParams)
            
             // FPGA READ
             std::cout << KRED << "starting qpReadStream => i=" << i << KNRM << std::endl;
-            err = dev1.qpReadStream(*pThreadParams->pStream, NULL, chunckSize, eop, readBytes);
+            err = dma_read_stream(dev1, *pThreadParams->pStream, NULL, chunckSize, eop, readBytes);
             std::cout << KRED << "qpReadStream => i=" << i << " - Byte rx = " << readBytes << " eop = " << (int)eop << KNRM << std::endl;
 #if 1
             memcpy(&pThreadParams->pBuffer[pThreadParams->realTransfSize], pBuffer, readBytes);          
@@ -582,7 +1032,7 @@ void tConsumer_SGDMA(PThreadParams pThreadParams)
             std::cout << KRED << "Data Read from FPGA error. File content could be incorrect" << KNRM << std::endl;
         }*/
     }             
-    std::chrono::time_point<std::chrono::system_clock> end = std::chrono::system_clock::now();
+    std::chrono::time_point<std::chrono::steady_clock> end = std::chrono::steady_clock::now();
     
     pThreadParams->bwMeasure = getBandwidthMBps(start, end, pThreadParams->realTransfSize*pThreadParams->loopCnt);
     pThreadParams->elapsedSecs = getElapsedSecs(start, end);
@@ -590,475 +1040,3431 @@ void tConsumer_SGDMA(PThreadParams pThreadParams)
 #endif
 
 /**
- * HwLogger thread
+ *  count_bypassed: an input, or a region of it, stored on the host
  */
-void* tHwLogger()
+void count_bypassed(long long int inSize, long long int outSize, unsigned int regions=1)
 {
-	/* Press 'p' to print hardware information on the console */
-	while(!hwLoggerExit) {
-		char buf[256];
-		fcntl(0, F_SETFL, fcntl(0, F_GETFL) | O_NONBLOCK);
-		sleep(1);
-		if(read(0,buf,256)> 0 && buf[0]=='p') {
-			dev1.qpPrintHwReport(std::cout, "file_in");
-            dev1.qpPrintHwReport(std::cout, "archive_out");
-        }
-	}
-
-	return NULL;
+    metrics_add(METRIC_BYTES_STORED, inSize);
+    bypassRegions += regions;
+    bypassOutBytes += outSize;
 }
 
 /**
- *  compare_md5sum
+ *  Print what the entropy pre-scan kept off the device: the stored input
+ *  never went to the device and its archive never came back
  */
-int compare_md5sum(string filename1, string filename2)
+void show_entropy_bypass(void)
 {
-	// if files does not exist
-	struct stat buf;
-	if (stat(filename1.c_str(), &buf) != 0)
-		return -1;
-	if (stat(filename2.c_str(), &buf) != 0)
-		return -1;
+    unsigned long long int inBytes = metrics_counter(METRIC_BYTES_STORED);
+    unsigned long long int total = metrics_counter(METRIC_BYTES_IN);
+    std::cout << KBLU << "Entropy pre-scan: " << bypassRegions << " incompressible input(s) or chunk(s), "
+              << (double)inBytes/SIZE_1MB << " MB stored on the host (" << (total ? 100.0*inBytes/total : 0.0) << "% of the input)";
+    if(!cpuFallback)
+        std::cout << ", " << (double)(inBytes + bypassOutBytes)/SIZE_1MB << " MB of device transfers saved";
+    std::cout << KNRM << std::endl;
+}
 
-	// Get md5sum values
-	FILE *in1, *in2;
-	char buff1[512], buff2[512];
-    string cmd1 = "md5sum " + filename1;
-    string cmd2 = "md5sum " + filename2;
+/**
+ * Streaming mode threads (SGDMAR)
+ *
+ * Input is read chunk by chunk into inRing, each chunk is sent to the device
+ * as one EOP packet and comes back as one gzip member. Output is drained from
+ * archive_out into outRing and written to disk as it arrives, so memory use
+ * only depends on the ring sizes. Chunks the entropy pre-scan finds
+ * incompressible skip the device: the consumer writes them out as stored
+ * members in their turn.
+ */
+#ifdef SGDMAR
+/**
+ *  Positioned asynchronous I/O is only used on regular files, where the
+ *  stream offset is known and writes may complete out of order
+ */
+long long int stream_io_offset(int fd, unsigned int ioDepth)
+{
+    struct stat st;
+    if(!ioDepth || fstat(fd, &st) || !S_ISREG(st.st_mode) || (fcntl(fd, F_GETFL) & O_APPEND))
+        return -1;
+    return lseek(fd, 0, SEEK_CUR);
+}
 
-	if(!(in1 = popen(cmd1.c_str(), "r")))
-		return -2;
-	
-	fgets(buff1, sizeof(buff1), in1);
-	pclose(in1);
+/**
+ *  Fail a streaming job: the rings are closed so no thread waits for a slot,
+ *  and the device streams so a blocked transfer returns. The first error
+ *  code is kept.
+ */
+void abort_stream_job(PStreamJob pJob, int err)
+{
+    {
+        std::lock_guard<std::mutex> lock(pJob->sentMtx);
+        if(!pJob->err)
+            pJob->err = err;
+        pJob->sentCv.notify_all();
+    }
+    pJob->pInRing->close();
+    pJob->pOutRing->close();
+    dev1.qpCloseStream(*pJob->pStreamIn);
+    dev1.qpCloseStream(*pJob->pStreamOut);
+}
 
-	if(!(in2 = popen(cmd2.c_str(), "r")))
-		return -2;
-	
-	fgets(buff2, sizeof(buff2), in2);
-	pclose(in2);
+/**
+ * Stream Reader thread, regular files: chunks are read ahead into inRing
+ * with ioDepth reads in flight, and published in file order as they land
+ */
+void tReaderRing_stream(PStreamJob pJob, long long int offset)
+{
+    IoRing ring(pJob->ioDepth);
+    ring.registerBuffer(pJob->pInRing->memory(), pJob->pInRing->memorySize());
 
-	// Compare values
-	if( strncmp(buff1, buff2, 32) !=0)
-		return -3;
+    struct stat st;
+    fstat(pJob->fdIn, &st);
+    long long int next = offset, end = st.st_size;
+    std::deque< std::pair<ring_slot_t *, bool> > pending;  // slots being read, in file order
+    unsigned int published = 0;
+
+    while(true) {
+        while(!pJob->err && next < end && ring.inflight() < ring.depth()) {
+            ring_slot_t *slot = ring.inflight() ? pJob->pInRing->tryGetFree() : pJob->pInRing->getFree();
+            if(!slot)
+                break;
+            slot->used = (size_t)std::min((long long int)slot->size, end-next);
+            if(ring.submitRead(pJob->fdIn, slot->data, slot->used, next, slot)) {
+                std::cerr << KRED << "tReader_stream: read submission error" << KNRM << std::endl;
+                abort_stream_job(pJob, -1);
+                pJob->pInRing->putFree(slot);
+                break;
+            }
+            pending.push_back(std::make_pair(slot, false));
+            next += slot->used;
+        }
+        if(!ring.inflight())
+            break;
+
+        void *user;
+        long long int res;
+        if(ring.wait(user, res)) {
+            std::cerr << KRED << "tReader_stream: read completion error" << KNRM << std::endl;
+            abort_stream_job(pJob, -1);
+            break;
+        }
+        ring_slot_t *slot = (ring_slot_t *)user;
+        if(res != (long long int)slot->used) {
+            std::cerr << KRED << "tReader_stream: read error (" << (res < 0 ? strerror(-res) : "file truncated") << ")" << KNRM << std::endl;
+            abort_stream_job(pJob, -1);
+            continue;
+        }
+        pJob->inBytes += res;
+        for(size_t i=0; i<pending.size(); i++)
+            if(pending[i].first == slot)
+                pending[i].second = true;
+
+        // The last chunk is held back until the chunk count is known
+        while(!pending.empty() && pending.front().second && !(next >= end && pending.size() == 1)) {
+            pJob->pInRing->putFilled(pending.front().first);
+            pending.pop_front();
+            published++;
+        }
+    }
 
-	return 0;
+    ring_slot_t *last = NULL;
+    if(!pJob->err && pending.size() == 1 && pending.front().second) {
+        last = pending.front().first;
+        pending.pop_front();
+    }
+    for(size_t i=0; i<pending.size(); i++)
+        pJob->pInRing->putFree(pending[i].first);
+
+    // Empty input still produces one (empty) gzip member. No slot once the
+    // job was aborted.
+    if(!last)
+        last = pJob->pInRing->getFree();
+    pJob->nbChunks = published+1;
+    pJob->inputDone = true;
+    if(last) {
+        last->last = true;
+        pJob->pInRing->putFilled(last);
+    }
+    pJob->pInRing->close();
 }
 
 /**
- *  checkArchive
+ * Stream Reader thread: input file -> inRing
  */
-int checkArchive(string inFile, string outFile, bool verbose)
+void tReader_stream(PStreamJob pJob)
 {
-    if(verbose)
-        std::cout << KBLU << "Checking Archive " << outFile << " ..." << KNRM << std::endl;
-
-    // if files does not exist
-	struct stat buf;
-	if (stat(inFile.c_str(), &buf) != 0) {
-        std::cerr << KRED << "Error: Unable to open file [" << inFile << "]" << KNRM << std::endl;
-		return -1;
-	}
-	if (stat(outFile.c_str(), &buf) != 0) {
-        std::cerr << KRED << "Error: Unable to open file [" << outFile << "]" << KNRM << std::endl;
-		return -1;
-	}
+    ring_slot_t *pending = NULL;
+    unsigned int published = 0;
 
-    // Extract archive
-    string extrFile = "/var/tmp/" + basename(inFile);
-    FILE *in;
-    string cmd = "gunzip -c " + outFile + " > " + extrFile + " 2> /dev/null";;
-    if(!(in = popen(cmd.c_str(), "r"))){
-		return -2;
-	}
-	pclose(in);
+    long long int offset = stream_io_offset(pJob->fdIn, pJob->ioDepth);
+    if(offset >= 0) {
+        tReaderRing_stream(pJob, offset);
+        return;
+    }
 
-    // Compare md5sum
-    int retCode = compare_md5sum(inFile, extrFile);
+    while(!pJob->err) {
+        ring_slot_t *slot = pJob->pInRing->getFree();
+        if(!slot)
+            break;
+
+        // Fill the whole slot, pipes may return short reads. A chunk is only
+        // published once more data shows up behind it, so it is known whether
+        // it is the last one and the consumer can tell when the final member
+        // went through. Publishing on the first byte keeps the device busy
+        // while the next chunk is being read (double buffering).
+        while(slot->used < slot->size) {
+            ssize_t ret = read(pJob->fdIn, &slot->data[slot->used], slot->size-slot->used);
+            if(ret < 0 && errno == EINTR)
+                continue;
+            if(ret < 0) {
+                std::cerr << KRED << "tReader_stream: read error (" << strerror(errno) << ")" << KNRM << std::endl;
+                abort_stream_job(pJob, -1);
+                break;
+            }
+            if(ret == 0)
+                break;
+            slot->used += ret;
+            pJob->inBytes += ret;
+            if(pending) {
+                pJob->pInRing->putFilled(pending);
+                published++;
+                pending = NULL;
+            }
+        }
 
-    // Clean Generated File
-    cmd = "rm -f " + extrFile;
-    in = popen(cmd.c_str(), "r");
-    pclose(in);
+        if(slot->used == 0) {
+            pJob->pInRing->putFree(slot);
+            break;
+        }
+        pending = slot;
+        if(slot->used < slot->size)
+            break;
+    }
 
-    return retCode;
+    // Empty input still produces one (empty) gzip member. No slot once the
+    // job was aborted.
+    if(!pending)
+        pending = pJob->pInRing->getFree();
+    pJob->nbChunks = published+1;
+    pJob->inputDone = true;
+    if(pending) {
+        pending->last = true;
+        pJob->pInRing->putFilled(pending);
+    }
+    pJob->pInRing->close();
 }
 
 /**
- *  Display Application Configuration
+ * Stream Producer thread: inRing -> file_in
  */
-void show_appconfig(gzip_args_t args)
+void tProducer_stream(PStreamJob pJob)
 {
-    std::cout << KBLU << "Target:           " << (args.operateOnFolder?string("Folder"):string("File")) << KNRM << std::endl;
-    std::cout << KBLU << "Quiet:            " << (args.quiet?string("Yes"):string("No")) << KNRM << std::endl;
-    std::cout << KBLU << "verifyIntegrity:  " << (args.verifyIntegrity?string("Yes"):string("No")) << KNRM << std::endl;
-    std::cout << KBLU << "OScompare:        " << (args.OScompare?string("Yes"):string("No")) << KNRM << std::endl;
-    std::cout << KBLU << "DemoMode:         " << (args.demoMode?string("Enabled"):string("Disabled")) << KNRM << std::endl;  
-    std::cout << KBLU << "Path :            "  << args.path << KNRM << std::endl;
+    ring_slot_t *slot;
+    while(!pJob->err && (slot = pJob->pInRing->getFilled()) != NULL) {
+        sent_chunk_t chunk;
+        entropy_stats_t stats;
+        chunk.stored = pJob->entropyScan && entropy_scan(slot->data, slot->used, stats);
+        chunk.slot = (pJob->bgzf || chunk.stored) ? slot : NULL;
+        pJob->inMembers.push_back(slot->used);
+        if(pJob->bgzf || pJob->entropyScan) {
+            // Queued before the transfer, the consumer takes the members in
+            // this order. The slot is kept unless the consumer already gave up.
+            std::lock_guard<std::mutex> lock(pJob->sentMtx);
+            if(pJob->err)
+                chunk.slot = NULL;
+            pJob->sentChunks.push_back(chunk);
+            pJob->sentCv.notify_all();
+        }
+
+        long long int sent = 0;
+        if(!chunk.stored) {
+            metrics_gauge_add(METRIC_QUEUE_DEPTH, 1);
+            do {
+                long long int remaining = (long long int)slot->used - sent;
+                bool eop = (remaining <= RW_SIZE_LIMIT);
+                unsigned int size = eop ? (unsigned int)remaining : RW_SIZE_LIMIT;
+                if(dma_write_stream(dev1, *pJob->pStreamIn, &slot->data[sent], size, eop)) {
+                    if(!pJob->err)
+                        std::cerr << KRED << "tProducer_stream: Data Write to FPGA error" << KNRM << std::endl;
+                    abort_stream_job(pJob, -1);
+                }
+                sent += size;
+            } while(!pJob->err && sent < (long long int)slot->used);
+        }
+        if(!chunk.slot)
+            pJob->pInRing->putFree(slot);
+    }
 }
 
 /**
- *  Display Starting Splashscreeen
+ *  Next chunk in producer order, false once the job failed
  */
-void show_start_splashscreen(void)
+bool pop_sent_chunk(PStreamJob pJob, sent_chunk_t & chunk)
 {
-    std::cout << KCYN << "  ------------------------------------------------------------------------------------ " << KNRM << std::endl;
-    std::cout << KCYN << " |                                                                                    |" << KNRM << std::endl;
-    std::cout << KCYN << " |        GZIP FPGA Accelerator Powered by Accelize & CAST GZip IP                    |" << KNRM << std::endl;
-    std::cout << KCYN << " |          Designed with QuickPlay, Protected by Algodone Embedded DRM               |" << KNRM << std::endl;
-    std::cout << KCYN << " |                                                                                    |" << KNRM << std::endl;
-    std::cout << KCYN << "  ------------------------------------------------------------------------------------ " << KNRM << std::endl;
-    std::cout << std::endl;
+    std::unique_lock<std::mutex> lock(pJob->sentMtx);
+    pJob->sentCv.wait(lock, [pJob]{ return !pJob->sentChunks.empty() || pJob->err; });
+    if(pJob->err)
+        return false;
+    chunk = pJob->sentChunks.front();
+    pJob->sentChunks.pop_front();
+    return true;
 }
 
 /**
- *  Display Finish Splashscreeen
+ *  Give back the input slots still held for the consumer
  */
-void show_finish_splashscreen(void)
+void release_sent_chunks(PStreamJob pJob)
 {
-    std::cout << std::endl;
-    std::cout << KCYN << " ------------------------------------------------------------------------------------" << KNRM << std::endl;
-    std::cout << KCYN << " Accelerated by Accelize & CAST GZip IP (up to 26Gbps version)                       " << KNRM << std::endl;
-    std::cout << KCYN << "     [Higher performance version available, please contact Accelize for more details]" << KNRM << std::endl;
-    std::cout << KCYN << " Designed with QuickPlay, Protected by Algodone Embedded DRM       " << KNRM << std::endl;
-    std::cout << std::endl;
+    std::lock_guard<std::mutex> lock(pJob->sentMtx);
+    while(!pJob->sentChunks.empty()) {
+        if(pJob->sentChunks.front().slot)
+            pJob->pInRing->putFree(pJob->sentChunks.front().slot);
+        pJob->sentChunks.pop_front();
+    }
 }
 
 /**
- *  Display Application Help/Usage Menu
+ *  Write an incompressible chunk to the outRing as one gzip member of
+ *  stored blocks, and give its slot back. Returns the member size, -1 once
+ *  the job was aborted.
  */
-int show_usage(char* argv[])
+long long int put_stored_member(PStreamJob pJob, ring_slot_t *in)
 {
-    std::cerr << KBLU << "Usage: " << argv[0] << " [OPTION]... [FILE/FOLDER]..." << KNRM << std::endl;
-    std::cerr << KBLU << "Compress FILEs (by default compress FILES in-place)." << KNRM << std::endl;
-    std::cerr << KBLU << "" << KNRM << std::endl;
-    std::cerr << KBLU << "\t-h, -? --help     give this help" << KNRM << std::endl;
-    std::cerr << KBLU << "\t-q, --quiet       suppress all warnings" << KNRM << std::endl;
-    std::cerr << KBLU << "\t-r, --recursive   operate recusively on directories" << KNRM << std::endl;
-    std::cerr << KBLU << "\t-t, --test        test compressed/decompressed file integrity" << KNRM << std::endl;
-    std::cerr << KBLU << "\t-f, --force       force overwrite of output file" << KNRM << std::endl;
-    std::cerr << KBLU << "\t-v, --verbose     verbose mode" << KNRM << std::endl;
-    std::cerr << KBLU << "\t-V, --version     display version number" << KNRM << std::endl;
-    std::cerr << KBLU << "\t--no-compare      disable performance comparison between CPU gzip and FPGA gzip" << KNRM << std::endl;
-    std::cerr << KBLU << "\t--sample-files    use gzip validation files sample (DEMO MODE)" << KNRM << std::endl;
-    std::cerr << KBLU << "" << KNRM << std::endl;
-    return -1;
+    std::string out;
+    gzip_write_header(out);
+    uint32_t crc = 0;
+    long long int done = 0, outSize = 0;
+    long long int size = in->used;
+    do {
+        long long int len = std::min((long long int)STORE_CHUNK_SIZE, size - done);
+        crc = crc32_fast(crc, &in->data[done], len);
+        deflate_write_stored(out, &in->data[done], len, done + len == size);
+        done += len;
+        if(done == size)
+            gzip_write_trailer(out, crc, (uint32_t)size);
+        for(size_t copied = 0; copied < out.size(); ) {
+            ring_slot_t *slot = pJob->pOutRing->getFree();
+            if(!slot) {
+                // Job aborted
+                pJob->pInRing->putFree(in);
+                return -1;
+            }
+            slot->used = std::min(slot->size, out.size() - copied);
+            memcpy(slot->data, &out[copied], slot->used);
+            pJob->pOutRing->putFilled(slot);
+            copied += slot->used;
+        }
+        outSize += out.size();
+        out.clear();
+    } while(done < size);
+    pJob->pInRing->putFree(in);
+    count_bypassed(size, outSize);
+    return outSize;
 }
 
 /**
- *  Display QuickApps Version
+ * Stream Consumer thread: archive_out -> outRing
  */
-int show_version(void)
+void tConsumer_stream(PStreamJob pJob)
 {
-    std::cout << KCYN << "  ------------------------------------------------------------------------------------ " << KNRM << std::endl;
-    std::cout << KCYN << " | QuickApp Version = " << QAPP_VERSION << "                                                           |" << KNRM << std::endl;
-    std::cout << KCYN << "  ------------------------------------------------------------------------------------ " << KNRM << std::endl;
-    return -1;
+    unsigned int eopCnt = 0;
+    long long int memberBytes = 0;
+    bool inMember = false;
+    while(!pJob->err && !(pJob->inputDone && eopCnt == pJob->nbChunks)) {
+        // A member starts: stored chunks are written out in their turn
+        if(pJob->entropyScan && !inMember) {
+            sent_chunk_t chunk;
+            if(!pop_sent_chunk(pJob, chunk))
+                break;
+            if(chunk.stored) {
+                long long int memberSize = put_stored_member(pJob, chunk.slot);
+                if(memberSize < 0)
+                    break;
+                pJob->outMembers.push_back(memberSize);
+                eopCnt++;
+                continue;
+            }
+            inMember = true;
+        }
+
+        ring_slot_t *slot = pJob->pOutRing->getFree();
+        if(!slot)
+            break;
+        bool eop = false;
+        unsigned int readBytes = 0;
+
+        if(dma_read_stream(dev1, *pJob->pStreamOut, slot->data, (unsigned int)slot->size, eop, readBytes)) {
+            if(!pJob->err)
+                std::cerr << KRED << "Data Read from FPGA error. File content could be incorrect" << KNRM << std::endl;
+            pJob->pOutRing->putFree(slot);
+            abort_stream_job(pJob, -1);
+            break;
+        }
+        memberBytes += readBytes;
+        if(eop) {
+            eopCnt++;
+            metrics_gauge_add(METRIC_QUEUE_DEPTH, -1);
+            pJob->outMembers.push_back(memberBytes);
+            memberBytes = 0;
+            inMember = false;
+        }
+        slot->used = readBytes;
+        if(readBytes)
+            pJob->pOutRing->putFilled(slot);
+        else
+            pJob->pOutRing->putFree(slot);
+    }
+    release_sent_chunks(pJob);
+    pJob->pOutRing->close();
 }
 
 /**
- *  os_gzip_file
+ * Stream Consumer thread, BGZF mode: archive_out -> outRing. Each member is
+ * reframed as a BGZF block, or stored when the device expanded its input
+ * past 64 KB or the entropy pre-scan kept it off the device, and the blocks
+ * are packed into the outRing slots. The BGZF end-of-file marker follows
+ * the last block.
  */
-int os_gzip_file(string comprMode, string inFile, double & elapsed, double & globBW, double & comprRatio, gzip_args_t args)
+void tConsumer_bgzf(PStreamJob pJob)
 {
-    if(args.verbose)
-        std::cout << KBLU << "Starting GZip Software compression (" << comprMode << ") of file [" << basename(inFile) << "] " << getFileSizeStr(inFile) << " ..." << KNRM << std::endl;
-
-    FILE *in;
-    string cmd = "gzip " + comprMode + " -c " + inFile + " > /var/tmp/fakeArch.gz 2> /dev/null";
-
-   // if files does not exist
-	struct stat buf;
-	if (stat(inFile.c_str(), &buf) != 0) {
-        std::cerr << KRED << "Error: Unable to open file [" << inFile << "]" << KNRM << std::endl;
-		return -1;
-	}
-
-    // Start Time Measurement
-    chrono::time_point<std::chrono::system_clock> start = chrono::system_clock::now();
-
-    // Create archive
-    if(!(in = popen(cmd.c_str(), "r"))) {
-        std::cerr << KRED << "os_gzip_file " << inFile << "failed" << KNRM << std::endl;
-		return -2;
+    std::vector<char> readBuffer(2*BGZF_MAX_BLOCK_SIZE);
+    std::string member, blocks;
+    unsigned int eopCnt = 0;
+    sent_chunk_t in;
+    bool inMember = false;
+    while(!pJob->err && !(pJob->inputDone && eopCnt == pJob->nbChunks)) {
+        if(!inMember) {
+            if(!pop_sent_chunk(pJob, in))
+                break;
+            inMember = true;
+        }
+        if(!in.stored) {
+            bool eop = false;
+            unsigned int readBytes = 0;
+            if(dma_read_stream(dev1, *pJob->pStreamOut, &readBuffer[0], (unsigned int)readBuffer.size(), eop, readBytes)) {
+                if(!pJob->err)
+                    std::cerr << KRED << "Data Read from FPGA error. File content could be incorrect" << KNRM << std::endl;
+                abort_stream_job(pJob, -1);
+                break;
+            }
+            member.append(&readBuffer[0], readBytes);
+            if(!eop)
+                continue;
+            metrics_gauge_add(METRIC_QUEUE_DEPTH, -1);
+        }
+        eopCnt++;
+        inMember = false;
+
+        // Incompressible blocks are stored without a trip through the device
+        size_t start = blocks.size();
+        if(in.stored) {
+            bgzf_write_stored(blocks, in.slot->data, in.slot->used);
+            count_bypassed(in.slot->used, blocks.size() - start);
+        }
+        else if(bgzf_write_member(blocks, member.data(), member.size())) {
+            if(!in.slot) {
+                std::cerr << KRED << "tConsumer_bgzf: member of " << member.size() << " bytes does not fit in a BGZF block" << KNRM << std::endl;
+                abort_stream_job(pJob, -1);
+                break;
+            }
+            bgzf_write_stored(blocks, in.slot->data, in.slot->used);
+        }
+        pJob->outMembers.push_back(blocks.size() - start);
+        if(in.slot)
+            pJob->pInRing->putFree(in.slot);
+        member.clear();
+
+        // Full slots go to the writer, the rest waits for the next blocks
+        while(blocks.size() >= STREAM_OUT_SLOT_SIZE) {
+            ring_slot_t *slot = pJob->pOutRing->getFree();
+            if(!slot)
+                break;
+            memcpy(slot->data, blocks.data(), slot->size);
+            slot->used = slot->size;
+            pJob->pOutRing->putFilled(slot);
+            blocks.erase(0, slot->size);
+        }
     }
-    pclose(in);
-    
-    // Stop Time Measurement
-    std::chrono::time_point<std::chrono::system_clock> end = std::chrono::system_clock::now();
 
-    // Compute Compression ratio
-    comprRatio = (double)getFileSize(inFile)/(double)getFileSize(std::string("/var/tmp/fakeArch.gz"));
+    if(!pJob->err)
+        bgzf_write_eof(blocks);
+    size_t done = 0;
+    while(!pJob->err && done < blocks.size()) {
+        ring_slot_t *slot = pJob->pOutRing->getFree();
+        if(!slot)
+            break;
+        slot->used = std::min(slot->size, blocks.size() - done);
+        memcpy(slot->data, &blocks[done], slot->used);
+        pJob->pOutRing->putFilled(slot);
+        done += slot->used;
+    }
 
-    // Clean Generated File
-    cmd = "rm -f /var/tmp/fakeArch.gz";
-    in = popen(cmd.c_str(), "r");
-    pclose(in);
+    // The input slots still held go back to the reader
+    release_sent_chunks(pJob);
+    pJob->pOutRing->close();
+}
 
-    // Compute elapsed time
-    globBW = getBandwidthMBps(start, end, (unsigned long)getFileSize(inFile));
-    elapsed = getElapsedSecs(start, end);    
+/**
+ * Stream Writer thread, regular files: outRing slots are written behind the
+ * consumer with ioDepth writes in flight, and given back as they complete
+ */
+void tWriterRing_stream(PStreamJob pJob, long long int offset)
+{
+    IoRing ring(pJob->ioDepth);
+    ring.registerBuffer(pJob->pOutRing->memory(), pJob->pOutRing->memorySize());
+
+    while(true) {
+        ring_slot_t *slot = NULL;
+        if(ring.inflight() < ring.depth())
+            slot = ring.inflight() ? pJob->pOutRing->tryGetFilled() : pJob->pOutRing->getFilled();
+        if(slot) {
+            // Slots keep flowing back to the consumer after an error
+            if(!pJob->err && !ring.submitWrite(pJob->fdOut, slot->data, slot->used, offset, slot)) {
+                offset += slot->used;
+                continue;
+            }
+            if(!pJob->err) {
+                std::cerr << KRED << "tWriter_stream: write submission error" << KNRM << std::endl;
+                abort_stream_job(pJob, -4);
+            }
+            pJob->pOutRing->putFree(slot);
+            continue;
+        }
+        if(!ring.inflight())
+            break;
+
+        void *user;
+        long long int res;
+        if(ring.wait(user, res)) {
+            std::cerr << KRED << "tWriter_stream: write completion error" << KNRM << std::endl;
+            abort_stream_job(pJob, -4);
+            while((slot = pJob->pOutRing->getFilled()) != NULL)
+                pJob->pOutRing->putFree(slot);
+            break;
+        }
+        slot = (ring_slot_t *)user;
+        if(res != (long long int)slot->used) {
+            std::cerr << KRED << "tWriter_stream: write error (" << (res < 0 ? strerror(-res) : "short write") << ")" << KNRM << std::endl;
+            abort_stream_job(pJob, -4);
+        }
+        else
+            pJob->outBytes += res;
+        pJob->pOutRing->putFree(slot);
+    }
 
-    return 0;
+    // Leave the descriptor where blocking writes would have
+    lseek(pJob->fdOut, offset, SEEK_SET);
 }
 
 /**
- * Gzip File in FPGA
+ * Stream Writer thread: outRing -> output file
  */
-int fpga_gzip_file(string in_filename, gzip_args_t args, file_results_t* res)
-{ 
-    double elapsed;
-    double osBandwidthMBpsFast, osBandwidthMBpsBest;
-    double comprRatio;
-    int retCode=0;
+void tWriter_stream(PStreamJob pJob)
+{
+    long long int offset = stream_io_offset(pJob->fdOut, pJob->ioDepth);
+    if(offset >= 0) {
+        tWriterRing_stream(pJob, offset);
+        return;
+    }
 
-    // Compute out_filename
+    ring_slot_t *slot;
+    while((slot = pJob->pOutRing->getFilled()) != NULL) {
+        size_t written = 0;
+        while(written < slot->used && !pJob->err) {
+            ssize_t ret = write(pJob->fdOut, &slot->data[written], slot->used-written);
+            if(ret < 0 && errno == EINTR)
+                continue;
+            if(ret < 0) {
+                std::cerr << KRED << "tWriter_stream: write error (" << strerror(errno) << ")" << KNRM << std::endl;
+                abort_stream_job(pJob, -4);
+                break;
+            }
+            written += ret;
+        }
+        pJob->outBytes += written;
+        pJob->pOutRing->putFree(slot);
+    }
+}
+#endif
+
+/**
+ *  Transfer histograms of every qpWriteStream/qpReadStream call so far
+ */
+void show_dma_stats(void)
+{
+    static const char *names[DMA_NB_HISTS] = { "Write size", "Write time", "Read size", "Read time", "First byte wait", "EOP gap" };
+    static const bool isSize[DMA_NB_HISTS] = { true, false, true, false, false, false };
+
+    TextTable tableDma( '-', '|', '+' );
+    tableDma.setTitle("DMA TRANSFERS (sizes in KB, times in us)");
+    tableDma.add( "Histogram" );
+    tableDma.add( "Count" );
+    tableDma.add( "Mean" );
+    tableDma.add( "p50" );
+    tableDma.add( "p90" );
+    tableDma.add( "p99" );
+    tableDma.add( "p99.9" );
+    tableDma.add( "Max" );
+    tableDma.endOfRow();
+    for(int h=0; h<DMA_NB_HISTS; h++) {
+        const DmaHistogram & hist = dma_histogram(h);
+        double unit = isSize[h] ? SIZE_1KB : 1000.0;
+        tableDma.add( string(names[h]) );
+        tableDma.add( (unsigned int)hist.count() );
+        tableDma.add( hist.mean()/unit );
+        tableDma.add( hist.percentile(50.0)/unit );
+        tableDma.add( hist.percentile(90.0)/unit );
+        tableDma.add( hist.percentile(99.0)/unit );
+        tableDma.add( hist.percentile(99.9)/unit );
+        tableDma.add( hist.max()/unit );
+        tableDma.endOfRow();
+    }
+    std::cout << "\n" << tableDma;
+}
+
+/**
+ * Reporter thread: SIGUSR1 prints the hardware report and the transfer
+ * histograms. The signal is blocked in every thread and taken here only.
+ */
+void tReporter()
+{
+    sigset_t set;
+    sigemptyset(&set);
+    sigaddset(&set, SIGUSR1);
+    while(true) {
+        int sig;
+        if(sigwait(&set, &sig))
+            break;
+        if(reporterExit)
+            break;
+        dev1.qpPrintHwReport(std::cout, "file_in");
+        dev1.qpPrintHwReport(std::cout, "archive_out");
+        show_dma_stats();
+        std::cout << std::flush;
+    }
+}
+
+/**
+ *  count_compressed: one more file in the exported metrics
+ */
+void count_compressed(long long int inSize, long long int outSize)
+{
+    metrics_add(METRIC_BYTES_IN, inSize);
+    metrics_add(METRIC_BYTES_OUT, outSize);
+    metrics_add(METRIC_FILES, 1);
+}
+
+/**
+ *  show_check_error
+ */
+void show_check_error(string inFile, string outFile, int check)
+{
+    if(check < 0)
+        metrics_add(METRIC_ERRORS, 1);
+    if(check == GZIP_CHECK_BAD_FORMAT)
+        std::cerr << KRED << "Error: Archive [" << outFile << "] is not a valid gzip file" << KNRM << std::endl;
+    else if(check == GZIP_CHECK_BAD_CRC)
+        std::cerr << KRED << "Error: Archive [" << outFile << "] CRC32 does not match [" << inFile << "]" << KNRM << std::endl;
+    else if(check == GZIP_CHECK_BAD_SIZE)
+        std::cerr << KRED << "Error: Archive [" << outFile << "] size does not match [" << inFile << "]" << KNRM << std::endl;
+    else if(check == GZIP_CHECK_MISMATCH)
+        std::cerr << KRED << "Error: Archive [" << outFile << "] does not inflate to [" << inFile << "]" << KNRM << std::endl;
+    else if(check == INFLATE_VERIFY_IO_ERROR)
+        std::cerr << KRED << "Error: Unable to read [" << inFile << "] or [" << outFile << "]" << KNRM << std::endl;
+}
+
+/**
+ *  checkArchive: inflate outFile in memory and compare it with inFile
+ */
+int checkArchive(string inFile, string outFile, bool verbose)
+{
+    if(verbose)
+        std::cout << KBLU << "Checking Archive " << outFile << " ..." << KNRM << std::endl;
+
+    int retCode = InflateVerifier::verifyFiles(inFile, outFile);
+    show_check_error(inFile, outFile, retCode);
+    return retCode;
+}
+
+/**
+ *  verify_sampled: true when the next archive is picked for a round-trip test
+ */
+bool verify_sampled(const gzip_args_t & args)
+{
+    static std::atomic<unsigned long long> count(0);
+    unsigned long long n = ++count;
+    return (n*args.verifyRate)/100 != ((n-1)*args.verifyRate)/100;
+}
+
+/**
+ *  Display Application Configuration
+ */
+void show_appconfig(gzip_args_t args)
+{
+    std::cout << KBLU << "Target:           " << (args.operateOnFolder?string("Folder"):string("File")) << KNRM << std::endl;
+    std::cout << KBLU << "Quiet:            " << (args.quiet?string("Yes"):string("No")) << KNRM << std::endl;
+    std::cout << KBLU << "verifyIntegrity:  " << (args.verifyIntegrity?string("Yes"):string("No")) << KNRM << std::endl;
+    std::cout << KBLU << "OScompare:        " << (args.OScompare?string("Yes"):string("No")) << KNRM << std::endl;
+    std::cout << KBLU << "DemoMode:         " << (args.demoMode?string("Enabled"):string("Disabled")) << KNRM << std::endl;  
+    std::cout << KBLU << "StreamMode:       " << (args.streamMode?string("Enabled"):string("Disabled")) << KNRM << std::endl;
+    std::cout << KBLU << "Path :            "  << args.path << KNRM << std::endl;
+}
+
+/**
+ *  Display Starting Splashscreeen
+ */
+void show_start_splashscreen(void)
+{
+    std::cout << KCYN << "  ------------------------------------------------------------------------------------ " << KNRM << std::endl;
+    std::cout << KCYN << " |                                                                                    |" << KNRM << std::endl;
+    std::cout << KCYN << " |        GZIP FPGA Accelerator Powered by Accelize & CAST GZip IP                    |" << KNRM << std::endl;
+    std::cout << KCYN << " |          Designed with QuickPlay, Protected by Algodone Embedded DRM               |" << KNRM << std::endl;
+    std::cout << KCYN << " |                                                                                    |" << KNRM << std::endl;
+    std::cout << KCYN << "  ------------------------------------------------------------------------------------ " << KNRM << std::endl;
+    std::cout << std::endl;
+}
+
+/**
+ *  Display Finish Splashscreeen
+ */
+void show_finish_splashscreen(void)
+{
+    std::cout << std::endl;
+    std::cout << KCYN << " ------------------------------------------------------------------------------------" << KNRM << std::endl;
+    std::cout << KCYN << " Accelerated by Accelize & CAST GZip IP (up to 26Gbps version)                       " << KNRM << std::endl;
+    std::cout << KCYN << "     [Higher performance version available, please contact Accelize for more details]" << KNRM << std::endl;
+    std::cout << KCYN << " Designed with QuickPlay, Protected by Algodone Embedded DRM       " << KNRM << std::endl;
+    std::cout << std::endl;
+}
+
+/**
+ *  Display Application Help/Usage Menu
+ */
+int show_usage(char* argv[])
+{
+    std::cerr << KBLU << "Usage: " << argv[0] << " [OPTION]... [FILE/FOLDER]..." << KNRM << std::endl;
+    std::cerr << KBLU << "Compress FILEs (by default compress FILES in-place)." << KNRM << std::endl;
+    std::cerr << KBLU << "" << KNRM << std::endl;
+    std::cerr << KBLU << "With no FILE, or when FILE is -, read standard input and write standard output." << KNRM << std::endl;
+    std::cerr << KBLU << "" << KNRM << std::endl;
+    std::cerr << KBLU << "\t-c, --stdout      write on standard output, keep original files unchanged" << KNRM << std::endl;
+    std::cerr << KBLU << "\t-d, --decompress  decompress .gz files on the host, --sw-threads threads (-t: test only)" << KNRM << std::endl;
+    std::cerr << KBLU << "\t-h, -? --help     give this help" << KNRM << std::endl;
+    std::cerr << KBLU << "\t-q, --quiet       suppress all warnings" << KNRM << std::endl;
+    std::cerr << KBLU << "\t-r, --recursive   operate recusively on directories" << KNRM << std::endl;
+    std::cerr << KBLU << "\t-t, --test        test compressed/decompressed file integrity" << KNRM << std::endl;
+    std::cerr << KBLU << "\t--verify-rate=PCT test: inflate PCT% of the archives, trailer check only for the others (default 100)" << KNRM << std::endl;
+    std::cerr << KBLU << "\t--verify-threads=N test: N threads inflate archives in the background (default: half the cores)" << KNRM << std::endl;
+    std::cerr << KBLU << "\t-f, --force       force overwrite of output file" << KNRM << std::endl;
+    std::cerr << KBLU << "\t-v, --verbose     verbose mode" << KNRM << std::endl;
+    std::cerr << KBLU << "\t-V, --version     display version number" << KNRM << std::endl;
+    std::cerr << KBLU << "\t--no-compare      disable performance comparison between CPU gzip and FPGA gzip" << KNRM << std::endl;
+    std::cerr << KBLU << "\t--sw-levels=LIST  software baseline levels, e.g. 1,6,9 or 1-9 (default 1-9, 1 and 9 always run)" << KNRM << std::endl;
+    std::cerr << KBLU << "\t--sw-threads=N    software baseline with N threads, next to the single-threaded run (default: all cores)" << KNRM << std::endl;
+    std::cerr << KBLU << "\t--sample-files    use gzip validation files sample (DEMO MODE)" << KNRM << std::endl;
+    std::cerr << KBLU << "\t--sequential      folder mode: one file at a time, streams opened for each file" << KNRM << std::endl;
+    std::cerr << KBLU << "\t--no-fallback     fail when no FPGA design is available, instead of compressing on the CPU" << KNRM << std::endl;
+    std::cerr << KBLU << "\t--hybrid          folder mode: also compress on the CPU (--sw-threads), each file goes to the engine expected to finish it first" << KNRM << std::endl;
+    std::cerr << KBLU << "\t--include=GLOB    folder mode: only compress files whose name matches GLOB (repeatable)" << KNRM << std::endl;
+    std::cerr << KBLU << "\t--exclude=GLOB    folder mode: skip files and folders whose name matches GLOB (repeatable)" << KNRM << std::endl;
+    std::cerr << KBLU << "\t--walk-threads=N  folder mode: N threads walk the tree (default 4)" << KNRM << std::endl;
+    std::cerr << KBLU << "\t--boards=N        use the first N boards found (default: all boards)" << KNRM << std::endl;
+    std::cerr << KBLU << "\t--batch           folder mode: pack small files into batched device submissions" << KNRM << std::endl;
+    std::cerr << KBLU << "\t--batch-size=KB   batch mode with KB kilobytes per batch (default 4096)" << KNRM << std::endl;
+    std::cerr << KBLU << "\t--batch-deadline=MS  batch mode, flush a batch after MS milliseconds (default 50)" << KNRM << std::endl;
+    std::cerr << KBLU << "\t--batch-archive=FILE batch mode, write a single multi-member archive FILE" << KNRM << std::endl;
+    std::cerr << KBLU << "\t--stream          bounded memory streaming compression (multi-member archive)" << KNRM << std::endl;
+    std::cerr << KBLU << "\t--stream-chunk=MB streaming mode with MB megabytes per gzip member (default 32)" << KNRM << std::endl;
+    std::cerr << KBLU << "\t--index           streaming mode, plus an index of the members in <archive>.idx" << KNRM << std::endl;
+    std::cerr << KBLU << "\t--bgzf            BGZF output: 64 KB blocks with a BC extra field and the EOF marker, as bgzip writes" << KNRM << std::endl;
+    std::cerr << KBLU << "\t--no-entropy-scan send incompressible data to the device too, instead of storing it on the host" << KNRM << std::endl;
+    std::cerr << KBLU << "\t--extract=OFF:LEN write LEN bytes of the original data of an archive, from offset OFF, to stdout" << KNRM << std::endl;
+    std::cerr << KBLU << "\t--io-depth=N      file reads and writes with N transfers in flight, 0 for mmap and blocking I/O (default 8)" << KNRM << std::endl;
+    std::cerr << KBLU << "\t--io-buffers=N    streaming mode: N input chunks read ahead of the device (default 3)" << KNRM << std::endl;
+    std::cerr << KBLU << "\t--dma-stats       print DMA transfer histograms at exit (SIGUSR1 prints them while running)" << KNRM << std::endl;
+    std::cerr << KBLU << "\t--metrics=PORT    serve metrics over HTTP on 127.0.0.1:PORT, /metrics (Prometheus) or /metrics.json" << KNRM << std::endl;
+    std::cerr << KBLU << "\t--metrics=unix:PATH  serve the metrics on the Unix socket PATH" << KNRM << std::endl;
+    std::cerr << KBLU << "\t--metrics-interval=MS  refresh the served metrics every MS milliseconds (default 1000)" << KNRM << std::endl;
+    std::cerr << KBLU << "\t--design-cache=FILE  where each design JSON file was found (default ~/.cache/gzip_fpga/designs)" << KNRM << std::endl;
+    std::cerr << KBLU << "\t--no-design-cache scan the JSON search path on every run" << KNRM << std::endl;
+    std::cerr << KBLU << "\t--daemon=PATH     keep the design open and compress for the clients of the Unix socket PATH" << KNRM << std::endl;
+    std::cerr << KBLU << "\t--connect=PATH    client mode: have the daemon on the Unix socket PATH compress, same file options" << KNRM << std::endl;
+    std::cerr << KBLU << "\t--bench           benchmark mode: per-file latency percentiles of the device, the host pipeline and file to file" << KNRM << std::endl;
+    std::cerr << KBLU << "\t--bench-warmup=N  benchmark mode with N untimed runs per file (default 2)" << KNRM << std::endl;
+    std::cerr << KBLU << "\t--bench-iterations=N benchmark mode with N timed runs per file (default 10)" << KNRM << std::endl;
+    std::cerr << KBLU << "\t--pool-size=MB    staging buffers leased from a pinned MB megabytes hugepage pool, 0 to map them per file (default 256)" << KNRM << std::endl;
+    std::cerr << KBLU << "" << KNRM << std::endl;
+    return -1;
+}
+
+/**
+ *  Display QuickApps Version
+ */
+int show_version(void)
+{
+    std::cout << KCYN << "  ------------------------------------------------------------------------------------ " << KNRM << std::endl;
+    std::cout << KCYN << " | QuickApp Version = " << QAPP_VERSION << "                                                           |" << KNRM << std::endl;
+    std::cout << KCYN << "  ------------------------------------------------------------------------------------ " << KNRM << std::endl;
+    return -1;
+}
+
+/**
+ *  sw_gzip_file: software baseline, every level of args.swLevels run on the
+ *  same mapped input, with one thread and with args.swThreads threads
+ */
+int sw_gzip_file(string inFile, gzip_args_t args, file_results_t* res)
+{
+    if(args.verbose)
+        std::cout << KBLU << "Starting GZip Software compression of file [" << basename(inFile) << "] " << getFileSizeStr(inFile) << " ..." << KNRM << std::endl;
+
+    int fin = open(inFile.c_str(), O_RDONLY);
+    if (fin == -1) {
+        std::cerr << KRED << "Error: Unable to open file [" << inFile << "]" << KNRM << std::endl;
+        return -1;
+    }
+    long long int size = getFileSize(inFile);
+    const char *data = "";
+    if(size > 0) {
+        data = (const char *)mmap(NULL, size, PROT_READ, MAP_PRIVATE|MAP_POPULATE, fin, 0);
+        if (data == MAP_FAILED) {
+            std::cerr << KRED << "sw_gzip_file: Memory map error on input file [" << inFile << "]" << KNRM << std::endl;
+            close(fin);
+            return -2;
+        }
+    }
+    close(fin);
+
+    int retCode = 0;
+    std::string out;
+    for(int level=1; level<=9 && !retCode; level++) {
+        res->swOutSize[level] = 0;
+        if(!(args.swLevels & (1 << level)))
+            continue;
+
+        for(int pass=0; pass<2 && !retCode; pass++) {
+            unsigned int nbThreads = pass ? args.swThreads : 1;
+            if(pass && nbThreads <= 1) {
+                res->swMtSecs[level] = res->swSecs[level];
+                break;
+            }
+            out.clear();
+            chrono::time_point<std::chrono::steady_clock> start = chrono::steady_clock::now();
+            if(sw_gzip_buffer(data, size, level, nbThreads, out)) {
+                std::cerr << KRED << "sw_gzip_file " << inFile << " failed" << KNRM << std::endl;
+                retCode = -2;
+            }
+            std::chrono::time_point<std::chrono::steady_clock> end = std::chrono::steady_clock::now();
+            (pass ? res->swMtSecs : res->swSecs)[level] = getElapsedSecs(start, end);
+            if(!pass)
+                res->swOutSize[level] = out.size();
+        }
+    }
+
+    if(size > 0)
+        munmap((void *)data, size);
+    if(!retCode)
+        res->swInSize = size;
+    return retCode;
+}
+
+/**
+ * Verify archive and run the software comparison for one compressed file
+ */
+int complete_file_results(string in_filename, string out_filename, gzip_args_t args, file_results_t* res,
+                          int inlineCheck=GZIP_CHECK_NONE, bool inflateDone=false)
+{
+    int retCode=0;
+
+    // Verify Compression Result: trailer check when the CRC32 was computed along
+    // the transfer, then a round-trip test unless it already ran in the background
+    if(args.verifyIntegrity) {
+        retCode = (inlineCheck == GZIP_CHECK_NONE) ? GZIP_CHECK_OK : inlineCheck;
+        if(!retCode && !inflateDone && verify_sampled(args))
+            retCode = checkArchive(in_filename, out_filename, args.verbose);
+        else
+            show_check_error(in_filename, out_filename, retCode);
+    }
+
+    if(res->engine.empty())
+        res->engine = std::string("FPGA");
+
+    // Update Compression result label
+    if(retCode)
+        res->comprResult = std::string("FAIL");
+    else
+        res->comprResult = std::string("SUCCESS");
+
+    res->swInSize = 0;
+    if(args.OScompare && !sw_gzip_file(in_filename, args, res)) {
+        // --fast and --best columns: single-threaded, as gzip runs
+        double inMB = (double)res->swInSize/SIZE_1MB;
+        res->swBwFastMBps = res->swSecs[SW_FAST_LEVEL] > 0.0 ? inMB/res->swSecs[SW_FAST_LEVEL] : -1.0;
+        res->swBwBestMBps = res->swSecs[SW_BEST_LEVEL] > 0.0 ? inMB/res->swSecs[SW_BEST_LEVEL] : -1.0;
+        res->swComprFastRatio = (double)res->swInSize/res->swOutSize[SW_FAST_LEVEL];
+        res->swComprBestRatio = (double)res->swInSize/res->swOutSize[SW_BEST_LEVEL];
+    
+        // Compute Gains
+        res->bwFastGain    = res->hwBwMBps / res->swBwFastMBps;
+        res->bwBestGain    = res->hwBwMBps / res->swBwBestMBps;
+        res->comprFastGain = res->hwComprRatio / res->swComprFastRatio;
+        res->comprBestGain = res->hwComprRatio / res->swComprBestRatio;
+    }
+    else {
+        res->swComprBestRatio = -1.0;
+        res->swComprFastRatio = -1.0;
+        res->swBwBestMBps = -1.0;
+        res->swBwFastMBps = -1.0;
+        res->bwFastGain = -1.0;
+        res->bwBestGain = -1.0;
+        res->comprFastGain = -1.0;
+        res->comprBestGain = -1.0;
+    }
+	return 0;
+}
+
+/**
+ * Gzip a file descriptor into another one on the CPU (fallback, pipe mode)
+ *
+ * The input is read in streamChunkSize chunks, each one compressed on all
+ * cores as its own gzip member, as the device streaming mode does.
+ */
+int cpu_gzip_fd_stream(int fdIn, int fdOut, gzip_args_t args, double & bwMBps, gzip_index_t *pIndex=NULL)
+{
+    char *chunk = (char *)malloc(args.streamChunkSize);
+    if(!chunk) {
+        std::cerr << KRED << "cpu_gzip_fd_stream: Unable to allocate stream buffer" << KNRM << std::endl;
+        return -2;
+    }
+
+    int retCode = 0;
+    std::string out;
+    infsize = 0;
+    outfsize = 0;
+    chrono::time_point<std::chrono::steady_clock> start = chrono::steady_clock::now();
+    bool eof = false;
+    while(!eof && !retCode) {
+        long long int size = 0;
+        while(size < args.streamChunkSize) {
+            ssize_t ret = read(fdIn, &chunk[size], args.streamChunkSize-size);
+            if(ret < 0 && errno == EINTR)
+                continue;
+            if(ret < 0) {
+                std::cerr << KRED << "cpu_gzip_fd_stream: Error: Reading input" << KNRM << std::endl;
+                retCode = -1;
+            }
+            if(ret <= 0) {
+                eof = true;
+                break;
+            }
+            size += ret;
+        }
+        // An empty input still gives one empty member, BGZF ends with its EOF block
+        if(retCode || (!size && infsize && !args.bgzfMode))
+            break;
+
+        // Incompressible chunk: stored, not deflated
+        out.clear();
+        entropy_stats_t stats;
+        bool stored = args.entropyScan && entropy_scan(chunk, size, stats);
+        int ret = 0;
+        if(stored && args.bgzfMode) {
+            for(long long int done=0; done<size; done+=BGZF_BLOCK_SIZE)
+                bgzf_write_stored(out, &chunk[done], std::min((long long int)BGZF_BLOCK_SIZE, size-done));
+        }
+        else if(stored)
+            sw_gzip_stored(chunk, size, crc32_fast(0, chunk, size), out);
+        else
+            ret = args.bgzfMode ? sw_bgzf_buffer(chunk, size, CPU_ENGINE_LEVEL, args.swThreads, out)
+                                : sw_gzip_buffer(chunk, size, CPU_ENGINE_LEVEL, args.swThreads, out);
+        if(stored)
+            count_bypassed(size, out.size());
+        if(ret) {
+            std::cerr << KRED << "cpu_gzip_fd_stream: Compression error" << KNRM << std::endl;
+            retCode = -2;
+            break;
+        }
+        if(args.bgzfMode && eof)
+            bgzf_write_eof(out);
+        long long int written = 0;
+        while(written < (long long int)out.size()) {
+            ssize_t ret = write(fdOut, &out[written], out.size()-written);
+            if(ret < 0 && errno == EINTR)
+                continue;
+            if(ret < 0) {
+                std::cerr << KRED << "cpu_gzip_fd_stream: Error: Unable to write output ret=" << ret << KNRM << std::endl;
+                retCode = -4;
+                break;
+            }
+            written += ret;
+        }
+        infsize += size;
+        outfsize += out.size();
+        if(pIndex && args.bgzfMode) {
+            // One entry per block, the block sizes read back from BSIZE
+            size_t in = 0;
+            for(size_t pos=0; pos+BGZF_HEADER_SIZE <= out.size(); ) {
+                size_t blockSize = ((unsigned char)out[pos+16] | ((unsigned char)out[pos+17] << 8)) + 1;
+                size_t len = std::min((size_t)BGZF_BLOCK_SIZE, (size_t)size - in);
+                gzip_index_add(*pIndex, len, blockSize);
+                pos += blockSize;
+                in += len;
+            }
+        }
+        else if(pIndex)
+            gzip_index_add(*pIndex, size, out.size());
+        if(!size)
+            break;
+    }
+    std::chrono::time_point<std::chrono::steady_clock> end = std::chrono::steady_clock::now();
+    bwMBps = getBandwidthMBps(start, end, infsize);
+    free(chunk);
+    return retCode;
+}
+
+/**
+ * Gzip File on the CPU (fallback): one gzip member deflated on all cores
+ */
+int cpu_gzip_file(string in_filename, string out_filename, gzip_args_t args, file_results_t* res)
+{
+    if(args.verbose)
+        std::cout << KBLU << "\nStarting GZip Software compression of file [" << basename(in_filename) << "] " << getFileSizeStr(in_filename) << " ..." << KNRM << std::endl;
+
+    int fin = open(in_filename.c_str(), O_RDONLY);
+    if (fin == -1) {
+        std::cerr << KRED << "cpu_gzip_file: Error: Opening input file [" << in_filename << "]" << KNRM << std::endl;
+        return -1;
+    }
+    long long int size = getFileSize(in_filename);
+    const char *data = "";
+    if(size > 0) {
+        data = (const char *)mmap(NULL, size, PROT_READ, MAP_PRIVATE|MAP_POPULATE, fin, 0);
+        if (data == MAP_FAILED) {
+            std::cerr << KRED << "cpu_gzip_file: Memory map error on input file [" << in_filename << "]" << KNRM << std::endl;
+            close(fin);
+            return -2;
+        }
+    }
+    close(fin);
+
+    std::string out;
+    chrono::time_point<std::chrono::steady_clock> start = chrono::steady_clock::now();
+    int retCode = sw_gzip_buffer(data, size, CPU_ENGINE_LEVEL, args.swThreads, out);
+    std::chrono::time_point<std::chrono::steady_clock> end = std::chrono::steady_clock::now();
+    if(size > 0)
+        munmap((void *)data, size);
+    if(retCode) {
+        std::cerr << KRED << "cpu_gzip_file: Compression error on [" << in_filename << "]" << KNRM << std::endl;
+        return -2;
+    }
+
+    int fout = open(out_filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC, S_IWRITE | S_IREAD);
+    if (fout == -1) {
+        std::cerr << KRED << "cpu_gzip_file: Error: Opening output file [" << out_filename << "]" << KNRM << std::endl;
+        return -3;
+    }
+    long long int written = 0;
+    while(written < (long long int)out.size()) {
+        ssize_t ret = write(fout, &out[written], out.size()-written);
+        if(ret < 0 && errno == EINTR)
+            continue;
+        if(ret < 0) {
+            std::cerr << KRED << "Error: Unable to write output file [" << out_filename << "] ret=" << ret << KNRM << std::endl;
+            close(fout);
+            return -4;
+        }
+        written += ret;
+    }
+    close(fout);
+
+    res->engine = std::string("CPU");
+    res->hwBwMBps = getBandwidthMBps(start, end, size);
+    res->hwComprRatio = out.size() ? (double)size/(double)out.size() : -1.0;
+    count_compressed(size, out.size());
+    return 0;
+}
+
+#ifdef SGDMAR
+/**
+ * Gzip a file descriptor into another one through the FPGA, streaming mode.
+ * pIndex, when given, gets one entry per member.
+ */
+int fpga_gzip_fd_stream(int fdIn, int fdOut, gzip_args_t args, unsigned int nbInSlots, double & bwMBps,
+                        gzip_index_t *pIndex=NULL)
+{
+    // BGZF mode: many small members in flight keep the device busy
+    if(args.bgzfMode)
+        nbInSlots = BGZF_IN_SLOTS;
+    BufferRing inRing(nbInSlots, args.bgzfMode ? BGZF_BLOCK_SIZE : args.streamChunkSize, bufferPool);
+    BufferRing outRing(STREAM_OUT_SLOTS, STREAM_OUT_SLOT_SIZE, bufferPool);
+    if(!inRing.valid() || !outRing.valid()) {
+        std::cerr << KRED << "fpga_gzip_fd_stream: Unable to allocate stream buffers" << KNRM << std::endl;
+        return -2;
+    }
+
+    // Create Related Streams
+    QpStream data_in("file_in", 3);
+    QpStream data_out("archive_out", 3);
+    if (dev1.qpOpenStream(data_in)) {
+        std::cerr << KRED << " => Call OpenStream failed for QpStream data_in." << KNRM << std::endl;
+        return -1;
+    }
+    if (dev1.qpOpenStream(data_out)) {
+        std::cerr << KRED << " => Call OpenStream failed for QpStream data_out." << KNRM << std::endl;
+        dev1.qpCloseStream(data_in);
+        return -1;
+    }
+
+    stream_job_t job;
+    job.pStreamIn  = &data_in;
+    job.pStreamOut = &data_out;
+    job.pInRing    = &inRing;
+    job.pOutRing   = &outRing;
+    job.fdIn       = fdIn;
+    job.fdOut      = fdOut;
+    job.ioDepth    = args.ioDepth;
+    job.inBytes    = 0;
+    job.outBytes   = 0;
+    job.inputDone  = false;
+    job.nbChunks   = 0;
+    job.err        = 0;
+    job.bgzf       = args.bgzfMode;
+    job.entropyScan = args.entropyScan;
+
+    chrono::time_point<std::chrono::steady_clock> start = chrono::steady_clock::now();
+
+    std::thread Writer_thread(tWriter_stream, &job);
+    std::thread Consumer_thread(args.bgzfMode ? tConsumer_bgzf : tConsumer_stream, &job);
+    std::thread Producer_thread(tProducer_stream, &job);
+    std::thread Reader_thread(tReader_stream, &job);
+
+    Reader_thread.join();
+    Producer_thread.join();
+    Consumer_thread.join();
+    Writer_thread.join();
+
+    std::chrono::time_point<std::chrono::steady_clock> end = std::chrono::steady_clock::now();
+
+    // Close the streams. An aborted job may have left data in the device.
+    dev1.qpCloseStream(data_in);
+    dev1.qpCloseStream(data_out);
+    if(job.err)
+        dev1.qpResetDesign();
+
+    infsize  = job.inBytes;
+    outfsize = job.outBytes;
+    bwMBps = getBandwidthMBps(start, end, infsize);
+
+    if(args.verbose)
+        std::cerr << KBLU << "Streamed " << job.nbChunks << " member(s), " << infsize << " -> " << outfsize
+                  << " bytes, " << (inRing.memorySize()+outRing.memorySize())/SIZE_1MB << " MB of buffers" << KNRM << std::endl;
+
+    if(pIndex && !job.err) {
+        if(job.inMembers.size() != job.outMembers.size()) {
+            std::cerr << KRED << "fpga_gzip_fd_stream: " << job.inMembers.size() << " member(s) sent, "
+                      << job.outMembers.size() << " received, no index" << KNRM << std::endl;
+            return -1;
+        }
+        for(size_t i=0; i<job.inMembers.size(); i++)
+            gzip_index_add(*pIndex, job.inMembers[i], job.outMembers[i]);
+        if(args.bgzfMode)
+            gzip_index_add(*pIndex, 0, BGZF_EOF_SIZE);
+    }
+    return job.err;
+}
+
+/**
+ * Gzip File in FPGA, streaming mode
+ *
+ * The input is read in streamChunkSize chunks, each one compressed as its own
+ * gzip member, and the output is written while the device is compressing.
+ * Memory use is bounded by the rings whatever the file size.
+ */
+int fpga_gzip_file_stream(string in_filename, string out_filename, gzip_args_t args, file_results_t* res)
+{
+    if(args.verbose)
+        std::cout << KBLU << "\nStarting GZip Hardware streaming compression of file [" << basename(in_filename) << "] " << getFileSizeStr(in_filename) << " ..." << KNRM << std::endl;
+
+    // Open input file
+    int fin = open(in_filename.c_str(), O_RDONLY);
+    if (fin == -1) {
+        std::cerr << KRED << "fpga_gzip_file_stream: Error: Opening input file [" << in_filename << "]" << KNRM << std::endl;
+        return -1;
+    }
+    posix_fadvise(fin, 0, 0, POSIX_FADV_SEQUENTIAL);
+
+    // Create output file
+    int fout = open(out_filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC, S_IWRITE | S_IREAD);
+    if (fout == -1) {
+        std::cerr << KRED << "fpga_gzip_file_stream: Error: Opening output file [" << out_filename << "]" << KNRM << std::endl;
+        close(fin);
+        return -3;
+    }
+
+    // Index mode: the members are recorded, on the CPU engine too
+    gzip_index_t index;
+    gzip_index_t *pIndex = args.indexMode ? &index : NULL;
+    int retCode;
+    if(cpuFallback) {
+        res->engine = std::string("CPU");
+        retCode = cpu_gzip_fd_stream(fin, fout, args, res->hwBwMBps, pIndex);
+    }
+    else
+        retCode = fpga_gzip_fd_stream(fin, fout, args, args.ioBuffers, res->hwBwMBps, pIndex);
+    close(fin);
+    close(fout);
+    if(!retCode && pIndex && gzip_index_save(out_filename + GZIP_INDEX_SUFFIX, index)) {
+        std::cerr << KRED << "Error: Unable to write the index [" << out_filename << GZIP_INDEX_SUFFIX << "]" << KNRM << std::endl;
+        retCode = -4;
+    }
+    if(retCode) {
+        metrics_add(METRIC_ERRORS, 1);
+        return retCode;
+    }
+    if(pIndex && args.verbose)
+        std::cout << KBLU << "Index [" << basename(out_filename) << GZIP_INDEX_SUFFIX << "]: " << index.size()-1
+                  << " member(s) of " << args.streamChunkSize/SIZE_1MB << " MB" << KNRM << std::endl;
+
+    // Save Compression Result: single pass, disk included
+    res->filename = basename(in_filename);
+    res->hwComprRatio = outfsize ? (double)infsize/(double)outfsize : -1.0;
+    count_compressed(infsize, outfsize);
+    return 0;
+}
+
+/**
+ * Gzip stdin or a file to stdout through the FPGA (pipe mode)
+ */
+int fpga_gzip_pipe(gzip_args_t args, file_results_t* res)
+{
+    int fin = STDIN_FILENO;
+    res->filename = std::string("stdin");
+
+    // Compressed data is not written to a terminal unless forced, as gzip does
+    if(isatty(STDOUT_FILENO) && !args.force) {
+        std::cerr << KRED << "Compressed data not written to a terminal. Use '-f'/'--force' to force compression" << KNRM << std::endl;
+        return -1;
+    }
+
+    if(!args.fromStdin) {
+        fin = open(args.path.c_str(), O_RDONLY);
+        if (fin == -1) {
+            std::cerr << KRED << "fpga_gzip_pipe: Error: Opening input file [" << args.path << "]" << KNRM << std::endl;
+            return -1;
+        }
+        posix_fadvise(fin, 0, 0, POSIX_FADV_SEQUENTIAL);
+        res->filename = basename(args.path);
+    }
+
+    if(args.verbose)
+        std::cout << KBLU << "\nStarting GZip Hardware compression of [" << res->filename << "] to stdout ..." << KNRM << std::endl;
+
+    int retCode;
+    if(cpuFallback) {
+        res->engine = std::string("CPU");
+        retCode = cpu_gzip_fd_stream(fin, STDOUT_FILENO, args, res->hwBwMBps);
+    }
+    else
+        retCode = fpga_gzip_fd_stream(fin, STDOUT_FILENO, args, PIPE_IN_SLOTS, res->hwBwMBps);
+    if(!args.fromStdin)
+        close(fin);
+    if(retCode) {
+        metrics_add(METRIC_ERRORS, 1);
+        return retCode;
+    }
+    res->hwComprRatio = outfsize ? (double)infsize/(double)outfsize : -1.0;
+    count_compressed(infsize, outfsize);
+
+    // No archive file to check, no input file to compare with when reading stdin
+    if(args.verifyIntegrity && !args.quiet)
+        std::cerr << KYEL << "WARNING: integrity test is not available when writing to stdout" << KNRM << std::endl;
+    args.verifyIntegrity = false;
+    if(args.fromStdin)
+        args.OScompare = false;
+    return complete_file_results(args.path, "", args, res);
+}
+
+/**
+ * Daemon mode: the design stays open between jobs. Clients pass their input
+ * and output descriptors, the jobs are compressed one at a time in arrival
+ * order; a client only queues its next job once it has the previous reply,
+ * so the clients take turns on the device.
+ */
+void tWorker_daemon(PDaemonState pState)
+{
+    while(true) {
+        daemon_job_t job;
+        {
+            std::unique_lock<std::mutex> lock(pState->mtx);
+            pState->cv.wait(lock, [pState]{ return !pState->queue.empty() || pState->stop; });
+            if(pState->queue.empty())
+                return;
+            job = pState->queue.front();
+            pState->queue.pop_front();
+        }
+
+        gzip_args_t jobArgs = *pState->pArgs;
+        if(job.req.chunkSize > 0)
+            jobArgs.streamChunkSize = job.req.chunkSize;
+        jobArgs.verbose = false;
+
+        daemon_reply_t reply;
+        memset(&reply, 0, sizeof(reply));
+        double bwMBps;
+        chrono::time_point<std::chrono::steady_clock> start = chrono::steady_clock::now();
+        int retCode;
+        if(cpuFallback)
+            retCode = cpu_gzip_fd_stream(job.fdIn, job.fdOut, jobArgs, bwMBps);
+        else
+            retCode = fpga_gzip_fd_stream(job.fdIn, job.fdOut, jobArgs, jobArgs.ioBuffers, bwMBps);
+        chrono::time_point<std::chrono::steady_clock> end = chrono::steady_clock::now();
+        close(job.fdIn);
+        close(job.fdOut);
+
+        reply.status  = retCode ? DAEMON_ERR_COMPRESS : DAEMON_OK;
+        reply.cpu     = cpuFallback;
+        reply.inSize  = infsize;
+        reply.outSize = outfsize;
+        reply.secs    = getElapsedSecs(start, end);
+        if(retCode)
+            metrics_add(METRIC_ERRORS, 1);
+        else
+            count_compressed(infsize, outfsize);
+        if(pState->pArgs->verbose)
+            std::cout << KBLU << "Daemon job " << infsize << " -> " << outfsize << " bytes, " << bwMBps << " MB/s"
+                      << (retCode ? " FAILED" : "") << KNRM << std::endl;
+
+        // A client that went away is noticed by the main loop
+        daemon_send_reply(job.sock, reply);
+
+        std::lock_guard<std::mutex> lock(pState->mtx);
+        pState->served++;
+        pState->replied.push_back(job.sock);
+        uint64_t one = 1;
+        while(write(pState->wakeFd, &one, sizeof(one)) < 0 && errno == EINTR)
+            ;
+    }
+}
+
+int fpga_daemon(gzip_args_t args)
+{
+    int sock = daemon_listen(args.daemonPath);
+    if(sock < 0) {
+        std::cerr << KRED << "Error: unable to listen on [" << args.daemonPath << "]: " << strerror(errno) << KNRM << std::endl;
+        return -1;
+    }
+
+    // SIGINT and SIGTERM are blocked since startup, they stop the daemon
+    sigset_t stopSignals;
+    sigemptyset(&stopSignals);
+    sigaddset(&stopSignals, SIGINT);
+    sigaddset(&stopSignals, SIGTERM);
+    int sigFd = signalfd(-1, &stopSignals, SFD_CLOEXEC);
+
+    daemon_state_t state;
+    state.pArgs  = &args;
+    state.stop   = false;
+    state.served = 0;
+    state.wakeFd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if(sigFd < 0 || state.wakeFd < 0) {
+        std::cerr << KRED << "Error: unable to set the daemon up" << KNRM << std::endl;
+        if(sigFd >= 0)
+            close(sigFd);
+        if(state.wakeFd >= 0)
+            close(state.wakeFd);
+        close(sock);
+        unlink(args.daemonPath.c_str());
+        return -1;
+    }
+    if(!args.quiet)
+        std::cout << KBLU << "Daemon listening on [" << args.daemonPath << "], SIGINT or SIGTERM to stop" << KNRM << std::endl;
+
+    std::thread Worker_thread(tWorker_daemon, &state);
+
+    // Clients waiting for a reply are not polled, their next job can't be in yet
+    std::set<int> idle;
+    while(true) {
+        std::vector<struct pollfd> fds(3 + idle.size());
+        fds[0].fd = sigFd;
+        fds[1].fd = state.wakeFd;
+        fds[2].fd = sock;
+        size_t n = 3;
+        for(std::set<int>::iterator it=idle.begin(); it!=idle.end(); ++it)
+            fds[n++].fd = *it;
+        for(size_t i=0; i<fds.size(); i++) {
+            fds[i].events = POLLIN;
+            fds[i].revents = 0;
+        }
+        if(poll(&fds[0], fds.size(), -1) < 0) {
+            if(errno == EINTR)
+                continue;
+            break;
+        }
+        if(fds[0].revents)
+            break;
+
+        if(fds[1].revents) {
+            uint64_t count;
+            while(read(state.wakeFd, &count, sizeof(count)) < 0 && errno == EINTR)
+                ;
+            std::lock_guard<std::mutex> lock(state.mtx);
+            idle.insert(state.replied.begin(), state.replied.end());
+            state.replied.clear();
+        }
+
+        if(fds[2].revents & POLLIN) {
+            int client = accept4(sock, NULL, NULL, SOCK_CLOEXEC);
+            if(client >= 0)
+                idle.insert(client);
+        }
+
+        for(size_t i=3; i<fds.size(); i++) {
+            if(!fds[i].revents)
+                continue;
+            int client = fds[i].fd;
+            daemon_job_t job;
+            job.sock = client;
+            int ret = daemon_recv_job(client, job.req, job.fdIn, job.fdOut);
+            idle.erase(client);
+            if(ret) {
+                if(ret < 0) {
+                    daemon_reply_t reply;
+                    memset(&reply, 0, sizeof(reply));
+                    reply.status = DAEMON_ERR_REQUEST;
+                    daemon_send_reply(client, reply);
+                }
+                close(client);
+                continue;
+            }
+            std::lock_guard<std::mutex> lock(state.mtx);
+            state.queue.push_back(job);
+            state.cv.notify_all();
+        }
+    }
+
+    // Jobs already queued are still compressed and answered
+    {
+        std::lock_guard<std::mutex> lock(state.mtx);
+        state.stop = true;
+        state.cv.notify_all();
+    }
+    Worker_thread.join();
+    for(std::set<int>::iterator it=idle.begin(); it!=idle.end(); ++it)
+        close(*it);
+    for(size_t i=0; i<state.replied.size(); i++)
+        close(state.replied[i]);
+    close(sock);
+    unlink(args.daemonPath.c_str());
+    close(sigFd);
+    close(state.wakeFd);
+
+    if(!args.quiet)
+        std::cout << KBLU << "Daemon stopped after " << state.served << " job(s)" << KNRM << std::endl;
+    return 0;
+}
+
+/**
+ * Thin client: the CLI options, the compression done by a daemon. Nothing
+ * is opened on the board, input and output descriptors are handed over.
+ */
+int gzip_client_job(int sock, int fdIn, int fdOut, gzip_args_t & args, daemon_reply_t & reply)
+{
+    daemon_request_t req;
+    memset(&req, 0, sizeof(req));
+    req.magic = DAEMON_MAGIC;
+    req.chunkSize = args.streamChunkSize;
+    if(daemon_send_job(sock, req, fdIn, fdOut) || daemon_recv_reply(sock, reply)) {
+        std::cerr << KRED << "Error: connection to the daemon on [" << args.connectPath << "] lost" << KNRM << std::endl;
+        return -1;
+    }
+    if(reply.status != DAEMON_OK)
+        return -2;
+    return 0;
+}
+
+int gzip_client(gzip_args_t args)
+{
+    int sock = daemon_connect(args.connectPath);
+    if(sock < 0) {
+        std::cerr << KRED << "Error: unable to connect to a daemon on [" << args.connectPath << "]: " << strerror(errno) << KNRM << std::endl;
+        return -1;
+    }
+
+    int retCode = 0;
+    unsigned int nbFiles = 0;
+    long long int totalIn = 0, totalOut = 0;
+    double totalSecs = 0.0;
+    daemon_reply_t reply;
+
+    if(args.toStdout) {
+        // Compressed data is not written to a terminal unless forced, as gzip does
+        if(isatty(STDOUT_FILENO) && !args.force) {
+            std::cerr << KRED << "Compressed data not written to a terminal. Use '-f'/'--force' to force compression" << KNRM << std::endl;
+            close(sock);
+            return -1;
+        }
+        int fin = args.fromStdin ? STDIN_FILENO : open(args.path.c_str(), O_RDONLY);
+        if(fin == -1) {
+            std::cerr << KRED << "gzip_client: Error: Opening input file [" << args.path << "]" << KNRM << std::endl;
+            close(sock);
+            return -1;
+        }
+        retCode = gzip_client_job(sock, fin, STDOUT_FILENO, args, reply);
+        if(!args.fromStdin)
+            close(fin);
+        if(retCode == -2)
+            std::cerr << KRED << "Error: compression of [" << (args.fromStdin ? string("stdin") : args.path) << "] failed" << KNRM << std::endl;
+        if(!retCode) {
+            nbFiles++;
+            totalIn += reply.inSize;
+            totalOut += reply.outSize;
+            totalSecs += reply.secs;
+        }
+    }
+    else {
+        std::vector<string> files;
+        if(args.operateOnFolder) {
+            TreeWalker walker(args.walkThreads, args.includes, args.excludes);
+            walker.start(args.path);
+            walker.collect(files);
+        }
+        else
+            files.push_back(args.path);
+
+        for(size_t i=0; i<files.size() && !retCode; i++) {
+            string out_filename = files[i] + string(".gz");
+            if(!args.force && isFile(out_filename)) {
+                std::cerr << KRED << "File [" << out_filename << "] already exists. use '-f'/'--force' to overwrite existing files" << KNRM << std::endl;
+                retCode = -1;
+                break;
+            }
+            int fin = open(files[i].c_str(), O_RDONLY);
+            if(fin == -1) {
+                std::cerr << KRED << "gzip_client: Error: Opening input file [" << files[i] << "]" << KNRM << std::endl;
+                retCode = -1;
+                break;
+            }
+            int fout = open(out_filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC, S_IWRITE | S_IREAD);
+            if(fout == -1) {
+                std::cerr << KRED << "gzip_client: Error: Opening output file [" << out_filename << "]" << KNRM << std::endl;
+                close(fin);
+                retCode = -3;
+                break;
+            }
+            retCode = gzip_client_job(sock, fin, fout, args, reply);
+            close(fin);
+            close(fout);
+            if(retCode == -2)
+                std::cerr << KRED << "Error: compression of file [" << files[i] << "] failed" << KNRM << std::endl;
+            if(retCode)
+                break;
+            if(args.verifyIntegrity && checkArchive(files[i], out_filename, args.verbose))
+                retCode = -1;
+            if(args.verbose)
+                std::cout << KBLU << "Compressed [" << basename(files[i]) << "] " << reply.inSize << " -> " << reply.outSize
+                          << " bytes" << (reply.cpu ? " on the CPU" : "") << KNRM << std::endl;
+            nbFiles++;
+            totalIn += reply.inSize;
+            totalOut += reply.outSize;
+            totalSecs += reply.secs;
+        }
+    }
+    close(sock);
+
+    if(!args.quiet && nbFiles)
+        std::cout << KBLU << nbFiles << " file(s), " << totalIn << " -> " << totalOut << " bytes, "
+                  << (totalSecs > 0.0 ? totalIn/totalSecs/SIZE_1MB : 0.0) << " MB/s in the daemon" << KNRM << std::endl;
+    return retCode;
+}
+#endif
+
+/**
+ *  Give back the input buffer of fpga_gzip_file, leased or mapped
+ */
+void release_input_file(const gzip_args_t & args)
+{
+    if(args.ioDepth && bufferPool)
+        bufferPool->release(input_file);
+    else
+        munmap(input_file, infsize);
+}
+
+/**
+ * Entropy pre-scan of a file: an incompressible file is written as stored
+ * deflate blocks on the host. Nothing goes through the device and no room
+ * is reserved for an archive larger than the input. Returns 1 when the
+ * file is worth compressing, 0 once it is stored, a negative code on error.
+ */
+int store_incompressible_file(string in_filename, string out_filename, gzip_args_t args, file_results_t* res)
+{
+    long long int size = getFileSize(in_filename);
+    if(size < ENTROPY_WINDOW_SIZE)
+        return 1;
+
+    int fin = open(in_filename.c_str(), O_RDONLY);
+    if (fin == -1) {
+        std::cerr << KRED << "store_incompressible_file: Error: Opening input file [" << in_filename << "]" << KNRM << std::endl;
+        return -1;
+    }
+    // Not populated: the scan only faults the sampled pages in
+    const char *data = (const char *)mmap(NULL, size, PROT_READ, MAP_PRIVATE, fin, 0);
+    close(fin);
+    if (data == MAP_FAILED) {
+        std::cerr << KRED << "store_incompressible_file: Memory map error on input file [" << in_filename << "]" << KNRM << std::endl;
+        return -2;
+    }
+
+    entropy_stats_t stats;
+    bool incompressible = entropy_scan(data, size, stats);
+    if(args.verbose)
+        std::cout << KBLU << "Entropy pre-scan of [" << basename(in_filename) << "]: " << stats.bitsPerByte << " bits/byte, "
+                  << 100.0*stats.matchRate << "% matches over " << stats.windows << " window(s), "
+                  << (incompressible ? "stored on the host" : "compressing") << KNRM << std::endl;
+    if(!incompressible) {
+        munmap((void *)data, size);
+        return 1;
+    }
+    madvise((void *)data, size, MADV_SEQUENTIAL);
+
+    int fout = open(out_filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC, S_IWRITE | S_IREAD);
+    if (fout == -1) {
+        std::cerr << KRED << "store_incompressible_file: Error: Opening output file [" << out_filename << "]" << KNRM << std::endl;
+        munmap((void *)data, size);
+        return -3;
+    }
+
+    int retCode = 0;
+    std::string out;
+    gzip_write_header(out);
+    uint32_t crc = 0;
+    long long int done = 0, outSize = 0;
+    chrono::time_point<std::chrono::steady_clock> start = chrono::steady_clock::now();
+    while(done < size && !retCode) {
+        long long int len = std::min((long long int)STORE_CHUNK_SIZE, size - done);
+        crc = crc32_fast(crc, &data[done], len);
+        deflate_write_stored(out, &data[done], len, done + len == size);
+        done += len;
+        if(done == size)
+            gzip_write_trailer(out, crc, (uint32_t)size);
+        long long int written = 0;
+        while(written < (long long int)out.size()) {
+            ssize_t ret = write(fout, &out[written], out.size()-written);
+            if(ret < 0 && errno == EINTR)
+                continue;
+            if(ret < 0) {
+                std::cerr << KRED << "Error: Unable to write output file [" << out_filename << "] ret=" << ret << KNRM << std::endl;
+                retCode = -4;
+                break;
+            }
+            written += ret;
+        }
+        outSize += out.size();
+        out.clear();
+    }
+    std::chrono::time_point<std::chrono::steady_clock> end = std::chrono::steady_clock::now();
+    munmap((void *)data, size);
+    close(fout);
+    if(retCode)
+        return retCode;
+
+    res->engine = std::string("STORED");
+    res->hwBwMBps = getBandwidthMBps(start, end, size);
+    res->hwComprRatio = (double)size/(double)outSize;
+    count_compressed(size, outSize);
+    count_bypassed(size, outSize);
+    return 0;
+}
+
+/**
+ * Gzip Files in FPGA, multi-board mode
+ *
+ * Files, or chunks of large files, are spread over all opened boards by the
+ * BoardScheduler, each board taking the next item when it has a free slot.
+ * The files found by pWalker, when given, are queued after the listed ones
+ * while the boards already run. Per-board and aggregate throughputs are
+ * reported in a BOARDS table.
+ */
+int fpga_gzip_multiboard(TreeWalker *pWalker, std::vector<string> & files, gzip_args_t args, std::deque<file_results_t> & results)
+{
+    BoardScheduler scheduler(boards, BOARD_CHUNK_SIZE, BOARD_MAX_INFLIGHT, args.verifyIntegrity, args.entropyScan);
+    scheduler.start();
+
+    int retCode = 0;
+    size_t next = 0;
+    string in_filename;
+    while(true) {
+        if(next < files.size())
+            in_filename = files[next++];
+        else if(!pWalker || !pWalker->next(in_filename))
+            break;
+
+        board_file_t file;
+        file.in_filename = in_filename;
+        file.out_filename = in_filename + string(".gz");
+
+        // Test if file already exists
+        if(!args.force && isFile(file.out_filename)) {
+            std::cerr << KRED << "File [" << file.out_filename << "] already exists. use '-f'/'--force' to overwrite existing files" << KNRM << std::endl;
+            retCode = -1;
+            break;
+        }
+        scheduler.add(file);
+    }
+    if(retCode && pWalker)
+        pWalker->stop();
+    if(scheduler.finish())
+        retCode = -1;
+    std::deque<board_file_t> & boardFiles = scheduler.files();
+
+    // Round-trip tests spread over the verifier threads
+    if(verifier) {
+        for(size_t i=0; i<boardFiles.size(); i++)
+            if(!boardFiles[i].err && boardFiles[i].check == GZIP_CHECK_OK && verify_sampled(args))
+                verifier->submit(boardFiles[i].in_filename, boardFiles[i].out_filename, &boardFiles[i].check);
+        verifier->drain();
+    }
+
+    // Per-board and aggregate throughput
+    const std::vector<board_stats_t> & stats = scheduler.stats();
+    long long int totalIn = 0, totalOut = 0;
+    unsigned int totalItems = 0;
+    TextTable tableBoards( '-', '|', '+' );
+    tableBoards.setTitle("BOARDS (MB/s over each board active time)");
+    tableBoards.add( "Board" );
+    tableBoards.add( "Items" );
+    tableBoards.add( "MB in" );
+    tableBoards.add( "Ratio" );
+    tableBoards.add( "Time (s)" );
+    tableBoards.add( "MB/s" );
+    tableBoards.endOfRow();
+    for(size_t b=0; b<stats.size(); b++) {
+        tableBoards.add( std::to_string(b) );
+        tableBoards.add( stats[b].items );
+        tableBoards.add( (double)stats[b].inBytes/SIZE_1MB );
+        tableBoards.add( stats[b].outBytes ? (double)stats[b].inBytes/stats[b].outBytes : -1.0 );
+        tableBoards.add( stats[b].activeSecs );
+        tableBoards.add( stats[b].activeSecs > 0.0 ? stats[b].inBytes/stats[b].activeSecs/SIZE_1MB : -1.0 );
+        tableBoards.endOfRow();
+        totalIn += stats[b].inBytes;
+        totalOut += stats[b].outBytes;
+        totalItems += stats[b].items;
+        if(stats[b].storedItems)
+            count_bypassed(stats[b].storedInBytes, stats[b].storedOutBytes, stats[b].storedItems);
+    }
+    tableBoards.add( "All" );
+    tableBoards.add( totalItems );
+    tableBoards.add( (double)totalIn/SIZE_1MB );
+    tableBoards.add( totalOut ? (double)totalIn/totalOut : -1.0 );
+    tableBoards.add( scheduler.elapsedSecs() );
+    tableBoards.add( scheduler.elapsedSecs() > 0.0 ? totalIn/scheduler.elapsedSecs()/SIZE_1MB : -1.0 );
+    tableBoards.endOfRow();
+    std::cout << "\n" << tableBoards;
+
+    for(size_t i=0; i<boardFiles.size(); i++) {
+        board_file_t & file = boardFiles[i];
+        results.push_back(file_results_t());
+        file_results_t *res = &results.back();
+        res->filename = basename(file.in_filename);
+        if(file.err) {
+            metrics_add(METRIC_ERRORS, 1);
+            retCode = -1;
+            continue;
+        }
+        res->hwBwMBps = getBandwidthMBps(file.startTime, file.endTime, file.inSize);
+        res->hwComprRatio = file.outSize ? (double)file.inSize/(double)file.outSize : -1.0;
+        if(file.storedChunks == file.nbChunks)
+            res->engine = std::string("STORED");
+        count_compressed(file.inSize, file.outSize);
+        if(complete_file_results(file.in_filename, file.out_filename, args, res, file.check, verifier != NULL))
+            retCode = -1;
+    }
+    return retCode;
+}
+
+/**
+ *  Largest archive of size input bytes: incompressible data comes back in
+ *  stored blocks, a 5-byte header every 16 KB and a flush mark after each
+ *  engine block of 32 KB or more, well under 1/1024 of the input. Plus the
+ *  gzip header and trailer, and never less than MIN_FIFO_SIZE.
+ */
+long long int archive_size_max(long long int size)
+{
+    long long int maxSize = size + (size >> 10) + DEFLATE_STORED_HEADER + GZIP_HEADER_SIZE + GZIP_TRAILER_SIZE;
+    return (maxSize > MIN_FIFO_SIZE) ? maxSize : MIN_FIFO_SIZE;
+}
+
+/**
+ * Gzip File in FPGA
+ */
+int fpga_gzip_file(string in_filename, gzip_args_t args, file_results_t* res)
+{ 
+    int retCode=0;
+
+    // Compute out_filename
     string out_filename = in_filename + string(".gz");
     res->filename = basename(in_filename);
 
-    // Test if file already exists
-    if(!args.force && isFile(out_filename)) {
-        std::cerr << KRED << "File [" << out_filename << "] already exists. use '-f'/'--force' to overwrite existing files" << KNRM << std::endl;
-        return -1;
+    // Test if file already exists
+    if(!args.force && isFile(out_filename)) {
+        std::cerr << KRED << "File [" << out_filename << "] already exists. use '-f'/'--force' to overwrite existing files" << KNRM << std::endl;
+        return -1;
+    }
+
+    // Incompressible file: stored on the host. The members are scanned one
+    // by one in index and BGZF modes.
+    if(args.entropyScan && !args.indexMode && !args.bgzfMode) {
+        if((retCode = store_incompressible_file(in_filename, out_filename, args, res)) < 0)
+            return retCode;
+        if(!retCode)
+            return complete_file_results(in_filename, out_filename, args, res);
+    }
+
+    // No usable design: compress on the CPU, in members in index and BGZF modes
+    if(cpuFallback && !args.indexMode && !args.bgzfMode) {
+        if((retCode = cpu_gzip_file(in_filename, out_filename, args, res)) != 0)
+            return retCode;
+        return complete_file_results(in_filename, out_filename, args, res);
+    }
+
+    // Several boards: the chunks of the file are spread over them
+    if(boards.size() > 1 && !args.indexMode && !args.bgzfMode) {
+        std::vector<string> files(1, in_filename);
+        std::deque<file_results_t> results;
+        retCode = fpga_gzip_multiboard(NULL, files, args, results);
+        if(!results.empty())
+            *res = results.front();
+        return retCode;
+    }
+
+#ifdef SGDMAR
+    // Streaming mode: bounded memory, multi-member archive
+    if(args.streamMode) {
+        if((retCode = fpga_gzip_file_stream(in_filename, out_filename, args, res)) != 0)
+            return retCode;
+        return complete_file_results(in_filename, out_filename, args, res);
+    }
+#endif
+    
+    // Compute file sizes
+    infsize = getFileSize(in_filename);
+    outfsizeMAX = archive_size_max(infsize);    // Compressed file could be bigger than original one
+
+    if(args.verbose)
+        std::cout << KBLU << "\nStarting GZip Hardware compression of file [" << basename(in_filename) << "] " << getFileSizeStr(in_filename) << " ..." << KNRM << std::endl;
+
+    // Open input file
+	int fin = open(in_filename.c_str(),  O_RDONLY,  S_IREAD  );
+	if (fin == -1) {
+        std::cerr << KRED << "fpga_gzip_file: Error: Opening input file [" << in_filename << "]" << KNRM << std::endl;
+		return -1;
+	}
+
+    // Create output file, read back from the device straight into its pages
+	int fout = open(out_filename.c_str(),  O_RDWR | O_CREAT, S_IWRITE | S_IREAD  );
+	if (fout == -1) {
+        std::cerr << KRED << "fpga_gzip_file: Error: Opening output file [" << out_filename << "]" << KNRM << std::endl;
+        close(fin);
+		return -3;
+	}
+
+    // Input file: read ahead of the device into an anonymous buffer with
+    // asynchronous reads, or memory mapped and faulted in as it is sent
+    if(args.ioDepth && bufferPool)
+        input_file = infsize ? bufferPool->lease(infsize) : NULL;
+    else if(args.ioDepth)
+        input_file = (char *)mmap(NULL, infsize, PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANON, -1, 0);
+    else
+        input_file = (char *)mmap(NULL, infsize, PROT_READ, MAP_PRIVATE, fin, 0);
+    if (input_file == MAP_FAILED || !input_file) {
+        std::cerr << KRED << "fpga_gzip_file: Memory map error on input file [" << in_filename << "] exiting..." << KNRM << std::endl;
+        close(fin);
+        close(fout);
+	   return -2;
+	}
+
+    // Memory map output file: preallocated for the worst case, truncated to
+    // the archive size once written. No anonymous buffer, no copy. Only a
+    // file system without fallocate gets a sparse file: a full disk must
+    // fail here, not raise SIGBUS when the device output lands in the map.
+    int allocErr = posix_fallocate(fout, 0, outfsizeMAX);
+    if(allocErr == EOPNOTSUPP || allocErr == EINVAL)
+        allocErr = ftruncate(fout, outfsizeMAX) ? errno : 0;
+    if(allocErr) {
+        std::cerr << KRED << "fpga_gzip_file: Unable to allocate output file [" << out_filename << "] (" << strerror(allocErr) << ") exiting..." << KNRM << std::endl;
+        release_input_file(args);
+        close(fin);
+        close(fout);
+        return -2;
+    }
+	output_file = (char *)mmap(NULL, outfsizeMAX, PROT_READ|PROT_WRITE, MAP_SHARED, fout, 0);
+    if (output_file == MAP_FAILED) {
+        std::cerr << KRED << "fpga_gzip_file: Memory map error on output file [" << out_filename << "] exiting..." << KNRM << std::endl;
+        release_input_file(args);
+        close(fin);
+        close(fout);
+        return -2;
+	}
+
+    // Create Related Streams
+    QpStream data_in("file_in", 3);
+    QpStream data_out("archive_out", 3);
+
+#ifdef SGDMA
+    // Enable stream option
+    dev1.qpEnableStreamOptions(data_in);
+    dev1.qpEnableStreamOptions(data_out);
+
+    // Create and configure stream interrupt structure
+    TPCIeStreamInterrupt streamIntParam;
+    streamIntParam.intEnable = true;
+    streamIntParam.userIrqHandler = NULL;
+
+    /* Configure stream mode */
+    data_in.setFifoSize(PCIE_FIFO_SIZE); 
+    data_in.setStreamOption("streamMode", PCIE_STREAM_SGDMA);
+    data_in.setStreamOption("streamIntParam", streamIntParam);
+    data_out.setFifoSize(PCIE_FIFO_SIZE);
+    data_out.setStreamOption("streamMode", PCIE_STREAM_SGDMA);
+    data_out.setStreamOption("streamIntParam", streamIntParam);
+#endif
+
+    // Open Related Streams 
+    int openErr = 0;
+    if (dev1.qpOpenStream(data_in)) {
+	    std::cerr << KRED << " => Call OpenStream failed for QpStream data_in. (size=" << (infsize>MIN_FIFO_SIZE?infsize:MIN_FIFO_SIZE) << " bytes)" << KNRM << std::endl;
+	    openErr = -1;
+    }
+    else if (dev1.qpOpenStream(data_out)) {
+	    std::cerr << KRED << " => Call OpenStream failed for QpStream data_out. (size=" << (outfsizeMAX>MIN_FIFO_SIZE?outfsizeMAX:MIN_FIFO_SIZE) << " bytes)" << KNRM << std::endl;
+	    dev1.qpCloseStream(data_in);
+	    openErr = -1;
+    }
+    if (openErr) {
+        release_input_file(args);
+        munmap(output_file, outfsizeMAX);
+        close(fin);
+        close(fout);
+        return openErr;
+    }
+
+    // Input read ahead only once nothing can fail before the threads join
+    prefetch_params_t prefetch_cfg;
+    std::thread Prefetch_thread;
+    if(args.ioDepth) {
+        prefetch_cfg.fd = fin;
+        prefetch_cfg.pBuffer = input_file;
+        prefetch_cfg.size = infsize;
+        prefetch_cfg.ioDepth = args.ioDepth;
+        prefetch_cfg.ready = 0;
+        prefetch_cfg.err = 0;
+        Prefetch_thread = std::thread(tPrefetch_input, &prefetch_cfg);
+    }
+    else
+		close(fin);
+
+    // ############################### 1rst run : 1 loop, Compression ratio comparison
+
+    // Configure Producer, Consumer Thread
+    thread_params_t prod_thread_cfg, cons_thread_cfg;
+    prod_thread_cfg.pStream=&data_in;
+    prod_thread_cfg.pBuffer=input_file;
+    prod_thread_cfg.pPrefetch=args.ioDepth ? &prefetch_cfg : NULL;
+    prod_thread_cfg.reqTransfSize=infsize;
+    prod_thread_cfg.loopCnt=1;
+    cons_thread_cfg.pStream=&data_out;
+    cons_thread_cfg.pBuffer=output_file;
+    cons_thread_cfg.reqTransfSize=outfsizeMAX;
+    cons_thread_cfg.loopCnt=prod_thread_cfg.loopCnt;
+
+    // Create two thread for read and write process
+    metrics_gauge_add(METRIC_QUEUE_DEPTH, 1);
+#ifdef SGDMA
+    std::thread Consumer_thread(tConsumer_SGDMA, &cons_thread_cfg);
+    std::thread Producer_thread(tProducer_SGDMA, &prod_thread_cfg);
+#endif
+#ifdef SGDMAR
+    std::thread Consumer_thread(tConsumer_SGDMAR, &cons_thread_cfg);
+    std::thread Producer_thread(tProducer_SGDMAR, &prod_thread_cfg);
+#endif
+
+    // Integrity test: CRC32 of the input while the device reads it
+    verify_params_t verify_cfg;
+    verify_cfg.pBuffer=input_file;
+    verify_cfg.size=infsize;
+    verify_cfg.pPrefetch=prod_thread_cfg.pPrefetch;
+    std::thread Verifier_thread;
+    if(args.verifyIntegrity)
+        Verifier_thread = std::thread(tVerifier_crc, &verify_cfg);
+
+    // Wait for the two thread end
+    Consumer_thread.join();
+	Producer_thread.join();
+    metrics_gauge_add(METRIC_QUEUE_DEPTH, -1);
+
+    // Check the trailer emitted by the IP against the input
+    int inlineCheck = GZIP_CHECK_NONE;
+    if(Verifier_thread.joinable()) {
+        Verifier_thread.join();
+        inlineCheck = gzip_check_member(output_file, outfsize, verify_cfg.crc, infsize);
+    }
+
+    if(Prefetch_thread.joinable()) {
+        Prefetch_thread.join();
+        close(fin);
+        if(prefetch_cfg.err)
+            std::cerr << KRED << "fpga_gzip_file: Error: Reading input file [" << in_filename << "]" << KNRM << std::endl;
+    }
+    if((args.ioDepth && prefetch_cfg.err) || cons_thread_cfg.err) {
+        dev1.qpCloseStream(data_in);
+        dev1.qpCloseStream(data_out);
+        release_input_file(args);
+        munmap(output_file, outfsizeMAX);
+        close(fout);
+        unlink(out_filename.c_str());
+        return -1;
+    }
+
+    // Save Compression Result, the archive is already in the output file pages
+    long long int archiveSize = outfsize;
+    res->hwComprRatio = (double)infsize/(double)outfsize;
+    count_compressed(infsize, outfsize);
+
+    // ############################### 2nd run : 100 loop, Bandwidth comparison
+    // Configure Producer, Consumer Thread
+    prod_thread_cfg.pStream=&data_in;
+    prod_thread_cfg.pBuffer=input_file;
+    prod_thread_cfg.pPrefetch=NULL;
+    prod_thread_cfg.reqTransfSize=infsize;
+    prod_thread_cfg.loopCnt=BW_TEST_ITERATION_CNT;
+    cons_thread_cfg.pStream=&data_out;
+    cons_thread_cfg.pBuffer=output_file;
+    cons_thread_cfg.reqTransfSize=outfsizeMAX;
+    cons_thread_cfg.loopCnt=prod_thread_cfg.loopCnt;
+
+    // Start Time Measurement
+    chrono::time_point<std::chrono::steady_clock> start100 = chrono::steady_clock::now();
+
+// Create two thread for read and write process
+#ifdef SGDMA
+    std::thread Consumer_thread100(tConsumer_SGDMA, &cons_thread_cfg);
+    std::thread Producer_thread100(tProducer_SGDMA, &prod_thread_cfg);
+#endif
+#ifdef SGDMAR
+    std::thread Consumer_thread100(tConsumer_SGDMAR, &cons_thread_cfg);
+    std::thread Producer_thread100(tProducer_SGDMAR, &prod_thread_cfg);
+#endif
+
+    // Wait for the two thread end
+    Consumer_thread100.join();
+	Producer_thread100.join();
+
+    // Stop Time Measurement
+    std::chrono::time_point<std::chrono::steady_clock> end100 = std::chrono::steady_clock::now();
+
+    // Compute Bandwidth
+    res->hwBwMBps = getBandwidthMBps(start100, end100, (unsigned long)infsize*prod_thread_cfg.loopCnt);
+
+    // ####################
+
+    // Close the streams
+    dev1.qpCloseStream(data_in);
+    dev1.qpCloseStream(data_out);
+
+	// Clear resources
+    release_input_file(args);
+    munmap(output_file, outfsizeMAX);
+    if(cons_thread_cfg.err) {
+        // The runs rewrite the archive in place: a failed one leaves it corrupt
+        close(fout);
+        unlink(out_filename.c_str());
+        return -1;
+    }
+    if(ftruncate(fout, archiveSize)) {
+        std::cerr << KRED << "Error: Unable to write output file [" << out_filename << "]" << KNRM << std::endl;
+        close(fout);
+        return -4;
+    }
+    close(fout);
+
+    // Round-trip test of the final archive
+    bool inflateDone = (verifier != NULL);
+    if(verifier && inlineCheck == GZIP_CHECK_OK && verify_sampled(args)) {
+        verifier->submit(in_filename, out_filename, &inlineCheck);
+        verifier->drain();
+    }
+    return complete_file_results(in_filename, out_filename, args, res, inlineCheck, inflateDone);
+}
+
+/**
+ *  Grow a session buffer to at least size bytes
+ */
+int reserve_session_buffer(char* & buffer, long long int & capacity, long long int size)
+{
+    if(size <= capacity)
+        return 0;
+    long long int newCapacity = capacity ? capacity : SIZE_1MB;
+    while(newCapacity < size)
+        newCapacity *= 2;
+    char *newBuffer;
+    if(bufferPool) {
+        if(!(newBuffer = bufferPool->lease(newCapacity)))
+            return -1;
+        if(buffer)
+            memcpy(newBuffer, buffer, capacity);
+        bufferPool->release(buffer);
+    }
+    else if(!(newBuffer = (char *)realloc(buffer, newCapacity)))
+        return -1;
+    buffer = newBuffer;
+    capacity = newCapacity;
+    return 0;
+}
+
+/**
+ *  Give a session buffer back
+ */
+void release_session_buffer(char *buffer)
+{
+    if(bufferPool)
+        bufferPool->release(buffer);
+    else
+        free(buffer);
+}
+
+/**
+ *  Read a whole file into a session slot
+ */
+int load_session_slot(session_slot_t *slot)
+{
+    int fin = open(slot->in_filename.c_str(), O_RDONLY);
+    if (fin == -1) {
+        std::cerr << KRED << "load_session_slot: Error: Opening input file [" << slot->in_filename << "]" << KNRM << std::endl;
+        return -1;
+    }
+
+    struct stat st;
+    fstat(fin, &st);
+    long long int size = st.st_size;
+    if(reserve_session_buffer(slot->inBuffer, slot->inCapacity, size ? size : 1) ||
+       reserve_session_buffer(slot->outBuffer, slot->outCapacity, 2*size + SESSION_OUT_MARGIN)) {
+        std::cerr << KRED << "load_session_slot: Unable to allocate buffers for [" << slot->in_filename << "]" << KNRM << std::endl;
+        close(fin);
+        return -2;
+    }
+
+    long long int done = 0;
+    while(done < size) {
+        ssize_t ret = read(fin, &slot->inBuffer[done], size-done);
+        if(ret < 0 && errno == EINTR)
+            continue;
+        if(ret <= 0) {
+            std::cerr << KRED << "load_session_slot: Error: Reading input file [" << slot->in_filename << "]" << KNRM << std::endl;
+            close(fin);
+            return -1;
+        }
+        done += ret;
+    }
+    close(fin);
+
+    slot->job.inBuffer    = slot->inBuffer;
+    slot->job.inSize      = size;
+    slot->job.nbParts     = 0;
+    slot->job.outBuffer   = slot->outBuffer;
+    slot->job.outCapacity = slot->outCapacity;
+    slot->job.user        = slot;
+    return 0;
+}
+
+/**
+ *  Write a completed session job out and fill its FPGA results
+ */
+int persist_session_slot(session_slot_t *slot)
+{
+    file_results_t *res = slot->res;
+
+    if(slot->job.err) {
+        std::cerr << KRED << "Error: FPGA compression of file [" << slot->in_filename << "] failed (" << slot->job.err << ")" << KNRM << std::endl;
+        return -1;
+    }
+
+    int fout = open(slot->out_filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC, S_IWRITE | S_IREAD);
+    if (fout == -1) {
+        std::cerr << KRED << "persist_session_slot: Error: Opening output file [" << slot->out_filename << "]" << KNRM << std::endl;
+        return -3;
+    }
+    long long int written=0;
+    while(written < slot->job.outSize) {
+        ssize_t ret = write(fout, &slot->outBuffer[written], slot->job.outSize-written);
+        if(ret < 0 && errno == EINTR)
+            continue;
+        if(ret<0) {
+            std::cerr << KRED << "Error: Unable to write output file [" << slot->out_filename << "] ret=" << ret << KNRM << std::endl;
+            close(fout);
+            return -4;
+        }
+        written += ret;
+    }
+    close(fout);
+
+    // Device latency based figures: the file shares the streams with its neighbours
+    res->hwBwMBps = getBandwidthMBps(slot->job.submitTime, slot->job.completeTime, slot->job.inSize);
+    res->hwComprRatio = slot->job.outSize ? (double)slot->job.inSize/(double)slot->job.outSize : -1.0;
+    count_compressed(slot->job.inSize, slot->job.outSize);
+    return 0;
+}
+
+/**
+ *  Hybrid mode: engine expected to finish a job of size bytes first, the
+ *  work already queued on each engine included. While one engine has not
+ *  run a job of this size yet, jobs alternate between the engines.
+ */
+int route_pipeline_job(PPipelineJob pJob, long long int size, double & estSecs)
+{
+    CostModel & model = *pJob->pCostModel;
+    unsigned int b = CostModel::bucket(size);
+    double fpgaSecs = model.estimate(COST_ENGINE_FPGA, size);
+    double cpuSecs  = model.estimate(COST_ENGINE_CPU, size);
+
+    std::lock_guard<std::mutex> lock(pJob->mtx);
+    int engine;
+    if(!model.samples(COST_ENGINE_FPGA, b) || !model.samples(COST_ENGINE_CPU, b))
+        engine = (pJob->routed[COST_ENGINE_CPU][b] < pJob->routed[COST_ENGINE_FPGA][b]) ? COST_ENGINE_CPU : COST_ENGINE_FPGA;
+    else {
+        // The device runs one job at a time, the CPU engine one per thread
+        double fpgaFinish = pJob->fpgaBacklogSecs + fpgaSecs;
+        double cpuFinish  = pJob->cpuBacklogSecs/pJob->nbCpuWorkers + cpuSecs;
+        engine = (cpuFinish < fpgaFinish) ? COST_ENGINE_CPU : COST_ENGINE_FPGA;
+    }
+    estSecs = (engine == COST_ENGINE_CPU) ? cpuSecs : fpgaSecs;
+    if(engine == COST_ENGINE_CPU)
+        pJob->cpuBacklogSecs += estSecs;
+    else
+        pJob->fpgaBacklogSecs += estSecs;
+    pJob->routed[engine][b]++;
+    return engine;
+}
+
+/**
+ *  Write out a compressed file, test it and give its slot back
+ */
+void finish_pipeline_slot(PPipelineJob pJob, session_slot_t *slot, int engine)
+{
+    session_job_t *job = &slot->job;
+    if(persist_session_slot(slot)) {
+        metrics_add(METRIC_ERRORS, 1);
+        pJob->err = -1;
+    }
+    else if(pJob->pArgs->verifyIntegrity) {
+        *slot->check = gzip_check_member(slot->outBuffer, job->outSize, slot->crc, job->inSize);
+        // Round-trip test from the written archive, the slot is free to go
+        if(*slot->check == GZIP_CHECK_OK && verifier && verify_sampled(*pJob->pArgs))
+            verifier->submit(slot->in_filename, slot->out_filename, slot->check);
+    }
+
+    std::lock_guard<std::mutex> lock(pJob->mtx);
+    pJob->totalIn += job->inSize;
+    pJob->totalOut += job->outSize;
+    if(engine == COST_ENGINE_CPU) {
+        pJob->cpuDone++;
+        pJob->cpuBacklogSecs -= slot->estSecs;
+    }
+    else {
+        pJob->persisted++;
+        pJob->fpgaBacklogSecs -= slot->estSecs;
+    }
+    pJob->freeSlots.push_back(slot);
+    pJob->cv.notify_all();
+}
+
+/**
+ *  Write a file the entropy pre-scan found incompressible as stored blocks,
+ *  on the CPU engine side of the counts
+ */
+void store_pipeline_slot(PPipelineJob pJob, session_slot_t *slot)
+{
+    session_job_t *job = &slot->job;
+    std::string out;
+    slot->res->engine = std::string("STORED");
+    job->submitTime = chrono::steady_clock::now();
+    slot->crc = crc32_fast(0, slot->inBuffer, job->inSize);
+    sw_gzip_stored(slot->inBuffer, job->inSize, slot->crc, out);
+    memcpy(slot->outBuffer, out.data(), out.size());
+    job->outSize = out.size();
+    job->err = 0;
+    job->completeTime = chrono::steady_clock::now();
+    count_bypassed(job->inSize, job->outSize);
+    finish_pipeline_slot(pJob, slot, COST_ENGINE_CPU);
+}
+
+/**
+ *  Pipeline stage 1: read files into free slots and submit them
+ */
+void tStager_pipeline(PPipelineJob pJob)
+{
+    gzip_args_t & args = *pJob->pArgs;
+    string in_filename;
+
+    // Files come in while the tree is still being walked
+    while(!pJob->err && pJob->pWalker->next(in_filename)) {
+        string out_filename = in_filename + string(".gz");
+
+        // Test if file already exists
+        if(!args.force && isFile(out_filename)) {
+            std::cerr << KRED << "File [" << out_filename << "] already exists. use '-f'/'--force' to overwrite existing files" << KNRM << std::endl;
+            pJob->err = -1;
+            break;
+        }
+
+        session_slot_t *slot;
+        {
+            std::unique_lock<std::mutex> lock(pJob->mtx);
+            pJob->cv.wait(lock, [pJob]{ return !pJob->freeSlots.empty() || pJob->err; });
+            if(pJob->err)
+                break;
+            slot = pJob->freeSlots.back();
+            pJob->freeSlots.pop_back();
+        }
+
+        // Only this thread grows the deques, the persister uses stable references
+        pJob->files.push_back(in_filename);
+        pJob->results.push_back(file_results_t());
+        pJob->checks.push_back(GZIP_CHECK_NONE);
+        slot->in_filename  = in_filename;
+        slot->out_filename = out_filename;
+        slot->res          = &pJob->results.back();
+        slot->check        = &pJob->checks.back();
+        slot->res->filename = basename(in_filename);
+        if(args.verbose)
+            std::cout << KBLU << "Queuing file [" << slot->res->filename << "] " << getFileSizeStr(in_filename) << " ..." << KNRM << std::endl;
+        if(load_session_slot(slot)) {
+            metrics_add(METRIC_ERRORS, 1);
+            pJob->err = -1;
+            break;
+        }
+
+        // Incompressible file: stored on the host, it never reaches an engine
+        slot->estSecs = 0.0;
+        entropy_stats_t stats;
+        if(args.entropyScan && entropy_scan(slot->inBuffer, slot->job.inSize, stats)) {
+            if(args.verbose)
+                std::cout << KBLU << "File [" << slot->res->filename << "]: " << stats.bitsPerByte << " bits/byte, stored on the host" << KNRM << std::endl;
+            store_pipeline_slot(pJob, slot);
+            continue;
+        }
+
+        // Hybrid mode: the CPU engine takes the file if it should finish it first
+        if(pJob->pCostModel && route_pipeline_job(pJob, slot->job.inSize, slot->estSecs) == COST_ENGINE_CPU) {
+            slot->res->engine = std::string("CPU");
+            std::lock_guard<std::mutex> lock(pJob->mtx);
+            pJob->cpuQueue.push_back(slot);
+            pJob->cv.notify_all();
+            continue;
+        }
+        slot->res->engine = std::string("FPGA");
+        pJob->pSession->submit(&slot->job);
+
+        // Integrity test: CRC32 of the input while the device reads it. The
+        // persister only retrieves this file once it is counted as submitted.
+        if(args.verifyIntegrity)
+            slot->crc = crc32_fast(0, slot->inBuffer, slot->job.inSize);
+
+        std::lock_guard<std::mutex> lock(pJob->mtx);
+        pJob->submitted++;
+        pJob->cv.notify_all();
     }
-    
-    // Compute file sizes
-    infsize = getFileSize(in_filename);
-    outfsizeMAX = 2*infsize;    // Compressed file could be bigger than original one
+    if(pJob->err)
+        pJob->pWalker->stop();
 
-    if(args.verbose)
-        std::cout << KBLU << "\nStarting GZip Hardware compression of file [" << basename(in_filename) << "] " << getFileSizeStr(in_filename) << " ..." << KNRM << std::endl;
+    std::lock_guard<std::mutex> lock(pJob->mtx);
+    pJob->stageDone = true;
+    pJob->cv.notify_all();
+}
 
-    // Open input file
-	int fin = open(in_filename.c_str(),  O_RDONLY,  S_IREAD  );
-	if (fin == -1) {
-        std::cerr << KRED << "fpga_gzip_file: Error: Opening input file [" << in_filename << "]" << KNRM << std::endl;
-		return -1;
-	}
+/**
+ *  Pipeline stage 3: write out compressed files, give their slots back
+ */
+void tPersister_pipeline(PPipelineJob pJob)
+{
+    while(true) {
+        {
+            std::unique_lock<std::mutex> lock(pJob->mtx);
+            pJob->cv.wait(lock, [pJob]{ return pJob->submitted > pJob->persisted || pJob->stageDone; });
+            if(pJob->submitted == pJob->persisted)
+                return;
+        }
 
-    // Create output file
-	int fout = open(out_filename.c_str(),  O_WRONLY | O_CREAT, S_IWRITE | S_IREAD  );
-	if (fout == -1) {
-        std::cerr << KRED << "fpga_gzip_file: Error: Opening output file [" << out_filename << "]" << KNRM << std::endl;
-		return -3;
-	}
+        session_job_t *job = pJob->pSession->getCompleted(true);
+        session_slot_t *slot = (session_slot_t *)job->user;
 
-	// Memory map input file
-	input_file = (char *)mmap(NULL, infsize, PROT_READ, MAP_PRIVATE, fin, 0);
-    if (input_file == MAP_FAILED) {
-        std::cerr << KRED << "fpga_gzip_file: Memory map error on input file [" << in_filename << "] exiting..." << KNRM << std::endl;
-	   return -2;
-	} else
-		close(fin);
+        // Device time of the job, without its wait behind the previous ones
+        if(pJob->pCostModel && !job->err) {
+            chrono::time_point<std::chrono::steady_clock> start = job->submitTime;
+            if(pJob->lastFpgaComplete > start)
+                start = pJob->lastFpgaComplete;
+            pJob->pCostModel->record(COST_ENGINE_FPGA, job->inSize, getElapsedSecs(start, job->completeTime));
+            pJob->lastFpgaComplete = job->completeTime;
+        }
+        finish_pipeline_slot(pJob, slot, COST_ENGINE_FPGA);
+    }
+}
 
-    // Memory map output file (allocate)
-	output_file = (char *)mmap(NULL, outfsizeMAX, PROT_WRITE, MAP_PRIVATE|MAP_ANON, -1, 0);
-    if (output_file == MAP_FAILED) {
-        std::cerr << KRED << "fpga_gzip_file: Memory map error on output file [" << out_filename << "] exiting..." << KNRM << std::endl;
+/**
+ *  Hybrid mode CPU engine: deflate the files routed to the CPU, one per thread
+ */
+void tCpu_pipeline(PPipelineJob pJob)
+{
+    std::string out;
+    while(true) {
+        session_slot_t *slot;
+        {
+            std::unique_lock<std::mutex> lock(pJob->mtx);
+            pJob->cv.wait(lock, [pJob]{ return !pJob->cpuQueue.empty() || pJob->stageDone; });
+            if(pJob->cpuQueue.empty())
+                return;
+            slot = pJob->cpuQueue.front();
+            pJob->cpuQueue.pop_front();
+        }
+
+        session_job_t *job = &slot->job;
+        out.clear();
+        job->submitTime = chrono::steady_clock::now();
+        job->err = sw_gzip_buffer(job->inBuffer, job->inSize, CPU_ENGINE_LEVEL, 1, out);
+        job->completeTime = chrono::steady_clock::now();
+        if(!job->err) {
+            memcpy(slot->outBuffer, out.data(), out.size());
+            job->outSize = out.size();
+            pJob->pCostModel->record(COST_ENGINE_CPU, job->inSize, getElapsedSecs(job->submitTime, job->completeTime));
+        }
+        if(pJob->pArgs->verifyIntegrity)
+            slot->crc = crc32_fast(0, slot->inBuffer, job->inSize);
+        finish_pipeline_slot(pJob, slot, COST_ENGINE_CPU);
+    }
+}
+
+/**
+ *  Print where the hybrid dispatcher sent the files, per size bucket
+ */
+void show_hybrid_dispatch(PPipelineJob pJob)
+{
+    CostModel & model = *pJob->pCostModel;
+    TextTable tableHybrid( '-', '|', '+' );
+    tableHybrid.setTitle("HYBRID DISPATCH (job times are moving averages)");
+    tableHybrid.add( "Size" );
+    tableHybrid.add( "FPGA files" );
+    tableHybrid.add( "CPU files" );
+    tableHybrid.add( "FPGA ms/job" );
+    tableHybrid.add( "CPU ms/job" );
+    tableHybrid.endOfRow();
+    for(unsigned int b=0; b<COST_NB_BUCKETS; b++) {
+        if(!pJob->routed[COST_ENGINE_FPGA][b] && !pJob->routed[COST_ENGINE_CPU][b])
+            continue;
+        long long int size = 1LL << b;
+        if(size < SIZE_1KB)
+            tableHybrid.add( std::to_string(size) + string(" B+") );
+        else if(size < SIZE_1MB)
+            tableHybrid.add( std::to_string(size/SIZE_1KB) + string(" KB+") );
+        else
+            tableHybrid.add( std::to_string(size/SIZE_1MB) + string(" MB+") );
+        tableHybrid.add( pJob->routed[COST_ENGINE_FPGA][b] );
+        tableHybrid.add( pJob->routed[COST_ENGINE_CPU][b] );
+        tableHybrid.add( model.samples(COST_ENGINE_FPGA, b) ? model.secs(COST_ENGINE_FPGA, b)*1000.0 : -1.0 );
+        tableHybrid.add( model.samples(COST_ENGINE_CPU, b) ? model.secs(COST_ENGINE_CPU, b)*1000.0 : -1.0 );
+        tableHybrid.endOfRow();
+    }
+    std::cout << "\n" << tableHybrid;
+}
+
+/**
+ *  Buffer pool statistics
+ */
+void show_buffer_pool(void)
+{
+    buffer_pool_stats_t stats = bufferPool->stats();
+    if(!stats.hits && !stats.misses)
+        return;
+
+    TextTable tablePool( '-', '|', '+' );
+    tablePool.setTitle("BUFFER POOL");
+    tablePool.add( "Pool MB" );
+    tablePool.add( "Pages" );
+    tablePool.add( "Pinned" );
+    tablePool.add( "Hits" );
+    tablePool.add( "Misses" );
+    tablePool.add( "Peak MB" );
+    tablePool.add( "Miss MB" );
+    tablePool.endOfRow();
+    tablePool.add( (double)stats.poolSize/SIZE_1MB );
+    if(stats.pageSize >= SIZE_1GB)
+        tablePool.add( std::to_string(stats.pageSize/SIZE_1GB) + string(" GB") );
+    else if(stats.pageSize >= SIZE_1MB)
+        tablePool.add( std::to_string(stats.pageSize/SIZE_1MB) + string(" MB") );
+    else
+        tablePool.add( std::to_string(stats.pageSize/SIZE_1KB) + string(" KB") );
+    tablePool.add( stats.pinned ? "yes" : "no" );
+    tablePool.add( (unsigned int)stats.hits );
+    tablePool.add( (unsigned int)stats.misses );
+    tablePool.add( (double)stats.peakInUse/SIZE_1MB );
+    tablePool.add( (double)stats.missBytes/SIZE_1MB );
+    tablePool.endOfRow();
+    std::cout << "\n" << tablePool;
+}
+
+/**
+ * Gzip Folder in FPGA, pipelined
+ *
+ * Staging file N+1 (read), compressing file N (device) and persisting file
+ * N-1 (write) overlap: a stager thread loads files into free slots and
+ * submits them to a GzipSession, which keeps the streams open and sends
+ * the files back-to-back as EOP packets, while a persister thread writes
+ * completed archives out and recycles their slots. PIPELINE_SLOTS bounds
+ * the number of files in flight across the three stages. Files are staged
+ * as the walker finds them. In hybrid mode, CPU threads also compress the
+ * files that the cost model expects them to finish before the device.
+ * Integrity tests and OS comparisons run once the pipeline has drained.
+ */
+int fpga_gzip_folder_pipeline(TreeWalker & walker, gzip_args_t args, file_results_t* & resTable, unsigned int & resTableSize)
+{
+    // Hybrid mode: one more slot per CPU engine thread
+    unsigned int nbCpuWorkers = args.hybridMode ? (args.swThreads ? args.swThreads : 1) : 0;
+    std::vector<session_slot_t> slots(PIPELINE_SLOTS + nbCpuWorkers);
+    pipeline_job_t pipeJob;
+    for(size_t i=0; i<slots.size(); i++) {
+        slots[i].inBuffer = NULL;
+        slots[i].inCapacity = 0;
+        slots[i].outBuffer = NULL;
+        slots[i].outCapacity = 0;
+        pipeJob.freeSlots.push_back(&slots[i]);
+    }
+
+    GzipSession session(dev1, SESSION_MAX_INFLIGHT);
+    if(session.open())
+        return -1;
+
+    pipeJob.pSession  = &session;
+    pipeJob.pWalker   = &walker;
+    pipeJob.pArgs     = &args;
+    pipeJob.submitted = 0;
+    pipeJob.persisted = 0;
+    pipeJob.stageDone = false;
+    pipeJob.totalIn   = 0;
+    pipeJob.totalOut  = 0;
+    pipeJob.err       = 0;
+    CostModel costModel;
+    pipeJob.pCostModel      = args.hybridMode ? &costModel : NULL;
+    pipeJob.nbCpuWorkers    = nbCpuWorkers;
+    pipeJob.cpuDone         = 0;
+    pipeJob.fpgaBacklogSecs = 0.0;
+    pipeJob.cpuBacklogSecs  = 0.0;
+    for(int e=0; e<COST_NB_ENGINES; e++)
+        for(int b=0; b<COST_NB_BUCKETS; b++)
+            pipeJob.routed[e][b] = 0;
+
+    chrono::time_point<std::chrono::steady_clock> start = chrono::steady_clock::now();
+    pipeJob.lastFpgaComplete = start;
+    std::thread stager_thread(tStager_pipeline, &pipeJob);
+    std::thread persister_thread(tPersister_pipeline, &pipeJob);
+    std::vector<std::thread> cpu_threads;
+    for(unsigned int i=0; i<nbCpuWorkers; i++)
+        cpu_threads.push_back(std::thread(tCpu_pipeline, &pipeJob));
+    stager_thread.join();
+    persister_thread.join();
+    for(size_t i=0; i<cpu_threads.size(); i++)
+        cpu_threads[i].join();
+    std::chrono::time_point<std::chrono::steady_clock> end = std::chrono::steady_clock::now();
+    session.close();
+
+    if(verifier)
+        verifier->drain();
+    if(pipeJob.pCostModel && !args.quiet)
+        show_hybrid_dispatch(&pipeJob);
+    resTableSize = pipeJob.persisted + pipeJob.cpuDone;
+    resTable = new file_results_t[resTableSize ? resTableSize : 1];
+    for(unsigned int i=0; i<resTableSize; i++)
+        resTable[i] = pipeJob.results[i];
+    int retCode = pipeJob.err;
+    double elapsed = getElapsedSecs(start, end);
+    if(!retCode && !args.quiet)
+        std::cout << KBLU << "Pipeline: " << resTableSize << " files, " << pipeJob.totalIn << " -> " << pipeJob.totalOut << " bytes in "
+                  << elapsed << " s (" << (resTableSize/elapsed) << " files/s, " << getBandwidthMBps(start, end, pipeJob.totalIn)
+                  << " MB/s end-to-end)" << KNRM << std::endl;
+
+    for(size_t i=0; i<slots.size(); i++) {
+        release_session_buffer(slots[i].inBuffer);
+        release_session_buffer(slots[i].outBuffer);
+    }
+
+    // Integrity tests and OS comparisons, out of the timed pipeline
+    for(unsigned int i=0; i<resTableSize && !retCode; i++)
+        if(complete_file_results(pipeJob.files[i], pipeJob.files[i] + string(".gz"), args, &resTable[i], pipeJob.checks[i], verifier != NULL))
+            retCode = -1;
+    return retCode;
+}
+
+/**
+ *  Read a file at the end of a batch buffer
+ */
+int append_batch_file(batch_slot_t *batch, string in_filename, long long int size)
+{
+    int fin = open(in_filename.c_str(), O_RDONLY);
+    if (fin == -1) {
+        std::cerr << KRED << "append_batch_file: Error: Opening input file [" << in_filename << "]" << KNRM << std::endl;
+        return -1;
+    }
+    if(reserve_session_buffer(batch->inBuffer, batch->inCapacity, batch->job.inSize + size + 1)) {
+        std::cerr << KRED << "append_batch_file: Unable to allocate batch buffer" << KNRM << std::endl;
+        close(fin);
         return -2;
-	}
+    }
 
-    // Create Related Streams
-    QpStream data_in("file_in", 3);
-    QpStream data_out("archive_out", 3);
+    char *dst = &batch->inBuffer[batch->job.inSize];
+    long long int done = 0;
+    while(done < size) {
+        ssize_t ret = read(fin, &dst[done], size-done);
+        if(ret < 0 && errno == EINTR)
+            continue;
+        if(ret <= 0) {
+            std::cerr << KRED << "append_batch_file: Error: Reading input file [" << in_filename << "]" << KNRM << std::endl;
+            close(fin);
+            return -1;
+        }
+        done += ret;
+    }
+    close(fin);
 
-#ifdef SGDMA
-    // Enable stream option
-    dev1.qpEnableStreamOptions(data_in);
-    dev1.qpEnableStreamOptions(data_out);
+    if(batch->files.empty())
+        batch->openTime = chrono::steady_clock::now();
+    batch->job.inSize += size;
+    batch->partIn.push_back(size);
+    batch->files.push_back(in_filename);
+    return 0;
+}
 
-    // Create and configure stream interrupt structure
-    TPCIeStreamInterrupt streamIntParam;
-    streamIntParam.intEnable = true;
-    streamIntParam.userIrqHandler = NULL;
+/**
+ *  Send a batch: one producer pass over one buffer, one EOP per file
+ */
+int submit_batch(GzipSession & session, batch_slot_t *batch, bool verify)
+{
+    long long int outSize = 2*batch->job.inSize + (long long int)batch->files.size()*SESSION_OUT_MARGIN;
+    if(reserve_session_buffer(batch->outBuffer, batch->outCapacity, outSize)) {
+        std::cerr << KRED << "submit_batch: Unable to allocate batch buffer" << KNRM << std::endl;
+        return -2;
+    }
+    batch->partOut.assign(batch->files.size(), 0);
+    batch->job.inBuffer     = batch->inBuffer;
+    batch->job.nbParts      = batch->files.size();
+    batch->job.partInSizes  = &batch->partIn[0];
+    batch->job.partOutSizes = &batch->partOut[0];
+    batch->job.outBuffer    = batch->outBuffer;
+    batch->job.outCapacity  = batch->outCapacity;
+    batch->job.user         = batch;
+    if(session.submit(&batch->job))
+        return -1;
 
-    /* Configure stream mode */
-    data_in.setFifoSize(PCIE_FIFO_SIZE); 
-    data_in.setStreamOption("streamMode", PCIE_STREAM_SGDMA);
-    data_in.setStreamOption("streamIntParam", streamIntParam);
-    data_out.setFifoSize(PCIE_FIFO_SIZE);
-    data_out.setStreamOption("streamMode", PCIE_STREAM_SGDMA);
-    data_out.setStreamOption("streamIntParam", streamIntParam);
-#endif
+    // Integrity test: CRC32 of each file while the device reads the batch
+    batch->partCrc.clear();
+    if(verify) {
+        const char *part = batch->inBuffer;
+        for(size_t i=0; i<batch->partIn.size(); i++) {
+            batch->partCrc.push_back(crc32_fast(0, part, batch->partIn[i]));
+            part += batch->partIn[i];
+        }
+    }
+    return 0;
+}
 
-    // Open Related Streams 
-    if (dev1.qpOpenStream(data_in)) {
-	    std::cerr << KRED << " => Call OpenStream failed for QpStream data_in. (size=" << (infsize>MIN_FIFO_SIZE?infsize:MIN_FIFO_SIZE) << " bytes)" << KNRM << std::endl;
-	    return -1;
+/**
+ *  Split a completed batch into per-file archives, or append it to the
+ *  multi-member archive fdArchive with the file names in the member headers
+ */
+int complete_batch(batch_slot_t *batch, gzip_args_t args, int fdArchive)
+{
+    int retCode = 0;
+    double batchBwMBps = getBandwidthMBps(batch->job.submitTime, batch->job.completeTime, batch->job.inSize);
+    const char *member = batch->outBuffer;
+    const char *part = batch->inBuffer;
+
+    if(batch->job.err) {
+        std::cerr << KRED << "Error: FPGA compression of a " << batch->files.size() << " files batch failed (" << batch->job.err << ")" << KNRM << std::endl;
+        metrics_add(METRIC_ERRORS, batch->files.size());
+        retCode = -1;
     }
-    if (dev1.qpOpenStream(data_out)) {
-	    std::cerr << KRED << " => Call OpenStream failed for QpStream data_out. (size=" << (outfsizeMAX>MIN_FIFO_SIZE?outfsizeMAX:MIN_FIFO_SIZE) << " bytes)" << KNRM << std::endl;
-	    dev1.qpCloseStream(data_in);
-	    return -1;
+
+    for(size_t i=0; i<batch->files.size() && !retCode; i++) {
+        file_results_t *res = batch->res[i];
+        string out_filename = batch->files[i] + string(".gz");
+        long long int memberSize = batch->partOut[i];
+        res->filename = basename(batch->files[i]);
+
+        int inlineCheck = GZIP_CHECK_NONE;
+        if(!batch->partCrc.empty())
+            inlineCheck = gzip_check_member(member, memberSize, batch->partCrc[i], batch->partIn[i]);
+
+        // Round-trip test from the batch buffers, the device runs the next batch meanwhile
+        bool inflateDone = !batch->partCrc.empty();
+        if(inlineCheck == GZIP_CHECK_OK && verify_sampled(args))
+            inlineCheck = gzip_inflate_compare(member, memberSize, part, batch->partIn[i]);
+
+        std::string header;
+        long long int skip = 0;
+        int fout = fdArchive;
+        if(fdArchive >= 0) {
+            // Keep the original file name in the member header
+            skip = gzip_header_size(member, memberSize);
+            if(skip < 0) {
+                std::cerr << KRED << "Error: Invalid gzip member returned for [" << batch->files[i] << "]" << KNRM << std::endl;
+                retCode = -1;
+                break;
+            }
+            gzip_write_header(header, res->filename.c_str());
+        }
+        else {
+            fout = open(out_filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC, S_IWRITE | S_IREAD);
+            if (fout == -1) {
+                std::cerr << KRED << "complete_batch: Error: Opening output file [" << out_filename << "]" << KNRM << std::endl;
+                retCode = -3;
+                break;
+            }
+        }
+
+        struct iovec iov[2];
+        iov[0].iov_base = (void *)header.data();
+        iov[0].iov_len  = header.size();
+        iov[1].iov_base = (void *)&member[skip];
+        iov[1].iov_len  = memberSize - skip;
+        while(iov[0].iov_len + iov[1].iov_len) {
+            ssize_t ret = writev(fout, iov, 2);
+            if(ret < 0 && errno == EINTR)
+                continue;
+            if(ret < 0) {
+                std::cerr << KRED << "Error: Unable to write output file [" << (fdArchive >= 0 ? args.batchArchive : out_filename) << "]" << KNRM << std::endl;
+                retCode = -4;
+                break;
+            }
+            for(int v=0; v<2; v++) {
+                size_t step = (size_t)ret < iov[v].iov_len ? (size_t)ret : iov[v].iov_len;
+                iov[v].iov_base = (char *)iov[v].iov_base + step;
+                iov[v].iov_len -= step;
+                ret -= step;
+            }
+        }
+        if(fdArchive < 0)
+            close(fout);
+        member += memberSize;
+        part += batch->partIn[i];
+
+        // Batch figures: the files share one device submission
+        res->hwBwMBps = batchBwMBps;
+        res->hwComprRatio = memberSize ? (double)batch->partIn[i]/(double)(memberSize - skip + header.size()) : -1.0;
+        count_compressed(batch->partIn[i], memberSize - skip + header.size());
+        if(!retCode && complete_file_results(batch->files[i], fdArchive >= 0 ? args.batchArchive : out_filename, args, res, inlineCheck, inflateDone))
+            retCode = -1;
     }
 
-    // ############################### 1rst run : 1 loop, Compression ratio comparison
+    batch->job.inSize = 0;
+    batch->partIn.clear();
+    batch->files.clear();
+    batch->res.clear();
+    return retCode;
+}
 
-    // Configure Producer, Consumer Thread
-    thread_params_t prod_thread_cfg, cons_thread_cfg;
-    prod_thread_cfg.pStream=&data_in;
-    prod_thread_cfg.pBuffer=input_file;
-    prod_thread_cfg.reqTransfSize=infsize;
-    prod_thread_cfg.loopCnt=1;
-    cons_thread_cfg.pStream=&data_out;
-    cons_thread_cfg.pBuffer=output_file;
-    cons_thread_cfg.reqTransfSize=outfsizeMAX;
-    cons_thread_cfg.loopCnt=prod_thread_cfg.loopCnt;
+/**
+ *  Time the per-file path on the same files: one session job (EOP) per file
+ */
+double time_per_file_path(std::vector<string> & files)
+{
+    session_slot_t slots[SESSION_MAX_INFLIGHT];
+    std::vector<session_slot_t *> freeSlots;
+    for(int i=0; i<SESSION_MAX_INFLIGHT; i++) {
+        slots[i].inBuffer = NULL;
+        slots[i].inCapacity = 0;
+        slots[i].outBuffer = NULL;
+        slots[i].outCapacity = 0;
+        freeSlots.push_back(&slots[i]);
+    }
 
-    // Create two thread for read and write process
-#ifdef SGDMA
-    std::thread Consumer_thread(tConsumer_SGDMA, &cons_thread_cfg);
-    std::thread Producer_thread(tProducer_SGDMA, &prod_thread_cfg);
-#endif
-#ifdef SGDMAR
-    std::thread Consumer_thread(tConsumer_SGDMAR, &cons_thread_cfg);
-    std::thread Producer_thread(tProducer_SGDMAR, &prod_thread_cfg);
-#endif
+    GzipSession session(dev1, SESSION_MAX_INFLIGHT);
+    if(session.open())
+        return -1.0;
+
+    chrono::time_point<std::chrono::steady_clock> start = chrono::steady_clock::now();
+    for(size_t i=0; i<files.size(); i++) {
+        session_job_t *job;
+        while((job = session.getCompleted(freeSlots.empty())) != NULL)
+            freeSlots.push_back((session_slot_t *)job->user);
+
+        session_slot_t *slot = freeSlots.back();
+        slot->in_filename = files[i];
+        if(load_session_slot(slot))
+            continue;
+        freeSlots.pop_back();
+        session.submit(&slot->job);
+    }
+    while(session.getCompleted(true) != NULL)
+        ;
+    std::chrono::time_point<std::chrono::steady_clock> end = std::chrono::steady_clock::now();
+    session.close();
+
+    for(int i=0; i<SESSION_MAX_INFLIGHT; i++) {
+        release_session_buffer(slots[i].inBuffer);
+        release_session_buffer(slots[i].outBuffer);
+    }
+    return getElapsedSecs(start, end);
+}
 
-    // Wait for the two thread end
-    Consumer_thread.join();
-	Producer_thread.join();
+/**
+ * Gzip Folder in FPGA, batch mode
+ *
+ * Small files are packed back-to-back in one buffer and sent in a single
+ * producer pass, one EOP per file. Files are added as the walker finds
+ * them; a batch is flushed when it reaches batchSize bytes or when its
+ * oldest file waited batchDeadlineMs, even while the walk stalls. The gzip
+ * members read back are split into per-file archives, or appended to one
+ * multi-member archive.
+ */
+int fpga_gzip_folder_batch(TreeWalker & walker, gzip_args_t args, file_results_t* & resTable, unsigned int & resTableSize)
+{
+    int retCode = 0;
+    std::vector<string> files;
+    std::deque<file_results_t> results;     // the batches point into it
+    int fdArchive = -1;
+    long long int totalIn = 0;
+    unsigned int nbBatches = 0;
+    double persistSecs = 0.0;
+    batch_slot_t slots[BATCH_INFLIGHT];
+    std::vector<batch_slot_t *> freeSlots;
+    for(int i=0; i<BATCH_INFLIGHT; i++) {
+        slots[i].inBuffer = NULL;
+        slots[i].inCapacity = 0;
+        slots[i].outBuffer = NULL;
+        slots[i].outCapacity = 0;
+        slots[i].job.inSize = 0;
+        freeSlots.push_back(&slots[i]);
+    }
 
-    // Write result to output_file
-    long long int written=0;
-    while(written<outfsize) {
-        int ret = write(fout, &output_file[written], (outfsize-written));
-        if(ret<0) {
-            std::cerr << KRED << "Error: Unable to write output file [" << out_filename << "] ret=" << ret << KNRM << std::endl;
-            return -4;
+    if(args.batchArchive != "") {
+        if(!args.force && isFile(args.batchArchive)) {
+            std::cerr << KRED << "File [" << args.batchArchive << "] already exists. use '-f'/'--force' to overwrite existing files" << KNRM << std::endl;
+            return -1;
+        }
+        fdArchive = open(args.batchArchive.c_str(), O_WRONLY | O_CREAT | O_TRUNC, S_IWRITE | S_IREAD);
+        if (fdArchive == -1) {
+            std::cerr << KRED << "fpga_gzip_folder_batch: Error: Opening output file [" << args.batchArchive << "]" << KNRM << std::endl;
+            return -3;
         }
-        written += ret;
     }
 
-    // Save Compression Result
-    res->hwComprRatio = (double)infsize/(double)outfsize;
+    GzipSession session(dev1, BATCH_INFLIGHT);
+    if(session.open()) {
+        if(fdArchive >= 0)
+            close(fdArchive);
+        return -1;
+    }
 
+    chrono::time_point<std::chrono::steady_clock> start = chrono::steady_clock::now();
+    batch_slot_t *current = NULL;
+
+    while(!retCode) {
+        // Next file. While a batch is open, waiting for the walker stops at
+        // the batch deadline.
+        string path;
+        int found;
+        if(current) {
+            double age = getElapsedSecs(current->openTime, chrono::steady_clock::now())*1000.0;
+            found = walker.next(path, age < args.batchDeadlineMs ? (unsigned int)(args.batchDeadlineMs - age) + 1 : 0);
+        }
+        else
+            found = walker.next(path) ? 1 : -1;
+        bool lastFile = (found < 0);
+        long long int size = (found > 0) ? getFileSize(path) : 0;
+
+        // Flush the current batch when full, too old, or at the end
+        if(current) {
+            double age = getElapsedSecs(current->openTime, chrono::steady_clock::now())*1000.0;
+            if(lastFile || current->job.inSize + size > args.batchSize || current->files.size() >= BATCH_MAX_FILES ||
+               age >= args.batchDeadlineMs) {
+                if(submit_batch(session, current, args.verifyIntegrity)) {
+                    retCode = -1;
+                    break;
+                }
+                nbBatches++;
+                current = NULL;
+            }
+        }
 
-    // ############################### 2nd run : 100 loop, Bandwidth comparison
-    // Configure Producer, Consumer Thread
-    prod_thread_cfg.pStream=&data_in;
-    prod_thread_cfg.pBuffer=input_file;
-    prod_thread_cfg.reqTransfSize=infsize;
-    prod_thread_cfg.loopCnt=BW_TEST_ITERATION_CNT;
-    cons_thread_cfg.pStream=&data_out;
-    cons_thread_cfg.pBuffer=output_file;
-    cons_thread_cfg.reqTransfSize=outfsizeMAX;
-    cons_thread_cfg.loopCnt=prod_thread_cfg.loopCnt;
+        // Persist completed batches, wait for one when all are in flight
+        session_job_t *job;
+        while((job = session.getCompleted(lastFile || (!current && freeSlots.empty()))) != NULL) {
+            batch_slot_t *done = (batch_slot_t *)job->user;
+            totalIn += job->inSize;
+            chrono::time_point<std::chrono::steady_clock> persistStart = chrono::steady_clock::now();
+            if(complete_batch(done, args, fdArchive))
+                retCode = -1;
+            persistSecs += getElapsedSecs(persistStart, chrono::steady_clock::now());
+            freeSlots.push_back(done);
+        }
+        if(lastFile || retCode)
+            break;
+        if(!found)
+            continue;
+
+        // Test if file already exists
+        if(fdArchive < 0 && !args.force && isFile(path + string(".gz"))) {
+            std::cerr << KRED << "File [" << path << ".gz] already exists. use '-f'/'--force' to overwrite existing files" << KNRM << std::endl;
+            retCode = -1;
+            break;
+        }
 
-    // Start Time Measurement
-    chrono::time_point<std::chrono::system_clock> start100 = chrono::system_clock::now();
+        if(!current) {
+            current = freeSlots.back();
+            freeSlots.pop_back();
+        }
+        if(append_batch_file(current, path, size)) {
+            retCode = -1;
+            break;
+        }
+        files.push_back(path);
+        results.push_back(file_results_t());
+        current->res.push_back(&results.back());
+    }
+    if(retCode)
+        walker.stop();
+
+    // Drain batches still in flight after an error
+    session_job_t *job;
+    while((job = session.getCompleted(true)) != NULL)
+        ;
+    session.close();
+    std::chrono::time_point<std::chrono::steady_clock> end = std::chrono::steady_clock::now();
+    if(fdArchive >= 0)
+        close(fdArchive);
+
+    resTableSize = results.size();
+    resTable = new file_results_t[resTableSize ? resTableSize : 1];
+    for(unsigned int i=0; i<resTableSize; i++)
+        resTable[i] = results[i];
+
+    // Batched path figures exclude output persistence, as the per-file figures do
+    double batchSecs = getElapsedSecs(start, end) - persistSecs;
+    double perFileSecs = !retCode ? time_per_file_path(files) : -1.0;
+
+    if(!retCode) {
+        TextTable tableBatch( '-', '|', '+' );
+        tableBatch.setTitle("BATCHING COMPARISON (inputs read from page cache, output writes excluded)");
+        tableBatch.add( "Path" );
+        tableBatch.add( "Files" );
+        tableBatch.add( "Submissions" );
+        tableBatch.add( "MB" );
+        tableBatch.add( "Files/s" );
+        tableBatch.add( "MB/s" );
+        tableBatch.endOfRow();
+        tableBatch.add( "Per-file" );
+        tableBatch.add( resTableSize );
+        tableBatch.add( resTableSize );
+        tableBatch.add( (double)totalIn/SIZE_1MB );
+        tableBatch.add( perFileSecs > 0.0 ? resTableSize/perFileSecs : -1.0 );
+        tableBatch.add( perFileSecs > 0.0 ? totalIn/perFileSecs/SIZE_1MB : -1.0 );
+        tableBatch.endOfRow();
+        tableBatch.add( "Batched" );
+        tableBatch.add( resTableSize );
+        tableBatch.add( nbBatches );
+        tableBatch.add( (double)totalIn/SIZE_1MB );
+        tableBatch.add( batchSecs > 0.0 ? resTableSize/batchSecs : -1.0 );
+        tableBatch.add( batchSecs > 0.0 ? totalIn/batchSecs/SIZE_1MB : -1.0 );
+        tableBatch.endOfRow();
+        std::cout << "\n" << tableBatch;
+    }
+
+    for(int i=0; i<BATCH_INFLIGHT; i++) {
+        release_session_buffer(slots[i].inBuffer);
+        release_session_buffer(slots[i].outBuffer);
+    }
+    return retCode;
+}
+
+/**
+ * Gzip Folder in FPGA
+ */
+int fpga_gzip_folder(string folderPath, gzip_args_t args, file_results_t* & resTable, unsigned int & resTableSize)
+{ 
+    TreeWalker walker(args.walkThreads, args.includes, args.excludes);
+    walker.start(folderPath);
+    resTableSize=0;
 
-// Create two thread for read and write process
-#ifdef SGDMA
-    std::thread Consumer_thread100(tConsumer_SGDMA, &cons_thread_cfg);
-    std::thread Producer_thread100(tProducer_SGDMA, &prod_thread_cfg);
-#endif
 #ifdef SGDMAR
-    std::thread Consumer_thread100(tConsumer_SGDMAR, &cons_thread_cfg);
-    std::thread Producer_thread100(tProducer_SGDMAR, &prod_thread_cfg);
+    // Compression starts while the tree is still being walked
+    if(args.sessionMode && !args.batchMode && !args.indexMode && !args.bgzfMode && boards.size() == 1)
+        return fpga_gzip_folder_pipeline(walker, args, resTable, resTableSize);
 #endif
 
-    // Wait for the two thread end
-    Consumer_thread100.join();
-	Producer_thread100.join();
+    // Several boards: the files are queued as the walker finds them
+    if(boards.size() > 1 && !args.batchMode && !args.indexMode && !args.bgzfMode) {
+        std::vector<string> listed;
+        std::deque<file_results_t> results;
+        int retCode = fpga_gzip_multiboard(&walker, listed, args, results);
+        resTableSize = results.size();
+        resTable = new file_results_t[resTableSize ? resTableSize : 1];
+        for(unsigned int i=0; i<resTableSize; i++)
+            resTable[i] = results[i];
+        return retCode;
+    }
 
-    // Stop Time Measurement
-    std::chrono::time_point<std::chrono::system_clock> end100 = std::chrono::system_clock::now();
+    // Batch mode: the batches fill up as the walker finds the files
+    if(args.batchMode && !cpuFallback)
+        return fpga_gzip_folder_batch(walker, args, resTable, resTableSize);
+
+    std::vector<string> files;
+    walker.collect(files);
+    resTable = new file_results_t[files.size() ? files.size() : 1];
+
+    for(size_t i=0; i<files.size(); i++) {
+        // Launch GZip Compression Process
+        if (fpga_gzip_file(files[i], args, &resTable[resTableSize]))
+            return -1;
+        resTableSize++;
+    }
+    return 0;
+}
+
+/**
+ * Gunzip a file on the host: members inflated on nbThreads threads, output
+ * to <file> without .gz, to stdout (-c) or only tested (-t)
+ */
+int gunzip_file(string in_filename, gzip_args_t & args, file_results_t* res, unsigned int nbThreads)
+{
+    res->filename = args.fromStdin ? string("stdin") : basename(in_filename);
+    res->engine = std::string("CPU");
+    res->comprResult = std::string("FAIL");
+    res->hwBwMBps = -1.0;
+    res->hwComprRatio = -1.0;
+    res->swBwFastMBps = -1.0;
+    res->swBwBestMBps = -1.0;
+    res->bwFastGain = -1.0;
+    res->bwBestGain = -1.0;
+    res->swComprFastRatio = -1.0;
+    res->swComprBestRatio = -1.0;
+    res->comprFastGain = -1.0;
+    res->comprBestGain = -1.0;
+    res->swInSize = 0;
+
+    // Compute out_filename
+    string out_filename;
+    bool toFile = !args.toStdout && !args.verifyIntegrity;
+    if(toFile) {
+        if(!isGzipArchive(in_filename)) {
+            std::cerr << KRED << "File [" << in_filename << "] has no .gz suffix, it is left unchanged" << KNRM << std::endl;
+            return -1;
+        }
+        out_filename = in_filename.substr(0, in_filename.size()-3);
+        if(!args.force && isFile(out_filename)) {
+            std::cerr << KRED << "File [" << out_filename << "] already exists. use '-f'/'--force' to overwrite existing files" << KNRM << std::endl;
+            return -1;
+        }
+    }
+
+    if(args.verbose)
+        std::cout << KBLU << "Starting GZip Software decompression of " << (args.fromStdin ? string("stdin") : "file [" + basename(in_filename) + "] " + getFileSizeStr(in_filename))
+                  << " on " << nbThreads << " thread(s) ..." << KNRM << std::endl;
+
+    // Input: the whole archive in memory, members are found by scanning it
+    std::string stdinData;
+    const char *data = "";
+    long long int size = 0;
+    if(args.fromStdin) {
+        char buffer[SIZE_1MB/16];
+        ssize_t ret;
+        while((ret = read(STDIN_FILENO, buffer, sizeof(buffer))) != 0) {
+            if(ret < 0 && errno == EINTR)
+                continue;
+            if(ret < 0) {
+                std::cerr << KRED << "gunzip_file: Error: Reading standard input" << KNRM << std::endl;
+                return -1;
+            }
+            stdinData.append(buffer, ret);
+        }
+        data = stdinData.data();
+        size = stdinData.size();
+    }
+    else {
+        int fin = open(in_filename.c_str(), O_RDONLY);
+        if (fin == -1) {
+            std::cerr << KRED << "gunzip_file: Error: Opening input file [" << in_filename << "]" << KNRM << std::endl;
+            return -1;
+        }
+        size = getFileSize(in_filename);
+        if(size > 0) {
+            data = (const char *)mmap(NULL, size, PROT_READ, MAP_PRIVATE|MAP_POPULATE, fin, 0);
+            if (data == MAP_FAILED) {
+                std::cerr << KRED << "gunzip_file: Memory map error on input file [" << in_filename << "]" << KNRM << std::endl;
+                close(fin);
+                return -2;
+            }
+        }
+        close(fin);
+    }
 
-    // Compute Bandwidth
-    res->hwBwMBps = getBandwidthMBps(start100, end100, (unsigned long)infsize*prod_thread_cfg.loopCnt);
+    // Member starts from the index, when it matches the archive
+    gzip_index_t index;
+    std::vector<size_t> starts;
+    if(!args.fromStdin && !gzip_index_load_archive(in_filename, size, index)) {
+        for(size_t i=0; i+1<index.size(); i++)
+            starts.push_back(index[i].outOffset);
+        if(args.verbose)
+            std::cout << KBLU << "Using index [" << basename(in_filename) << GZIP_INDEX_SUFFIX << "]" << KNRM << std::endl;
+    }
 
-    // ####################
+    int fout = args.toStdout ? STDOUT_FILENO : -1;
+    if(toFile) {
+        fout = open(out_filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC, S_IWRITE | S_IREAD);
+        if (fout == -1) {
+            std::cerr << KRED << "gunzip_file: Error: Opening output file [" << out_filename << "]" << KNRM << std::endl;
+            if(!args.fromStdin && size > 0)
+                munmap((void *)data, size);
+            return -3;
+        }
+    }
 
-    // Close the streams
-    dev1.qpCloseStream(data_in);
-    dev1.qpCloseStream(data_out);
+    gunzip_stats_t stats;
+    chrono::time_point<std::chrono::steady_clock> start = chrono::steady_clock::now();
+    int check = sw_gunzip_buffer(data, size, nbThreads, fout, stats, starts.empty() ? NULL : &starts);
+    std::chrono::time_point<std::chrono::steady_clock> end = std::chrono::steady_clock::now();
+    if(toFile)
+        close(fout);
+
+    int retCode = 0;
+    if(check == GUNZIP_WRITE_ERROR) {
+        std::cerr << KRED << "Error: Unable to write the output of [" << in_filename << "]" << KNRM << std::endl;
+        metrics_add(METRIC_ERRORS, 1);
+        retCode = -4;
+    }
+    else if(check) {
+        show_check_error(toFile ? out_filename : string("inflated data"), args.fromStdin ? string("stdin") : in_filename, check);
+        retCode = -5;
+    }
+    else {
+        res->comprResult = std::string("SUCCESS");
+        res->hwBwMBps = getBandwidthMBps(start, end, stats.outSize);
+        res->hwComprRatio = size ? (double)stats.outSize/(double)size : -1.0;
+        count_compressed(size, stats.outSize);
+        if(args.verbose)
+            std::cout << KBLU << "Inflated [" << res->filename << "] " << stats.members << " member(s), "
+                      << stats.candidates << (starts.empty() ? " candidate(s) found by the scan" : " member start(s) from the index") << KNRM << std::endl;
+
+        // Baseline: single-threaded zlib, as gunzip decompresses
+        if(args.OScompare) {
+            start = chrono::steady_clock::now();
+            long long int refSize = sw_gunzip_reference(data, size);
+            end = chrono::steady_clock::now();
+            if(refSize == stats.outSize) {
+                res->swBwFastMBps = getBandwidthMBps(start, end, refSize);
+                res->bwFastGain = res->hwBwMBps / res->swBwFastMBps;
+            }
+        }
+    }
+    if(!args.fromStdin && size > 0)
+        munmap((void *)data, size);
 
-	// Clear resources
-	munmap(input_file, infsize);
-    munmap(output_file, outfsizeMAX);
-    close(fout);
+    // Partial output of a failed run is removed, as gunzip does
+    if(retCode && toFile)
+        unlink(out_filename.c_str());
+    return retCode;
+}
 
-    // Verify Compression Result
-    if(args.verifyIntegrity)
-        retCode = checkArchive(in_filename, out_filename, args.verbose);
+/**
+ * Gunzip a file, stdin or the .gz files of a folder. Files are spread over
+ * args.swThreads threads, each file inflated on its share of them.
+ */
+int gunzip_files(gzip_args_t & args, file_results_t* & resTable, unsigned int & resTableSize)
+{
+    std::vector<string> files;
+    if(args.operateOnFolder) {
+        TreeWalker walker(args.walkThreads, args.includes, args.excludes, true);
+        walker.start(args.path);
+        walker.collect(files);
+    }
     else
-        retCode = 0;
+        files.push_back(args.path);
 
-    // Update Compression result label
-    if(retCode)
-        res->comprResult = std::string("FAIL");
-    else
-        res->comprResult = std::string("SUCCESS");
+    resTableSize = files.size();
+    resTable = new file_results_t[files.size() ? files.size() : 1];
+    if(files.empty())
+        return 0;
 
-    if(args.OScompare) {
-        // Launch OS Compression Process Best Compression Mode
-        retCode = os_gzip_file("--best", in_filename, elapsed, osBandwidthMBpsBest, comprRatio, args);
-        res->swBwBestMBps = osBandwidthMBpsBest;
-        res->swComprBestRatio = comprRatio;
+    unsigned int nbWorkers = std::min((size_t)(args.swThreads ? args.swThreads : 1), files.size());
+    unsigned int nbThreads = std::max(1U, args.swThreads / nbWorkers);
+    std::atomic<size_t> next(0);
+    std::atomic<int> err(0);
+    std::vector<std::thread> workers;
+    for(unsigned int w=0; w<nbWorkers; w++) {
+        workers.push_back(std::thread([&] {
+            size_t i;
+            while((i = next++) < files.size()) {
+                int ret = gunzip_file(files[i], args, &resTable[i], nbThreads);
+                if(ret)
+                    err = ret;
+            }
+        }));
+    }
+    for(size_t w=0; w<workers.size(); w++)
+        workers[w].join();
+    return err;
+}
 
-        // Launch OS Compression Process Fast Compression Mode
-        retCode = os_gzip_file("--fast", in_filename, elapsed, osBandwidthMBpsFast, comprRatio, args);
-        res->swBwFastMBps = osBandwidthMBpsFast;
-        res->swComprFastRatio = comprRatio;
-    
-        // Compute Gains
-        res->bwFastGain    = res->hwBwMBps / res->swBwFastMBps;
-        res->bwBestGain    = res->hwBwMBps / res->swBwBestMBps;
-        res->comprFastGain = res->hwComprRatio / res->swComprFastRatio;
-        res->comprBestGain = res->hwComprRatio / res->swComprBestRatio;
+/**
+ * Extract a range of the original data of an archive to stdout. With an
+ * index, only the members holding the range are inflated.
+ */
+int gunzip_range(gzip_args_t & args)
+{
+    int fin = open(args.path.c_str(), O_RDONLY);
+    if (fin == -1) {
+        std::cerr << KRED << "gunzip_range: Error: Opening input file [" << args.path << "]" << KNRM << std::endl;
+        return -1;
     }
-    else {
-        res->swComprBestRatio = -1.0;
-        res->swBwFastMBps = -1.0;
-        res->swBwBestMBps = -1.0;
-        res->swBwFastMBps = -1.0;
-        res->bwFastGain = -1.0;
-        res->bwBestGain = -1.0;
-        res->comprFastGain = -1.0;
-        res->comprBestGain = -1.0;
+    long long int size = getFileSize(args.path);
+    const char *data = "";
+    if(size > 0) {
+        data = (const char *)mmap(NULL, size, PROT_READ, MAP_PRIVATE, fin, 0);
+        if (data == MAP_FAILED) {
+            std::cerr << KRED << "gunzip_range: Memory map error on input file [" << args.path << "]" << KNRM << std::endl;
+            close(fin);
+            return -2;
+        }
     }
-	return 0;
+    close(fin);
+
+    // Start from the member holding the first byte, or from the archive start
+    unsigned long long start = 0, skip = args.extractOffset;
+    gzip_index_t index;
+    if(!gzip_index_load_archive(args.path, size, index)) {
+        size_t member = gzip_index_find(index, args.extractOffset);
+        start = index[member].outOffset;
+        skip  = member+1 < index.size() ? args.extractOffset - index[member].inOffset : 0;
+    }
+    else if(!args.quiet)
+        std::cerr << KYEL << "WARNING: no index for [" << args.path << "], inflating from the start of the archive" << KNRM << std::endl;
+
+    gunzip_stats_t stats;
+    chrono::time_point<std::chrono::steady_clock> begin = chrono::steady_clock::now();
+    int check = sw_gunzip_range(&data[start], size-start, skip, args.extractLength, STDOUT_FILENO, stats);
+    std::chrono::time_point<std::chrono::steady_clock> end = std::chrono::steady_clock::now();
+    if(size > 0)
+        munmap((void *)data, size);
+
+    if(check == GUNZIP_WRITE_ERROR) {
+        std::cerr << KRED << "Error: Unable to write the range extracted from [" << args.path << "]" << KNRM << std::endl;
+        metrics_add(METRIC_ERRORS, 1);
+        return -4;
+    }
+    if(check) {
+        show_check_error("extracted data", args.path, check);
+        return -5;
+    }
+    if(args.verbose)
+        std::cout << KBLU << "Extracted " << stats.outSize << " bytes at offset " << args.extractOffset << " from " << stats.members
+                  << " member(s) starting at archive offset " << start << ", " << getElapsedSecs(begin, end)*1000.0 << " ms" << KNRM << std::endl;
+    return 0;
 }
 
+#ifdef SGDMAR
 /**
- * Gzip Folder in FPGA
+ *  Benchmark: compress the input of a loaded slot once, on dev1 or on the
+ *  CPU engine without a design
  */
-int fpga_gzip_folder(string folderPath, gzip_args_t args, file_results_t* & resTable, unsigned int & resTableSize)
-{ 
-    struct dirent **namelist;
-    int n = scandir(folderPath.c_str(), &namelist, NULL, alphasort);
-    resTable = new file_results_t[n];
-    resTableSize=0;
-    if (n > 0) {
-        for(int i=0; i<n; i++) {
-            string in_filepath   = folderPath + string("/") + string(namelist[i]->d_name);
+int bench_compress(session_slot_t *slot, QpStream *pStreamIn, QpStream *pStreamOut, gzip_args_t & args)
+{
+    if(cpuFallback) {
+        std::string out;
+        if(sw_gzip_buffer(slot->inBuffer, slot->job.inSize, CPU_ENGINE_LEVEL, args.swThreads, out))
+            return -1;
+        memcpy(slot->outBuffer, out.data(), out.size());
+        slot->job.outSize = out.size();
+        return 0;
+    }
 
-            // Skip directory path files & hidden files
-            if (!strncmp(namelist[i]->d_name, ".", 1))  
-                continue;
+    thread_params_t prod_thread_cfg, cons_thread_cfg;
+    prod_thread_cfg.pStream=pStreamIn;
+    prod_thread_cfg.pBuffer=slot->inBuffer;
+    prod_thread_cfg.pPrefetch=NULL;
+    prod_thread_cfg.reqTransfSize=slot->job.inSize;
+    prod_thread_cfg.loopCnt=1;
+    cons_thread_cfg.pStream=pStreamOut;
+    cons_thread_cfg.pBuffer=slot->outBuffer;
+    cons_thread_cfg.pPrefetch=NULL;
+    cons_thread_cfg.reqTransfSize=slot->outCapacity;
+    cons_thread_cfg.loopCnt=1;
 
-            // Skip inner folders
-            if(isFolder(in_filepath))
-                continue;
+    std::thread Consumer_thread(tConsumer_SGDMAR, &cons_thread_cfg);
+    std::thread Producer_thread(tProducer_SGDMAR, &prod_thread_cfg);
+    Consumer_thread.join();
+    Producer_thread.join();
+    slot->job.outSize = cons_thread_cfg.realTransfSize;
+    return cons_thread_cfg.err;
+}
+
+/**
+ *  Benchmark one file: warmup runs, then timed runs of the three stages
+ *    device:        compression of the loaded input, memory to memory
+ *    host pipeline: input file read + compression
+ *    end-to-end:    input file read + compression + archive written out
+ */
+int bench_file(string in_filename, gzip_args_t & args, session_slot_t *slot, QpStream *pStreamIn, QpStream *pStreamOut,
+               bench_samples_t *samples)
+{
+    slot->in_filename  = in_filename;
+    slot->out_filename = in_filename + string(".gz");
+    if(!args.force && isFile(slot->out_filename)) {
+        std::cerr << KRED << "File [" << slot->out_filename << "] already exists. use '-f'/'--force' to overwrite existing files" << KNRM << std::endl;
+        return -1;
+    }
+
+    for(unsigned int i=0; i<args.benchWarmup+args.benchIterations; i++) {
+        std::chrono::time_point<std::chrono::steady_clock> t0 = std::chrono::steady_clock::now();
+        if(load_session_slot(slot))
+            return -1;
+        std::chrono::time_point<std::chrono::steady_clock> t1 = std::chrono::steady_clock::now();
+        if(bench_compress(slot, pStreamIn, pStreamOut, args)) {
+            std::cerr << KRED << "Error: compression of file [" << in_filename << "] failed" << KNRM << std::endl;
+            return -1;
+        }
+        std::chrono::time_point<std::chrono::steady_clock> t2 = std::chrono::steady_clock::now();
 
-            // Skip already existing .gz achives
-            if(isGzipArchive(in_filepath))
+        int fout = open(slot->out_filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC, S_IWRITE | S_IREAD);
+        if (fout == -1) {
+            std::cerr << KRED << "bench_file: Error: Opening output file [" << slot->out_filename << "]" << KNRM << std::endl;
+            return -3;
+        }
+        long long int written = 0;
+        while(written < slot->job.outSize) {
+            ssize_t ret = write(fout, &slot->outBuffer[written], slot->job.outSize-written);
+            if(ret < 0 && errno == EINTR)
                 continue;
+            if(ret < 0) {
+                std::cerr << KRED << "Error: Unable to write output file [" << slot->out_filename << "]" << KNRM << std::endl;
+                close(fout);
+                return -4;
+            }
+            written += ret;
+        }
+        close(fout);
+        std::chrono::time_point<std::chrono::steady_clock> t3 = std::chrono::steady_clock::now();
+
+        if(i < args.benchWarmup)
+            continue;
+        samples[BENCH_DEVICE].secs.push_back(getElapsedSecs(t1, t2));
+        samples[BENCH_HOST].secs.push_back(getElapsedSecs(t0, t2));
+        samples[BENCH_FILE].secs.push_back(getElapsedSecs(t0, t3));
+        for(int s=0; s<BENCH_NB_STAGES; s++)
+            samples[s].bytes += slot->job.inSize;
+    }
 
-            // Launch GZip Compression Process
-            if (fpga_gzip_file(in_filepath, args, &resTable[resTableSize]))
-                return -1;
-            resTableSize++;
+    // The timings are only worth something if the archive is right
+    if(args.verifyIntegrity) {
+        int check = gzip_inflate_compare(slot->outBuffer, slot->job.outSize, slot->inBuffer, slot->job.inSize);
+        if(check != GZIP_CHECK_OK) {
+            show_check_error(in_filename, slot->out_filename, check);
+            return -1;
         }
+    }
+    if(args.verbose)
+        std::cout << KBLU << "Benchmarked [" << basename(in_filename) << "] " << slot->job.inSize << " -> " << slot->job.outSize
+                  << " bytes, " << args.benchIterations << " timed runs" << KNRM << std::endl;
+    return 0;
+}
 
-        // Clear allocated resources
-        for(int i=0; i<n; i++)
-            free(namelist[i]);
-        free(namelist);
+/**
+ *  Nearest-rank percentile of sorted samples
+ */
+double bench_percentile(const std::vector<double> & sorted, double pct)
+{
+    if(sorted.empty())
+        return -1.0;
+    size_t rank = (size_t)ceil(pct/100.0*sorted.size());
+    if(rank < 1)
+        rank = 1;
+    if(rank > sorted.size())
+        rank = sorted.size();
+    return sorted[rank-1];
+}
+
+/**
+ *  Benchmark mode: per-file latency percentiles of each stage, steady clock
+ */
+int fpga_bench(gzip_args_t args)
+{
+    std::vector<string> files;
+    if(args.operateOnFolder) {
+        TreeWalker walker(args.walkThreads, args.includes, args.excludes);
+        walker.start(args.path);
+        walker.collect(files);
+    }
+    else
+        files.push_back(args.path);
+
+    QpStream data_in("file_in", 3);
+    QpStream data_out("archive_out", 3);
+    if(!cpuFallback) {
+        if (dev1.qpOpenStream(data_in)) {
+            std::cerr << KRED << " => Call OpenStream failed for QpStream data_in." << KNRM << std::endl;
+            return -1;
+        }
+        if (dev1.qpOpenStream(data_out)) {
+            std::cerr << KRED << " => Call OpenStream failed for QpStream data_out." << KNRM << std::endl;
+            dev1.qpCloseStream(data_in);
+            return -1;
+        }
+    }
+
+    session_slot_t slot;
+    slot.inBuffer = NULL;
+    slot.inCapacity = 0;
+    slot.outBuffer = NULL;
+    slot.outCapacity = 0;
+    bench_samples_t samples[BENCH_NB_STAGES];
+    for(int s=0; s<BENCH_NB_STAGES; s++)
+        samples[s].bytes = 0;
+
+    int retCode = 0;
+    for(size_t i=0; i<files.size() && !retCode; i++)
+        retCode = bench_file(files[i], args, &slot, &data_in, &data_out, samples);
+
+    if(!cpuFallback) {
+        dev1.qpCloseStream(data_in);
+        dev1.qpCloseStream(data_out);
+    }
+    release_session_buffer(slot.inBuffer);
+    release_session_buffer(slot.outBuffer);
+    if(retCode)
+        return retCode;
+
+    const char *stages[BENCH_NB_STAGES] = { cpuFallback ? "CPU engine" : "Device", "Host pipeline", "End-to-end" };
+    TextTable tableBench( '-', '|', '+' );
+    tableBench.setTitle("BENCHMARK (per-file latency in ms, " + std::to_string(args.benchWarmup) + " warmup + "
+                        + std::to_string(args.benchIterations) + " timed runs per file)");
+    tableBench.add( "Stage" );
+    tableBench.add( "Samples" );
+    tableBench.add( "p50" );
+    tableBench.add( "p90" );
+    tableBench.add( "p99" );
+    tableBench.add( "Max" );
+    tableBench.add( "MB/s" );
+    tableBench.endOfRow();
+    for(int s=0; s<BENCH_NB_STAGES; s++) {
+        std::vector<double> & secs = samples[s].secs;
+        std::sort(secs.begin(), secs.end());
+        double total = 0.0;
+        for(size_t i=0; i<secs.size(); i++)
+            total += secs[i];
+        tableBench.add( string(stages[s]) );
+        tableBench.add( (unsigned int)secs.size() );
+        tableBench.add( bench_percentile(secs, 50.0)*1000.0 );
+        tableBench.add( bench_percentile(secs, 90.0)*1000.0 );
+        tableBench.add( bench_percentile(secs, 99.0)*1000.0 );
+        tableBench.add( secs.empty() ? -1.0 : secs.back()*1000.0 );
+        tableBench.add( total > 0.0 ? samples[s].bytes/total/SIZE_1MB : -1.0 );
+        tableBench.endOfRow();
     }
+    std::cout << "\n" << tableBench;
+    std::cout << KBLU << "Device: compression of the loaded input, Host pipeline: file read + compression, End-to-end: file to file" << KNRM << std::endl;
     return 0;
 }
+#endif
 
 /**
  *  clearSampleFolder
@@ -1084,6 +4490,8 @@ int parse_cmdline_arguments(int argc, char*argv[], gzip_args_t & args)
     int opt=0;    
     while( (opt= getopt(argc, argv, "h?cdqrtfvV-:"))!=-1) {
         switch(opt) {
+            case 'c':   args.toStdout=true; break;
+            case 'd':   args.decompress=true; break;
             case 'r':   args.operateOnFolder=true; break;
             case 'q':   args.quiet=true; break;
             case 't':   args.verifyIntegrity=true; break;
@@ -1110,6 +4518,139 @@ int parse_cmdline_arguments(int argc, char*argv[], gzip_args_t & args)
                             return show_version();  
                         if(optarg == string("csv"))
                             args.writeCSV=true;                     
+                        if(optarg == string("stdout"))
+                            args.toStdout=true;
+                        if(optarg == string("decompress"))
+                            args.decompress=true;
+                        if(optarg == string("bgzf")) {
+                            args.bgzfMode=true;
+                            args.streamMode=true;
+                        }
+                        if(optarg == string("index")) {
+                            args.indexMode=true;
+                            args.streamMode=true;
+                        }
+                        if(!string(optarg).compare(0, 8, "extract=")) {
+                            char *end = NULL;
+                            args.extractOffset = strtoll(&optarg[8], &end, 0);
+                            if(*end == ':')
+                                args.extractLength = strtoll(end+1, &end, 0);
+                            if(args.extractOffset < 0 || args.extractLength <= 0 || *end) {
+                                std::cerr << KRED << "Invalid range [" << &optarg[8] << "], expected OFFSET:LENGTH" << KNRM << std::endl;
+                                return show_usage(argv);
+                            }
+                        }
+                        if(optarg == string("stream"))
+                            args.streamMode=true;
+                        if(optarg == string("session"))
+                            args.sessionMode=true;
+                        if(optarg == string("sequential"))
+                            args.sessionMode=false;
+                        if(optarg == string("batch"))
+                            args.batchMode=true;
+                        if(optarg == string("hybrid"))
+                            args.hybridMode=true;
+                        if(optarg == string("no-fallback"))
+                            args.noFallback=true;
+                        if(optarg == string("bench"))
+                            args.benchMode=true;
+                        if(optarg == string("dma-stats"))
+                            args.dmaStats=true;
+                        if(!string(optarg).compare(0, 13, "design-cache="))
+                            args.designCache = string(&optarg[13]);
+                        if(optarg == string("no-entropy-scan"))
+                            args.entropyScan=false;
+                        if(optarg == string("no-design-cache"))
+                            args.designCache = "";
+                        if(!string(optarg).compare(0, 7, "daemon="))
+                            args.daemonPath = string(&optarg[7]);
+                        if(!string(optarg).compare(0, 8, "connect="))
+                            args.connectPath = string(&optarg[8]);
+                        if(!string(optarg).compare(0, 8, "metrics="))
+                            args.metrics = string(&optarg[8]);
+                        if(!string(optarg).compare(0, 17, "metrics-interval=")) {
+                            args.metricsIntervalMs = atoi(&optarg[17]);
+                            if(!args.metricsIntervalMs) {
+                                std::cerr << KRED << "Invalid metrics interval [" << &optarg[17] << "]" << KNRM << std::endl;
+                                return show_usage(argv);
+                            }
+                        }
+                        if(!string(optarg).compare(0, 13, "bench-warmup=")) {
+                            args.benchMode=true;
+                            args.benchWarmup = atoi(&optarg[13]);
+                        }
+                        if(!string(optarg).compare(0, 17, "bench-iterations=")) {
+                            args.benchMode=true;
+                            args.benchIterations = atoi(&optarg[17]);
+                            if(!args.benchIterations) {
+                                std::cerr << KRED << "Invalid benchmark iteration count [" << &optarg[17] << "]" << KNRM << std::endl;
+                                return show_usage(argv);
+                            }
+                        }
+                        if(!string(optarg).compare(0, 7, "boards="))
+                            args.nbBoards = atoi(&optarg[7]);
+                        if(!string(optarg).compare(0, 8, "include="))
+                            args.includes.push_back(string(&optarg[8]));
+                        if(!string(optarg).compare(0, 8, "exclude="))
+                            args.excludes.push_back(string(&optarg[8]));
+                        if(!string(optarg).compare(0, 13, "walk-threads="))
+                            args.walkThreads = atoi(&optarg[13]);
+                        if(!string(optarg).compare(0, 12, "verify-rate=")) {
+                            args.verifyIntegrity=true;
+                            args.verifyRate = atoi(&optarg[12]);
+                            if(args.verifyRate > 100) {
+                                std::cerr << KRED << "Invalid verify rate [" << &optarg[12] << "]" << KNRM << std::endl;
+                                return show_usage(argv);
+                            }
+                        }
+                        if(!string(optarg).compare(0, 15, "verify-threads="))
+                            args.verifyThreads = atoi(&optarg[15]);
+                        if(!string(optarg).compare(0, 10, "sw-levels=")) {
+                            args.swLevels = 0;
+                            for(const char *p=&optarg[10]; *p; p++)
+                                if(*p >= '1' && *p <= '9')
+                                    args.swLevels |= 1 << (*p - '0');
+                                else if(*p == '-' && p[1] >= '1' && p[1] <= '9' && p > &optarg[10])
+                                    for(int level=p[-1]-'0'; level<=p[1]-'0'; level++)
+                                        args.swLevels |= 1 << level;
+                        }
+                        if(!string(optarg).compare(0, 11, "sw-threads="))
+                            args.swThreads = atoi(&optarg[11]);
+                        if(!string(optarg).compare(0, 11, "batch-size=")) {
+                            args.batchMode=true;
+                            args.batchSize = atoll(&optarg[11])*SIZE_1KB;
+                            if(args.batchSize <= 0) {
+                                std::cerr << KRED << "Invalid batch size [" << &optarg[11] << "]" << KNRM << std::endl;
+                                return show_usage(argv);
+                            }
+                        }
+                        if(!string(optarg).compare(0, 15, "batch-deadline=")) {
+                            args.batchMode=true;
+                            args.batchDeadlineMs = atoi(&optarg[15]);
+                        }
+                        if(!string(optarg).compare(0, 14, "batch-archive=")) {
+                            args.batchMode=true;
+                            args.batchArchive = string(&optarg[14]);
+                        }
+                        if(!string(optarg).compare(0, 10, "pool-size="))
+                            args.poolSize = atoll(&optarg[10])*SIZE_1MB;
+                        if(!string(optarg).compare(0, 9, "io-depth="))
+                            args.ioDepth = atoi(&optarg[9]);
+                        if(!string(optarg).compare(0, 11, "io-buffers=")) {
+                            args.ioBuffers = atoi(&optarg[11]);
+                            if(!args.ioBuffers) {
+                                std::cerr << KRED << "Invalid I/O buffer count [" << &optarg[11] << "]" << KNRM << std::endl;
+                                return show_usage(argv);
+                            }
+                        }
+                        if(!string(optarg).compare(0, 13, "stream-chunk=")) {
+                            args.streamMode=true;
+                            args.streamChunkSize = atoll(&optarg[13])*SIZE_1MB;
+                            if(args.streamChunkSize <= 0) {
+                                std::cerr << KRED << "Invalid stream chunk size [" << &optarg[13] << "]" << KNRM << std::endl;
+                                return show_usage(argv);
+                            }
+                        }
                         break;
             case 'h':
             case '?':            
@@ -1119,6 +4660,28 @@ int parse_cmdline_arguments(int argc, char*argv[], gzip_args_t & args)
         }
     }
 
+    if((args.decompress || args.extractOffset >= 0) && (args.benchMode || args.demoMode || !args.daemonPath.empty() || !args.connectPath.empty())) {
+        std::cerr << KRED << "The \"-d\" and \"--extract\" options work on files, they can not be used along with the benchmark, sample-files, daemon or client modes" << KNRM << std::endl;
+        return show_usage(argv);
+    }
+    if(args.bgzfMode && (args.batchMode || !args.connectPath.empty())) {
+        std::cerr << KRED << "The \"--bgzf\" option can not be used along with the batch or client modes, a daemon started with it writes BGZF" << KNRM << std::endl;
+        return show_usage(argv);
+    }
+    if(args.indexMode && (args.batchMode || !args.daemonPath.empty() || !args.connectPath.empty())) {
+        std::cerr << KRED << "The \"--index\" option writes one archive per file, it can not be used along with the batch, daemon or client modes" << KNRM << std::endl;
+        return show_usage(argv);
+    }
+
+    /* Daemon Mode: the files come from the clients */
+    if(!args.daemonPath.empty()) {
+        if(optind<argc && !args.quiet) {
+            std::cout << KYEL << "WARNING: In daemon mode, non-options argument is not required"   << KNRM << std::endl;
+            std::cout << KYEL << "         Argument [" << argv[optind] << "] will be ignored"   << KNRM << std::endl;
+        }
+        return 0;
+    }
+
     /* Demo Mode */
     if(args.demoMode) {
         if(optind<argc && !args.quiet) {
@@ -1128,15 +4691,55 @@ int parse_cmdline_arguments(int argc, char*argv[], gzip_args_t & args)
         return 0;
     }
 
-    /* Gather non-options argument */
-    if (optind >= argc) {
-        if(!args.demoMode) {
-            std::cerr << "Expected argument after options" << std::endl;
+    /* Gather non-options argument: none or "-" means stdin to stdout */
+    if (optind >= argc || argv[optind] == string("-")) {
+        if(args.operateOnFolder) {
+            std::cerr << "Expected folder argument after options" << std::endl;
+            return show_usage(argv);
+        }
+        if(args.benchMode) {
+            std::cerr << "Expected file or folder argument after options" << std::endl;
             return show_usage(argv);
         }
+        if(args.extractOffset >= 0) {
+            std::cerr << "Expected archive argument after options" << std::endl;
+            return show_usage(argv);
+        }
+        if(args.indexMode) {
+            std::cerr << KRED << "The \"--index\" option writes the index next to the archive, it can not be used when writing to stdout" << KNRM << std::endl;
+            return show_usage(argv);
+        }
+        args.fromStdin=true;
+        args.toStdout=true;
+        args.path="-";
+        return 0;
     }
     args.path=argv[optind];
 
+    /* Extract Mode: a range of the original data of one archive, to stdout */
+    if(args.extractOffset >= 0) {
+        if(args.operateOnFolder) {
+            std::cerr << KRED << "The \"--extract\" option works on one archive, it can not be used along with the \"-r\" option" << KNRM << std::endl;
+            return show_usage(argv);
+        }
+        args.toStdout=true;
+    }
+
+    if(args.indexMode && args.toStdout) {
+        std::cerr << KRED << "The \"--index\" option writes the index next to the archive, it can not be used along with the \"-c\" option" << KNRM << std::endl;
+        return show_usage(argv);
+    }
+
+    if(args.benchMode && args.toStdout) {
+        std::cerr << KRED << "The benchmark mode works on files, it can not be used along with the \"-c\" option" << KNRM << std::endl;
+        return show_usage(argv);
+    }
+
+    if(args.toStdout && args.operateOnFolder) {
+        std::cerr << KRED << "The \"-c\" option can not be used along with the \"-r\" option" << KNRM << std::endl;
+        return show_usage(argv);
+    }
+
     /* Verify Last Argument Validity */
     if(!args.operateOnFolder && !isFile(args.path)) {
         std::cerr << KRED << "Provided argument is not a file, please use the \"-r\" option to operate on folders " << KNRM << std::endl;
@@ -1152,7 +4755,7 @@ int parse_cmdline_arguments(int argc, char*argv[], gzip_args_t & args)
 /**
  *  getJSONfilepath
  */
-std::string getJSONfilepath(std::string rootSearchDir, std::string expectedUDID)
+std::string getJSONfilepath(std::string rootSearchDir, std::string expectedUDID, std::string *pJsonFile = NULL)
 {
     rootSearchDir += '/';
     QpConfigInfo jsonConfigInfo;
@@ -1169,12 +4772,15 @@ std::string getJSONfilepath(std::string rootSearchDir, std::string expectedUDID)
 
             // Inner folder treated as recursive calls
             if(isFolder(path))
-                jsonPath = getJSONfilepath(path, expectedUDID);
+                jsonPath = getJSONfilepath(path, expectedUDID, pJsonFile);
             // Test each Json file
             else if(isJsonFile(path)) {
                 jsonConfigInfo.parsingINIfile(basename(path).substr(0,basename(path).size()-5), rootSearchDir);
-                if(expectedUDID == jsonConfigInfo.getUdid())
+                if(expectedUDID == jsonConfigInfo.getUdid()) {
                     jsonPath = rootSearchDir;  
+                    if(pJsonFile)
+                        *pJsonFile = path;
+                }
             }
 
             if(jsonPath != "")
@@ -1189,26 +4795,48 @@ std::string getJSONfilepath(std::string rootSearchDir, std::string expectedUDID)
 }
 
 /**
- *  getDesignUDID
+ *  findDesignJSON: JSON folder of a design, from the cache or by scanning
  */
-std::string getDesignUDID(bool verbose)
+std::string findDesignJSON(std::string designUDID, unsigned int boardIndex, bool & cached)
+{
+    std::string searchPath = std::string(JSON_SEARCH_PATH);
+    cached = false;
+    if(designUDID == "")
+        return "";
+    if(designCache) {
+        std::string jsonPath = designCache->lookup(designUDID, searchPath);
+        if(jsonPath != "") {
+            cached = true;
+            return jsonPath;
+        }
+    }
+
+    std::string jsonFile;
+    std::string jsonPath = getJSONfilepath(searchPath, designUDID, &jsonFile);
+    if(jsonPath != "" && designCache)
+        designCache->store(designUDID, searchPath, jsonFile, boardIndex);
+    return jsonPath;
+}
+
+/**
+ *  readBoardUDID
+ */
+int readBoardUDID(unsigned int boardIndex, std::string & designUDID)
 {
     TPCIeConnHdl pcieConnectionHandler=NULL;
     TPCIeParam   pcieConnectionParams;
     pcieConnectionParams.VendorID   = 0x1556;
     pcieConnectionParams.DeviceID   = 0x2000;
-    pcieConnectionParams.BoardIndex = 0x00;     //TODO: Handle multi-board when available
+    pcieConnectionParams.BoardIndex = boardIndex;
     UINT32 regValue[4];
-    std::string designUDID="";
+    designUDID="";
 
     // Read UDID Values in the design
-    if(QuickAPI_ConnectDevice(pcieConnectionParams, pcieConnectionHandler)) {
-        std::cerr << KRED << "Unable to connect to a QuickPlay design. Please load a bitstream into the board" << KNRM << std::endl;
-        return designUDID;
-    }
+    if(QuickAPI_ConnectDevice(pcieConnectionParams, pcieConnectionHandler))
+        return -1;
     if(QuickAPI_ReadRegister(pcieConnectionHandler, 0, regValue, 4)) {
-        std::cerr << KRED << "Unable to read design UDID" << KNRM << std::endl;
-        return designUDID;
+        QuickAPI_DisconnectDevice(pcieConnectionHandler);
+        return -2;
     }
     QuickAPI_DisconnectDevice(pcieConnectionHandler);
 
@@ -1222,13 +4850,76 @@ std::string getDesignUDID(bool verbose)
     stream << std::setfill ('0') << std::setw(4) << (regValue[1]&0xFFFF);
     stream << std::setfill ('0') << std::setw(8) << regValue[0];
     designUDID = stream.str();
+    return 0;
+}
 
-    if(verbose)
+/**
+ *  getDesignUDID
+ */
+std::string getDesignUDID(bool verbose)
+{
+    std::string designUDID="";
+    int err = readBoardUDID(0, designUDID);
+    if(err == -1)
+        std::cerr << KRED << "Unable to connect to a QuickPlay design. Please load a bitstream into the board" << KNRM << std::endl;
+    else if(err)
+        std::cerr << KRED << "Unable to read design UDID" << KNRM << std::endl;
+    else if(verbose)
         std::cout << KBLU << "Design UDID = [" <<  designUDID << "]" << KNRM << std::endl;
 
     return designUDID;
 }
 
+/**
+ *  openExtraBoards: open the design of the boards found after the first one
+ */
+void openExtraBoards(unsigned int maxBoards, bool verbose)
+{
+    for(unsigned int board=1; board<QP_MAX_BOARDS && (!maxBoards || board<maxBoards); board++) {
+        std::string designUDID;
+        if(readBoardUDID(board, designUDID))
+            break;
+        if(verbose)
+            std::cout << KBLU << "Board " << board << ": Design UDID = [" <<  designUDID << "]" << KNRM << std::endl;
+
+        bool cached;
+        string jsonPath = findDesignJSON(designUDID, board, cached);
+        QpDesign *dev = new QpDesign;
+        if(jsonPath=="" || qpOpenBoardDesign(*dev, board, DEVICE_NAME, LIC_SEARCH_PATH, jsonPath.c_str())) {
+            std::cerr << KYEL << "WARNING: unable to open the design of board " << board << ", board not used" << KNRM << std::endl;
+            delete dev;
+            continue;
+        }
+        dev->qpResetDesign();
+        boards.push_back(dev);
+    }
+}
+
+/**
+ *  Print the time taken by each startup stage
+ */
+void show_startup(const double *startupSecs, bool jsonCached)
+{
+    const char *stages[STARTUP_NB_STAGES] = { "UDID read", jsonCached ? "JSON lookup (cached)" : "JSON lookup (scan)",
+                                              "qpOpenDesign", "qpResetDesign", "Other boards" };
+    TextTable tableStartup( '-', '|', '+' );
+    tableStartup.setTitle("STARTUP (ms)");
+    tableStartup.add( "Stage" );
+    tableStartup.add( "Time" );
+    tableStartup.endOfRow();
+    double total = 0.0;
+    for(int s=0; s<STARTUP_NB_STAGES; s++) {
+        tableStartup.add( string(stages[s]) );
+        tableStartup.add( startupSecs[s]*1000.0 );
+        tableStartup.endOfRow();
+        total += startupSecs[s];
+    }
+    tableStartup.add( "Total" );
+    tableStartup.add( total*1000.0 );
+    tableStartup.endOfRow();
+    std::cout << "\n" << tableStartup;
+}
+
 /**
  *  Entry Point
  */
@@ -1244,38 +4935,200 @@ int main(int argc, char*argv[])
     args.verbose=false;         // No verbosity by default
     args.force=false;           // No overwrite output file by default
     args.writeCSV=false;        // No csv output by default
+    args.streamMode=false;      // Whole file mapped in memory by default
+    args.streamChunkSize=STREAM_CHUNK_SIZE;
+    args.toStdout=false;        // Write <file>.gz by default
+    args.fromStdin=false;
+    args.sessionMode=true;      // Folders go through the pipelined session by default
+    args.batchMode=false;       // One device submission per file by default
+    args.batchSize=BATCH_SIZE;
+    args.batchDeadlineMs=BATCH_DEADLINE_MS;
+    args.batchArchive="";
+    args.nbBoards=0;            // All boards found by default
+    args.walkThreads=WALK_THREADS;
+    args.verifyRate=VERIFY_RATE;
+    args.verifyThreads=0;       // Half the cores by default
+    args.swLevels=SW_ALL_LEVELS;
+    args.swThreads=0;           // All cores by default
+    args.hybridMode=false;      // Everything goes to the FPGA by default
+    args.noFallback=false;      // CPU compression when no design is available by default
+    args.ioDepth=IO_RING_DEPTH;
+    args.ioBuffers=STREAM_IN_SLOTS;
+    args.poolSize=BUFFER_POOL_SIZE;
+    args.benchMode=false;       // Compress and compare by default
+    args.benchWarmup=BENCH_WARMUP;
+    args.benchIterations=BENCH_ITERATIONS;
+    args.dmaStats=false;        // Transfer histograms on demand only by default
+    args.metrics="";            // No metrics endpoint by default
+    args.metricsIntervalMs=METRICS_INTERVAL_MS;
+    args.daemonPath="";         // One shot compression by default
+    args.connectPath="";
+    args.designCache=DesignCache::defaultPath();
+    args.decompress=false;      // Compress by default
+    args.indexMode=false;       // No member index by default
+    args.extractOffset=-1;
+    args.extractLength=0;
+    args.bgzfMode=false;        // Plain gzip members by default
+    args.entropyScan=true;      // Incompressible data kept off the device by default
+
+    /* Parse Arguments */
+    if( (retCode=parse_cmdline_arguments(argc, argv, args)) !=0 )
+        return retCode;
+    args.swLevels |= (1 << SW_FAST_LEVEL) | (1 << SW_BEST_LEVEL);
+    if(!args.swThreads)
+        args.swThreads = std::thread::hardware_concurrency();
+
+    /* SIGUSR1 goes to the reporter thread: block it before any thread starts */
+    sigset_t reportSignals;
+    sigemptyset(&reportSignals);
+    sigaddset(&reportSignals, SIGUSR1);
+    if(!args.daemonPath.empty()) {
+        // Daemon mode: the stop signals are read from a signalfd
+        sigaddset(&reportSignals, SIGINT);
+        sigaddset(&reportSignals, SIGTERM);
+    }
+    pthread_sigmask(SIG_BLOCK, &reportSignals, NULL);
+
+    /* Pipe mode: stdout carries the archive, console output goes to stderr */
+    if(args.toStdout)
+        std::cout.rdbuf(std::cerr.rdbuf());
+
+#ifdef SGDMAR
+    /* Client mode: a daemon has the design open and does the work */
+    if(!args.connectPath.empty())
+        return gzip_client(args);
+#endif
+
+    /* Metrics endpoint, scraped while the files are compressed */
+    MetricsServer *metricsServer = NULL;
+    if(!args.metrics.empty()) {
+        metricsServer = new MetricsServer(args.metrics, args.metricsIntervalMs);
+        if(metricsServer->start()) {
+            delete metricsServer;
+            return -1;
+        }
+    }
 
     // Display Startup Splashscreen
     show_start_splashscreen();
 
-    /* Parse Arguments */
-    if( (retCode=parse_cmdline_arguments(argc, argv, args)) !=0 )
+    /* Decompression runs on the host only, the device is not opened */
+    if(args.decompress) {
+        file_results_t* pResTable = NULL;
+        unsigned int resTableSize=0;
+        retCode = gunzip_files(args, pResTable, resTableSize);
+        if(resTableSize) {
+            display_decompress_table(pResTable, resTableSize);
+            if(args.writeCSV)
+                save_result_table_csvfile(pResTable, resTableSize);
+        }
+        delete metricsServer;
+        delete[] pResTable;
+        show_finish_splashscreen();
+        return retCode;
+    }
+    if(args.extractOffset >= 0) {
+        retCode = gunzip_range(args);
+        delete metricsServer;
+        show_finish_splashscreen();
         return retCode;
+    }
+
+    /* Startup stages are timed, they come before the first byte of every run */
+    double startupSecs[STARTUP_NB_STAGES] = { 0.0 };
+    chrono::time_point<std::chrono::steady_clock> stageStart = chrono::steady_clock::now();
+    chrono::time_point<std::chrono::steady_clock> stageEnd;
 
     /* Get Design UDID */   
     std::string designUDID = getDesignUDID(args.verbose);
-
-    /* Retrieve json_file_path from design */
-    string jsonPath = getJSONfilepath(std::string(JSON_SEARCH_PATH), designUDID);
+    stageEnd = chrono::steady_clock::now();
+    startupSecs[STARTUP_UDID] = getElapsedSecs(stageStart, stageEnd);
+    stageStart = stageEnd;
+
+    /* Retrieve json_file_path from design, cached across runs */
+    if(!args.designCache.empty())
+        designCache = new DesignCache(args.designCache);
+    bool jsonCached;
+    string jsonPath = findDesignJSON(designUDID, 0, jsonCached);
+    stageEnd = chrono::steady_clock::now();
+    startupSecs[STARTUP_JSON] = getElapsedSecs(stageStart, stageEnd);
+    stageStart = stageEnd;
     if(jsonPath=="") {
         std::cerr << KRED << "Unable to find JSON file matching loaded design UDID [" << designUDID << "]" << KNRM << std::endl;
-        return -1;
+        if(args.noFallback)
+            return -1;
+        cpuFallback = true;
     }
-    if(args.verbose)
+    else if(args.verbose)
         std::cerr << KBLU << "Using JSON file from [" << jsonPath << '/' << string(DEVICE_NAME) << ".json]"  << KNRM << std::endl;
     
     /* Open the device */
-	if (dev1.qpOpenDesign(DEVICE_NAME, LIC_SEARCH_PATH, jsonPath.c_str()))
-		return -1;
+	if (!cpuFallback && dev1.qpOpenDesign(DEVICE_NAME, LIC_SEARCH_PATH, jsonPath.c_str())) {
+        if(args.noFallback)
+		    return -1;
+        cpuFallback = true;
+    }
+    stageEnd = chrono::steady_clock::now();
+    startupSecs[STARTUP_OPEN] = getElapsedSecs(stageStart, stageEnd);
+    stageStart = stageEnd;
+
+    if(cpuFallback)
+        std::cerr << KYEL << "WARNING: no FPGA design available, compressing on the CPU (" << args.swThreads << " threads)" << KNRM << std::endl;
+    else {
+        /* Reset Design Internal Components */
+        dev1.qpResetDesign();
+        stageEnd = chrono::steady_clock::now();
+        startupSecs[STARTUP_RESET] = getElapsedSecs(stageStart, stageEnd);
+        stageStart = stageEnd;
+
+        /* Open the other boards, the work is spread over all of them */
+        boards.push_back(&dev1);
+        if(args.nbBoards != 1 && !args.toStdout)
+            openExtraBoards(args.nbBoards, args.verbose);
+        startupSecs[STARTUP_BOARDS] = getElapsedSecs(stageStart, chrono::steady_clock::now());
+        if(args.verbose && boards.size() > 1)
+            std::cout << KBLU << "Using " << boards.size() << " boards" << KNRM << std::endl;
+    }
 
-    /* Reset Design Internal Components */
-    dev1.qpResetDesign();
+    /* Later runs skip the JSON scan */
+    if(designCache) {
+        if(designCache->save() && args.verbose)
+            std::cerr << KYEL << "WARNING: unable to write the design cache [" << args.designCache << "]" << KNRM << std::endl;
+        delete designCache;
+        designCache = NULL;
+    }
+    if(args.verbose)
+        show_startup(startupSecs, jsonCached);
     
-	/* Start HwLogger Thread */
-    std::thread HwLogger_thread(tHwLogger);
+    /* Staging buffers come from one pinned region, mapped once */
+    if(args.poolSize > 0) {
+        bufferPool = new BufferPool(args.poolSize);
+        if(!bufferPool->valid()) {
+            if(!args.quiet)
+                std::cerr << KYEL << "WARNING: unable to allocate the buffer pool, buffers are mapped for each file" << KNRM << std::endl;
+            delete bufferPool;
+            bufferPool = NULL;
+        }
+        else if(args.verbose) {
+            buffer_pool_stats_t stats = bufferPool->stats();
+            std::cout << KBLU << "Buffer pool: " << stats.poolSize/SIZE_1MB << " MB on " << stats.pageSize/SIZE_1KB << " KB pages"
+                      << (stats.pinned ? ", pinned" : ", not pinned (RLIMIT_MEMLOCK)") << KNRM << std::endl;
+        }
+    }
+
+    /* Integrity tests run in the background, next to the compression */
+    if(args.verifyIntegrity && args.verifyRate) {
+        unsigned int nbThreads = args.verifyThreads ? args.verifyThreads : std::thread::hardware_concurrency()/2;
+        verifier = new InflateVerifier(nbThreads);
+    }
+
+    /* Start the reporter thread */
+    std::thread Reporter_thread;
+    if(!cpuFallback)
+        Reporter_thread = std::thread(tReporter);
 
     /* Create ResTable data */
-    file_results_t* pResTable;
+    file_results_t* pResTable = NULL;
     unsigned int resTableSize=0;
 
     /* Launch GZip Compression Process */ 
@@ -1284,8 +5137,22 @@ int main(int argc, char*argv[])
         clearSampleFolder(args);
     }
     else {
+#ifdef SGDMAR
+        if(!args.daemonPath.empty())
+            retCode = fpga_daemon(args);
+        else if(args.benchMode)
+            retCode = fpga_bench(args);
+        else
+#endif
         if(args.operateOnFolder)
             retCode = fpga_gzip_folder(args.path, args, pResTable, resTableSize);
+#ifdef SGDMAR
+        else if(args.toStdout) {
+            pResTable = new file_results_t[1];
+            resTableSize=1;
+            retCode = fpga_gzip_pipe(args, pResTable);
+        }
+#endif
         else {
             pResTable = new file_results_t[1];
             resTableSize=1;
@@ -1294,23 +5161,46 @@ int main(int argc, char*argv[])
     }
 
     /* Print Result Table & Save Results in CSV file */
-    if (!retCode) {
+    if (!retCode && !args.benchMode && args.daemonPath.empty()) {
         display_result_table(pResTable, resTableSize);
         if(args.writeCSV)
 			save_result_table_csvfile(pResTable, resTableSize);
 	}
+    if(bufferPool && !args.quiet)
+        show_buffer_pool();
+    if(args.dmaStats && !cpuFallback)
+        show_dma_stats();
+    if(bypassRegions && !args.quiet)
+        show_entropy_bypass();
+
+    /* Exit status: failed as soon as a file failed, as gzip */
+    bool failed = (retCode != 0);
+    for(unsigned int i=0; i<resTableSize; i++)
+        if(pResTable[i].comprResult == "FAIL")
+            failed = true;
+
+    delete metricsServer;
     delete[] pResTable;
+    delete verifier;
+    delete bufferPool;
     
-    /* Terminate the logger thread */
-    hwLoggerExit = true;
-    HwLogger_thread.join();
+    /* Terminate the reporter thread */
+    reporterExit = true;
+    if(Reporter_thread.joinable()) {
+        pthread_kill(Reporter_thread.native_handle(), SIGUSR1);
+        Reporter_thread.join();
+    }
 
-	/* Close the device */
-	if ( dev1.qpCloseDesign() )
+	/* Close the devices */
+    for(size_t i=1; i<boards.size(); i++) {
+        boards[i]->qpCloseDesign();
+        delete boards[i];
+    }
+	if ( !cpuFallback && dev1.qpCloseDesign() )
 		return -1;
 
     // Display Exit Splashscreen
     show_finish_splashscreen();
 
-	return 0;
+	return failed ? -1 : 0;
 }